@@ -1,6 +1,29 @@
 #include "src/main.c"
 #include "src/freecam.c"
 #include "src/play.c"
+#include "src/skin.c"
+#include "src/bench.c"
+#include "src/taskpool.c"
+#include "src/xformcache.c"
+#include "src/animsampler.c"
+#include "src/instance.c"
+#include "src/dbglines.c"
+#include "src/instdraw.c"
+#include "src/meshlod.c"
+#include "src/vcache.c"
+#include "src/vquant.c"
+#include "src/scenecull.c"
+#include "src/cullbvh.c"
+#include "src/bounds.c"
+#include "src/scenecache.c"
+#include "src/streambuf.c"
+#include "src/texstream.c"
+#include "src/drawlist.c"
+#include "src/dxt.c"
+#include "src/glext.c"
+#include "src/gpuskin.c"
+#include "src/mipgen.c"
+#include "src/prof.c"
 
 #include "../taascene/src/scene.c"
 #include "../taascene/src/sceneanim.c"
@@ -0,0 +1,845 @@
+#include "animsampler.h"
+#include <taa/filestream.h>
+#include <taa/scenefile.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// largest error the key removal may introduce. scalar channels scale it by
+// the magnitude of the value.
+#define ANIMSAMPLER_TOLERANCE 5.0e-4f
+
+enum
+{
+    // most samples between two keys. the samples since the last key are
+    // kept to measure the error of the segment once its end is placed.
+    ANIMSAMPLER_MAX_SPAN = 128
+};
+
+// how the value of a node is encoded while the animation is played
+enum
+{
+    ANIMNODE_SKIP,
+    ANIMNODE_SCALARS,
+    ANIMNODE_ROTATION,
+    // a rotate node whose value was not a unit quaternion, to be played
+    // again as scalars
+    ANIMNODE_RETRY
+};
+
+typedef struct animencoder_s animencoder;
+
+// key removal state of one channel while the animation is baked. each
+// sample narrows the range of slopes a line from the last key may have, and
+// a key is placed as soon as a sample of any component falls outside it.
+struct animencoder_s
+{
+    float anchor[4];
+    float prev[4];
+    float lo[4];
+    float hi[4];
+    int anchorframe;
+    int numcomps;
+    uint32_t* frames;
+    float* values;
+    int numkeys;
+    int maxkeys;
+    // samples after the anchor. the last one is the same as prev.
+    float* span;
+    int numspan;
+    // largest difference of a sample from the line between its keys
+    float maxerror;
+};
+
+//****************************************************************************
+static float animsampler_get_time(
+    float length,
+    uint32_t frame)
+{
+    float t = ((float) frame) / ANIMSAMPLER_RATE;
+    return (t < length) ? t : length;
+}
+
+//****************************************************************************
+static void animencoder_add_key(
+    animencoder* enc,
+    uint32_t frame,
+    const float* values)
+{
+    int n = enc->numcomps;
+    int i;
+    if(enc->numkeys == enc->maxkeys)
+    {
+        enc->maxkeys = (enc->maxkeys > 0) ? enc->maxkeys * 2 : 16;
+        enc->frames = (uint32_t*) realloc(
+            enc->frames,
+            enc->maxkeys * sizeof(*enc->frames));
+        enc->values = (float*) realloc(
+            enc->values,
+            enc->maxkeys * n * sizeof(*enc->values));
+    }
+    enc->frames[enc->numkeys] = frame;
+    for(i = 0; i < n; ++i)
+    {
+        enc->values[enc->numkeys*n + i] = values[i];
+        enc->anchor[i] = values[i];
+        enc->lo[i] = -FLT_MAX;
+        enc->hi[i] = FLT_MAX;
+    }
+    enc->anchorframe = frame;
+    ++enc->numkeys;
+}
+
+//****************************************************************************
+// starts encoding a value at the first frame it differs from its base value.
+// the frames before held the base value, so they are covered by a key at
+// the first frame and one at the frame before this one.
+static animencoder* animencoder_create(
+    int numcomps,
+    uint32_t frame,
+    const float* base)
+{
+    animencoder* enc = (animencoder*) calloc(1, sizeof(*enc));
+    enc->numcomps = numcomps;
+    enc->span = (float*) malloc(
+        ANIMSAMPLER_MAX_SPAN * numcomps * sizeof(*enc->span));
+    if(frame > 0)
+    {
+        animencoder_add_key(enc, 0, base);
+        if(frame > 1)
+        {
+            animencoder_add_key(enc, frame - 1, base);
+        }
+        memcpy(enc->prev, base, numcomps * sizeof(*base));
+    }
+    return enc;
+}
+
+//****************************************************************************
+static void animencoder_destroy(
+    animencoder* enc)
+{
+    if(enc != NULL)
+    {
+        free(enc->span);
+        free(enc->values);
+        free(enc->frames);
+        free(enc);
+    }
+}
+
+//****************************************************************************
+// difference between a sample and the value blended from the anchor and the
+// key the same way animsampler_play blends them
+static float animencoder_calc_error(
+    const animencoder* enc,
+    const float* key,
+    float u,
+    const float* sample)
+{
+    float v[4];
+    float e = 0.0f;
+    int n = enc->numcomps;
+    int i;
+    for(i = 0; i < n; ++i)
+    {
+        v[i] = enc->anchor[i] + (key[i] - enc->anchor[i])*u;
+    }
+    if(n == 4)
+    {
+        float len = v[0]*v[0] + v[1]*v[1] + v[2]*v[2] + v[3]*v[3];
+        len = 1.0f / (float) sqrt(len);
+        for(i = 0; i < 4; ++i)
+        {
+            v[i] *= len;
+        }
+    }
+    for(i = 0; i < n; ++i)
+    {
+        float d = (float) fabs(sample[i] - v[i]);
+        e = (d > e) ? d : e;
+    }
+    return e;
+}
+
+//****************************************************************************
+// places a key at the last sample of the span and measures the samples
+// before it against the line from the anchor
+static void animencoder_end_span(
+    animencoder* enc,
+    float length)
+{
+    int n = enc->numcomps;
+    int keyframe = enc->anchorframe + enc->numspan;
+    const float* key = enc->span + (enc->numspan - 1)*n;
+    float t0 = animsampler_get_time(length, enc->anchorframe);
+    float t1 = animsampler_get_time(length, keyframe);
+    int i;
+    for(i = 0; i + 1 < enc->numspan; ++i)
+    {
+        float t = animsampler_get_time(length, enc->anchorframe + i + 1);
+        float u = (t - t0) / (t1 - t0);
+        float e = animencoder_calc_error(enc, key, u, enc->span + i*n);
+        enc->maxerror = (e > enc->maxerror) ? e : enc->maxerror;
+    }
+    animencoder_add_key(enc, keyframe, key);
+    enc->numspan = 0;
+}
+
+//****************************************************************************
+static void animencoder_add_sample(
+    animencoder* enc,
+    float length,
+    uint32_t frame,
+    const float* values)
+{
+    float t = animsampler_get_time(length, frame);
+    float dt;
+    int n = enc->numcomps;
+    int full;
+    int i;
+    if(frame == 0)
+    {
+        animencoder_add_key(enc, frame, values);
+        memcpy(enc->prev, values, n * sizeof(*values));
+        return;
+    }
+    dt = t - animsampler_get_time(length, enc->anchorframe);
+    full = (enc->numspan == ANIMSAMPLER_MAX_SPAN);
+    for(i = 0; i < n; ++i)
+    {
+        float slope = (values[i] - enc->anchor[i]) / dt;
+        full |= (slope < enc->lo[i] || slope > enc->hi[i]);
+    }
+    if(full)
+    {
+        animencoder_end_span(enc, length);
+        dt = t - animsampler_get_time(length, enc->anchorframe);
+    }
+    for(i = 0; i < n; ++i)
+    {
+        float v = values[i];
+        float tol = ANIMSAMPLER_TOLERANCE;
+        float slope;
+        if(n == 1)
+        {
+            tol *= 1.0f + (float) fabs(v);
+        }
+        slope = (v - tol - enc->anchor[i]) / dt;
+        enc->lo[i] = (slope > enc->lo[i]) ? slope : enc->lo[i];
+        slope = (v + tol - enc->anchor[i]) / dt;
+        enc->hi[i] = (slope < enc->hi[i]) ? slope : enc->hi[i];
+        enc->prev[i] = v;
+    }
+    memcpy(enc->span + enc->numspan*n, values, n * sizeof(*values));
+    ++enc->numspan;
+}
+
+//****************************************************************************
+static void animsampler_encode_rotation(
+    const float* q,
+    uint16_t* data_out)
+{
+    float len = (float) sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+    float sign;
+    int largest = 0;
+    int i;
+    int j;
+    for(i = 1; i < 4; ++i)
+    {
+        largest = (fabs(q[i]) > fabs(q[largest])) ? i : largest;
+    }
+    // q and -q are the same rotation, so the largest can be kept positive
+    sign = (q[largest] < 0.0f) ? -1.0f/len : 1.0f/len;
+    for(i = 0, j = 0; i < 4; ++i)
+    {
+        if(i != largest)
+        {
+            // the other components are within +-1/sqrt(2)
+            float c = q[i]*sign*1.41421356f;
+            int v = (int) floor((c + 1.0f)*0.5f*32767.0f + 0.5f);
+            v = (v > 0) ? v : 0;
+            v = (v < 32767) ? v : 32767;
+            data_out[j++] = (uint16_t) v;
+        }
+    }
+    data_out[0] |= (uint16_t) ((largest & 1) << 15);
+    data_out[1] |= (uint16_t) ((largest >> 1) << 15);
+}
+
+//****************************************************************************
+static void animsampler_decode_rotation(
+    const uint16_t* data,
+    float* q_out)
+{
+    int largest = (data[0] >> 15) | ((data[1] >> 15) << 1);
+    float sum = 0.0f;
+    int i;
+    int j;
+    for(i = 0, j = 0; i < 4; ++i)
+    {
+        if(i != largest)
+        {
+            float c = (data[j] & 0x7fff)*(2.0f/32767.0f) - 1.0f;
+            c *= 0.70710678f;
+            q_out[i] = c;
+            sum += c*c;
+            ++j;
+        }
+    }
+    q_out[largest] = (sum < 1.0f) ? (float) sqrt(1.0f - sum) : 0.0f;
+}
+
+//****************************************************************************
+// returns the index of the last key at or before the time
+static int animsampler_search(
+    const uint32_t* frames,
+    int numkeys,
+    float length,
+    float sec)
+{
+    int lo = 0;
+    int hi = numkeys - 1;
+    while(lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if(animsampler_get_time(length, frames[mid]) <= sec)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+//****************************************************************************
+// quantizes the keys of a channel and returns the largest difference of a
+// dequantized key from its baked value
+static float animsampler_quantize_keys(
+    animchannel* ch,
+    const animencoder* enc,
+    uint16_t* data_out)
+{
+    float maxerror = 0.0f;
+    int k;
+    if(ch->type == ANIMCHANNEL_ROTATION)
+    {
+        ch->min = 0.0f;
+        ch->scale = 0.0f;
+        for(k = 0; k < enc->numkeys; ++k)
+        {
+            const float* v = enc->values + k*4;
+            float q[4];
+            float sign;
+            int j;
+            animsampler_encode_rotation(v, data_out + k*3);
+            animsampler_decode_rotation(data_out + k*3, q);
+            sign = (v[0]*q[0] + v[1]*q[1] + v[2]*q[2] + v[3]*q[3] < 0.0f) ?
+                -1.0f :
+                1.0f;
+            for(j = 0; j < 4; ++j)
+            {
+                float e = (float) fabs(v[j] - q[j]*sign);
+                maxerror = (e > maxerror) ? e : maxerror;
+            }
+        }
+    }
+    else
+    {
+        // only the keys are interpolated, so their range is enough
+        float lo = FLT_MAX;
+        float hi = -FLT_MAX;
+        for(k = 0; k < enc->numkeys; ++k)
+        {
+            float v = enc->values[k];
+            lo = (v < lo) ? v : lo;
+            hi = (v > hi) ? v : hi;
+        }
+        ch->min = lo;
+        ch->scale = (hi - lo) / 65535.0f;
+        for(k = 0; k < enc->numkeys; ++k)
+        {
+            float v = 0.0f;
+            float e;
+            if(ch->scale > 0.0f)
+            {
+                v = (enc->values[k] - ch->min)/ch->scale + 0.5f;
+            }
+            v = (v < 65535.0f) ? v : 65535.0f;
+            data_out[k] = (uint16_t) v;
+            e = (float) fabs(ch->min + data_out[k]*ch->scale - enc->values[k]);
+            maxerror = (e > maxerror) ? e : maxerror;
+        }
+    }
+    return maxerror;
+}
+
+//****************************************************************************
+// size of the animation in a scene file, measured by writing a scene that
+// holds only the animation after an empty one
+static size_t animsampler_calc_source_size(
+    const taa_sceneanim* anim)
+{
+    size_t size = 0;
+    FILE* fp = tmpfile();
+    if(fp != NULL)
+    {
+        taa_scene tmpscene;
+        taa_filestream outfs;
+        taa_sceneanim* animations;
+        uint32_t numanimations;
+        long base;
+        long end;
+        int err;
+        taa_scene_create(&tmpscene, taa_SCENE_Y_UP);
+        taa_filestream_create(fp, 64 * 1024, taa_FILESTREAM_WRITE, &outfs);
+        err = taa_scenefile_serialize(&tmpscene, &outfs);
+        taa_filestream_destroy(&outfs);
+        base = ftell(fp);
+        // the scene only borrows the animation while it is written
+        animations = tmpscene.animations;
+        numanimations = tmpscene.numanimations;
+        tmpscene.animations = (taa_sceneanim*) anim;
+        tmpscene.numanimations = 1;
+        if(err == 0)
+        {
+            taa_filestream_create(fp, 64*1024, taa_FILESTREAM_WRITE, &outfs);
+            err = taa_scenefile_serialize(&tmpscene, &outfs);
+            taa_filestream_destroy(&outfs);
+        }
+        end = ftell(fp);
+        if(err == 0 && base >= 0 && end > base)
+        {
+            size = (size_t) (end - base);
+        }
+        tmpscene.animations = animations;
+        tmpscene.numanimations = numanimations;
+        taa_scene_destroy(&tmpscene);
+        fclose(fp);
+    }
+    return size;
+}
+
+//****************************************************************************
+static int animsampler_is_unit(
+    const float* q)
+{
+    float lensq = q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3];
+    return fabs(lensq - 1.0f) < 1.0e-3f;
+}
+
+//****************************************************************************
+// plays the animation once and feeds the node values to the encoders the
+// node modes ask for. an encoder is only created once its value first
+// differs from the value in nodes, so values that never change cost
+// nothing. a rotate node whose value is not a unit quaternion has its
+// encoders destroyed and its mode set to ANIMNODE_RETRY.
+static void animsampler_sample(
+    const taa_sceneanim* anim,
+    const taa_scenenode* nodes,
+    int numnodes,
+    uint8_t* modes,
+    animencoder** scalars,
+    animencoder** rotations)
+{
+    int valueword = (int) (offsetof(taa_scenenode, value) / sizeof(float));
+    int numvalues = (int) (sizeof(nodes->value) / sizeof(float));
+    int nodewords = (int) (sizeof(*nodes) / sizeof(float));
+    int numsamples = ((int) ceil(anim->length * ANIMSAMPLER_RATE)) + 1;
+    size_t nodesize = numnodes * sizeof(*nodes);
+    const uint32_t* basewords = (const uint32_t*) nodes;
+    const float* basefloats = (const float*) nodes;
+    taa_scenenode* tmpnodes = (taa_scenenode*) malloc(nodesize);
+    const uint32_t* tmpwords = (const uint32_t*) tmpnodes;
+    const float* tmpfloats = (const float*) tmpnodes;
+    int i;
+    int j;
+    int k;
+    for(k = 0; k < numsamples; ++k)
+    {
+        float t = animsampler_get_time(anim->length, k);
+        memcpy(tmpnodes, nodes, nodesize);
+        taa_sceneanim_play(anim, t, tmpnodes, numnodes);
+        for(i = 0; i < numnodes; ++i)
+        {
+            int w = i*nodewords + valueword;
+            const uint32_t* a = tmpwords + w;
+            const uint32_t* b = basewords + w;
+            const float* src = tmpfloats + w;
+            animencoder** encs = scalars + i*numvalues;
+            j = numvalues;
+            if(modes[i] == ANIMNODE_ROTATION)
+            {
+                animencoder* rot = rotations[i];
+                int unit = animsampler_is_unit(src);
+                if(rot == NULL &&
+                   (a[0] != b[0] || a[1] != b[1] || a[2] != b[2] ||
+                    a[3] != b[3]))
+                {
+                    unit &= animsampler_is_unit(basefloats + w);
+                    rot = animencoder_create(4, k, basefloats + w);
+                    rotations[i] = rot;
+                }
+                if(rot != NULL && unit)
+                {
+                    const float* p = rot->prev;
+                    float values[4];
+                    memcpy(values, src, sizeof(values));
+                    // keep consecutive samples in the same hemisphere so
+                    // the components can be interpolated
+                    if(k > 0)
+                    {
+                        if(p[0]*src[0]+p[1]*src[1]+p[2]*src[2]+p[3]*src[3]<0)
+                        {
+                            values[0] = -values[0];
+                            values[1] = -values[1];
+                            values[2] = -values[2];
+                            values[3] = -values[3];
+                        }
+                    }
+                    animencoder_add_sample(rot, anim->length, k, values);
+                }
+                else if(rot != NULL)
+                {
+                    // every float of the node is baked as a scalar instead
+                    animencoder_destroy(rot);
+                    rotations[i] = NULL;
+                    for(j = 4; j < numvalues; ++j)
+                    {
+                        animencoder_destroy(encs[j]);
+                        encs[j] = NULL;
+                    }
+                    modes[i] = ANIMNODE_RETRY;
+                }
+                j = (modes[i] == ANIMNODE_ROTATION) ? 4 : numvalues;
+            }
+            else if(modes[i] == ANIMNODE_SCALARS)
+            {
+                j = 0;
+            }
+            while(j < numvalues)
+            {
+                if(encs[j] == NULL && a[j] != b[j])
+                {
+                    encs[j] = animencoder_create(1, k, basefloats + w + j);
+                }
+                if(encs[j] != NULL)
+                {
+                    animencoder_add_sample(encs[j], anim->length, k, src + j);
+                }
+                ++j;
+            }
+        }
+    }
+    free(tmpnodes);
+}
+
+//****************************************************************************
+void animsampler_create(
+    const taa_sceneanim* anim,
+    const taa_scenenode* nodes,
+    int numnodes,
+    animsampler* sampler_out)
+{
+    // every float of a node value may become a scalar channel, and the value
+    // of a rotate node may become a rotation channel. the types of the
+    // nodes decide the candidates, and the samples only confirm them.
+    int valueword = (int) (offsetof(taa_scenenode, value) / sizeof(float));
+    int numvalues = (int) (sizeof(nodes->value) / sizeof(float));
+    int nodewords = (int) (sizeof(*nodes) / sizeof(float));
+    int numscalars = numnodes * numvalues;
+    int numsamples = ((int) ceil(anim->length * ANIMSAMPLER_RATE)) + 1;
+    animencoder** scalars;
+    animencoder** rotations;
+    animencoder** chencoders;
+    animchannel* channels;
+    uint8_t* modes;
+    int numretries;
+    int numchannels;
+    int numkeys;
+    int numdata;
+    int i;
+    int j;
+
+    scalars = (animencoder**) calloc(numscalars + 1, sizeof(*scalars));
+    rotations = (animencoder**) calloc(numnodes + 1, sizeof(*rotations));
+    modes = (uint8_t*) malloc((numnodes + 1) * sizeof(*modes));
+    for(i = 0; i < numnodes; ++i)
+    {
+        modes[i] = ANIMNODE_SCALARS;
+        if(nodes[i].type == taa_SCENENODE_TRANSFORM_ROTATE && numvalues >= 4)
+        {
+            modes[i] = ANIMNODE_ROTATION;
+        }
+    }
+
+    // play the animation once. the encoders remove keys as the samples
+    // arrive and measure the error of each segment they close, so the
+    // full rate samples are never stored. only if a rotate node did not
+    // hold unit quaternions is the animation played again for that node.
+    animsampler_sample(anim, nodes, numnodes, modes, scalars, rotations);
+    numretries = 0;
+    for(i = 0; i < numnodes; ++i)
+    {
+        numretries += (modes[i] == ANIMNODE_RETRY);
+        modes[i] = (modes[i] == ANIMNODE_RETRY) ?
+            ANIMNODE_SCALARS :
+            ANIMNODE_SKIP;
+    }
+    if(numretries > 0)
+    {
+        animsampler_sample(anim, nodes, numnodes, modes, scalars, rotations);
+    }
+
+    // every encoder that was created belongs to an animated value
+    channels = (animchannel*) malloc((numscalars + 1) * sizeof(*channels));
+    chencoders = (animencoder**) malloc(
+        (numscalars + 1) * sizeof(*chencoders));
+    numchannels = 0;
+    for(i = 0; i < numnodes; ++i)
+    {
+        int w = i*nodewords + valueword;
+        j = 0;
+        if(rotations[i] != NULL)
+        {
+            channels[numchannels].type = ANIMCHANNEL_ROTATION;
+            channels[numchannels].offset = w;
+            chencoders[numchannels] = rotations[i];
+            ++numchannels;
+            j = 4;
+        }
+        while(j < numvalues)
+        {
+            if(scalars[i*numvalues + j] != NULL)
+            {
+                channels[numchannels].type = ANIMCHANNEL_SCALAR;
+                channels[numchannels].offset = w + j;
+                chencoders[numchannels] = scalars[i*numvalues + j];
+                ++numchannels;
+            }
+            ++j;
+        }
+    }
+    channels = (animchannel*) realloc(
+        channels,
+        (numchannels + 1) * sizeof(*channels));
+    numkeys = 0;
+    numdata = 0;
+    for(i = 0; i < numchannels; ++i)
+    {
+        animencoder* enc = chencoders[i];
+        if(enc->numspan > 0)
+        {
+            animencoder_end_span(enc, anim->length);
+        }
+        numkeys += enc->numkeys;
+        numdata += enc->numkeys * ((enc->numcomps == 4) ? 3 : 1);
+    }
+
+    // quantize the remaining keys. the error of a channel is bounded by the
+    // error of its segments plus the error of its quantized keys.
+    sampler_out->keyframes = (uint32_t*) malloc(
+        (numkeys + 1) * sizeof(*sampler_out->keyframes));
+    sampler_out->keydata = (uint16_t*) malloc(
+        (numdata + 1) * sizeof(*sampler_out->keydata));
+    sampler_out->maxrotationerror = 0.0f;
+    sampler_out->maxscalarerror = 0.0f;
+    numkeys = 0;
+    numdata = 0;
+    for(i = 0; i < numchannels; ++i)
+    {
+        animchannel* ch = channels + i;
+        animencoder* enc = chencoders[i];
+        uint16_t* data = sampler_out->keydata + numdata;
+        float e;
+        ch->firstkey = numkeys;
+        ch->numkeys = enc->numkeys;
+        ch->firstdata = numdata;
+        memcpy(
+            sampler_out->keyframes + numkeys,
+            enc->frames,
+            enc->numkeys * sizeof(*enc->frames));
+        e = enc->maxerror + animsampler_quantize_keys(ch, enc, data);
+        if(ch->type == ANIMCHANNEL_ROTATION)
+        {
+            if(e > sampler_out->maxrotationerror)
+            {
+                sampler_out->maxrotationerror = e;
+            }
+        }
+        else
+        {
+            if(e > sampler_out->maxscalarerror)
+            {
+                sampler_out->maxscalarerror = e;
+            }
+        }
+        numkeys += enc->numkeys;
+        numdata += enc->numkeys * ((ch->type == ANIMCHANNEL_ROTATION) ? 3:1);
+    }
+    for(i = 0; i < numscalars; ++i)
+    {
+        animencoder_destroy(scalars[i]);
+    }
+    for(i = 0; i < numnodes; ++i)
+    {
+        animencoder_destroy(rotations[i]);
+    }
+    free(chencoders);
+    free(modes);
+    free(rotations);
+    free(scalars);
+
+    sampler_out->channels = channels;
+    sampler_out->numchannels = numchannels;
+    sampler_out->numkeys = numkeys;
+    sampler_out->numdata = numdata;
+    sampler_out->numsamples = numsamples;
+    sampler_out->length = anim->length;
+    sampler_out->srcsize = animsampler_calc_source_size(anim);
+    sampler_out->size = numchannels * sizeof(*channels) +
+        numkeys * sizeof(*sampler_out->keyframes) +
+        numdata * sizeof(*sampler_out->keydata);
+}
+
+//****************************************************************************
+void animsampler_destroy(
+    animsampler* sampler)
+{
+    free(sampler->keydata);
+    free(sampler->keyframes);
+    free(sampler->channels);
+}
+
+//****************************************************************************
+void animsampler_create_player(
+    const animsampler* sampler,
+    animplayer* player_out)
+{
+    player_out->cursors = (int*) calloc(
+        sampler->numchannels + 1,
+        sizeof(*player_out->cursors));
+    // force a search on the first sample
+    player_out->lasttime = FLT_MAX;
+}
+
+//****************************************************************************
+void animsampler_destroy_player(
+    animplayer* player)
+{
+    free(player->cursors);
+}
+
+//****************************************************************************
+void animsampler_play(
+    const animsampler* sampler,
+    animplayer* player,
+    float sec,
+    taa_scenenode* nodes)
+{
+    const animchannel* chitr = sampler->channels;
+    const animchannel* chend = chitr + sampler->numchannels;
+    int* cursoritr = player->cursors;
+    float length = sampler->length;
+    float* dst = (float*) nodes;
+    int seek;
+    sec = (sec > 0.0f) ? sec : 0.0f;
+    sec = (sec < length) ? sec : length;
+    seek = (sec < player->lasttime);
+    while(chitr != chend)
+    {
+        const uint32_t* frames = sampler->keyframes + chitr->firstkey;
+        const uint16_t* data = sampler->keydata + chitr->firstdata;
+        int numkeys = chitr->numkeys;
+        int k = *cursoritr;
+        float u = 0.0f;
+        if(seek)
+        {
+            k = animsampler_search(frames, numkeys, length, sec);
+        }
+        else
+        {
+            while(k + 1 < numkeys)
+            {
+                if(animsampler_get_time(length, frames[k + 1]) > sec)
+                {
+                    break;
+                }
+                ++k;
+            }
+        }
+        if(k + 1 < numkeys)
+        {
+            float t0 = animsampler_get_time(length, frames[k]);
+            float t1 = animsampler_get_time(length, frames[k + 1]);
+            u = (sec - t0) / (t1 - t0);
+        }
+        if(chitr->type == ANIMCHANNEL_ROTATION)
+        {
+            float* q = dst + chitr->offset;
+            float q0[4];
+            animsampler_decode_rotation(data + k*3, q0);
+            if(k + 1 < numkeys)
+            {
+                float q1[4];
+                float len;
+                int i;
+                animsampler_decode_rotation(data + k*3 + 3, q1);
+                if(q0[0]*q1[0] + q0[1]*q1[1] + q0[2]*q1[2] + q0[3]*q1[3] < 0)
+                {
+                    for(i = 0; i < 4; ++i)
+                    {
+                        q1[i] = -q1[i];
+                    }
+                }
+                for(i = 0; i < 4; ++i)
+                {
+                    q0[i] += (q1[i] - q0[i])*u;
+                }
+                len = q0[0]*q0[0] + q0[1]*q0[1] + q0[2]*q0[2] + q0[3]*q0[3];
+                len = 1.0f / (float) sqrt(len);
+                for(i = 0; i < 4; ++i)
+                {
+                    q0[i] *= len;
+                }
+            }
+            memcpy(q, q0, sizeof(q0));
+        }
+        else
+        {
+            float v = chitr->min + data[k]*chitr->scale;
+            if(k + 1 < numkeys)
+            {
+                float v1 = chitr->min + data[k + 1]*chitr->scale;
+                v += (v1 - v)*u;
+            }
+            dst[chitr->offset] = v;
+        }
+        *cursoritr = k;
+        ++cursoritr;
+        ++chitr;
+    }
+    player->lasttime = sec;
+}
+
+//****************************************************************************
+void animsampler_print_report(
+    const animsampler* sampler,
+    int animid)
+{
+    printf(
+        "animation %d: %d channels, %lu bytes source, %lu bytes compressed "
+        "(%.1f:1), max error %g rotation, %g other\n",
+        animid,
+        sampler->numchannels,
+        (unsigned long) sampler->srcsize,
+        (unsigned long) sampler->size,
+        (sampler->size > 0) ? ((double) sampler->srcsize)/sampler->size : 0.0,
+        sampler->maxrotationerror,
+        sampler->maxscalarerror);
+}
@@ -0,0 +1,120 @@
+#ifndef ANIMSAMPLER_H_
+#define ANIMSAMPLER_H_
+
+#include <taa/scene.h>
+#include <stddef.h>
+
+typedef struct animchannel_s animchannel;
+typedef struct animsampler_s animsampler;
+typedef struct animplayer_s animplayer;
+
+enum
+{
+    // rate in samples per second at which animations are baked
+    ANIMSAMPLER_RATE = 120
+};
+
+// channel types
+enum
+{
+    // one float quantized to 16 bits within the range of the channel
+    ANIMCHANNEL_SCALAR,
+    // the value of a rotate node that stays a unit quaternion. the three
+    // smallest components are quantized to 15 bits, and the index of the
+    // largest is stored in the high bits of the first two.
+    ANIMCHANNEL_ROTATION
+};
+
+// keyframes of one animated float, or of one quaternion, in the node array
+struct animchannel_s
+{
+    int type;
+    // index of the first float in the node array
+    int offset;
+    int firstkey;
+    int numkeys;
+    // start of the channel's key data. each key uses 1 value for scalars
+    // and 3 values for rotations.
+    int firstdata;
+    // dequantization of scalar keys
+    float min;
+    float scale;
+};
+
+// animation baked into compressed keyframe tracks
+struct animsampler_s
+{
+    animchannel* channels;
+    int numchannels;
+    // sample index of every key
+    uint32_t* keyframes;
+    uint16_t* keydata;
+    int numkeys;
+    int numdata;
+    int numsamples;
+    float length;
+    // size of the source animation as stored in a scene file, and the size
+    // of the compressed tracks
+    size_t srcsize;
+    size_t size;
+    // bounds on the differences from the animation at the bake rate, from
+    // the error of the removed keys plus the quantization of the kept ones
+    float maxrotationerror;
+    float maxscalarerror;
+};
+
+// playback position of one user of a sampler. each channel keeps a cursor
+// to the key used by the previous sample, so playing forward only has to
+// step the cursors.
+struct animplayer_s
+{
+    // per channel index of the key at or before the last sampled time
+    int* cursors;
+    float lasttime;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// bakes and compresses the animation by playing it once onto copies of the
+// nodes. floats of node values that never differ from the nodes are not
+// stored or tracked, and keys that can be interpolated from their neighbors
+// within a small tolerance are removed. a rotate node whose value is not a
+// unit quaternion is baked as scalars in a second pass over the animation.
+void animsampler_create(
+    const taa_sceneanim* anim,
+    const taa_scenenode* nodes,
+    int numnodes,
+    animsampler* sampler_out);
+
+void animsampler_destroy(
+    animsampler* sampler);
+
+void animsampler_create_player(
+    const animsampler* sampler,
+    animplayer* player_out);
+
+void animsampler_destroy_player(
+    animplayer* player);
+
+// writes the animated values at the time to the nodes. the cursors of the
+// player are searched for again only when the time moves backwards.
+void animsampler_play(
+    const animsampler* sampler,
+    animplayer* player,
+    float sec,
+    taa_scenenode* nodes);
+
+// prints the sizes of the source and compressed animation and the error of
+// the compressed tracks
+void animsampler_print_report(
+    const animsampler* sampler,
+    int animid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANIMSAMPLER_H_
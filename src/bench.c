@@ -0,0 +1,256 @@
+#include <taa/scene.h>
+#include "instance.h"
+#include "prof.h"
+#include "scenecache.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct bench_stage_s bench_stage;
+
+enum
+{
+    BENCH_STAGE_ANIM,
+    BENCH_STAGE_JOINTS,
+    BENCH_STAGE_SKIN,
+    BENCH_STAGE_TRANSFORM,
+    BENCH_NUM_STAGES
+};
+
+struct bench_stage_s
+{
+    const char* name;
+    int64_t* samples;
+};
+
+//****************************************************************************
+static int bench_compare_samples(
+    const void* a,
+    const void* b)
+{
+    int64_t sa = *((const int64_t*) a);
+    int64_t sb = *((const int64_t*) b);
+    return (sa > sb) - (sa < sb);
+}
+
+//****************************************************************************
+static void bench_print_stage(
+    const char* name,
+    int64_t* samples,
+    int numframes)
+{
+    int p99 = (int) ceil(numframes * 0.99) - 1;
+    qsort(samples, numframes, sizeof(*samples), bench_compare_samples);
+    printf(
+        "%-10s %12.4f %12.4f %12.4f\n",
+        name,
+        samples[0] * 1.0e-6,
+        samples[numframes/2] * 1.0e-6,
+        samples[(p99 > 0) ? p99 : 0] * 1.0e-6);
+}
+
+//****************************************************************************
+int bench(
+    taa_scene* scene,
+    scenecache* cache,
+    const animsampler* sampler,
+    int numframes,
+    int numthreads,
+    int numinstances,
+    float spacing)
+{
+    bench_stage stages[BENCH_NUM_STAGES] =
+    {
+        { "anim"     , NULL },
+        { "joints"   , NULL },
+        { "skin"     , NULL },
+        { "transform", NULL }
+    };
+    instance* instances;
+    skinmesh* skinmeshes;
+    pnvert** skinverts;
+    taskpool* pool;
+    taskpool_task* tasks;
+    int numtasks;
+    int64_t* totals;
+    int64_t elapsed;
+    int frame;
+    int i;
+    int j;
+    int numskels;
+    int nummeshes;
+
+    numskels = scene->numskeletons;
+    nummeshes = scene->nummeshes;
+    skinmeshes = (skinmesh*) malloc(nummeshes * sizeof(*skinmeshes));
+    numtasks = 0;
+    for(i = 0; i < nummeshes; ++i)
+    {
+        taa_scenemesh* mesh = scene->meshes + i;
+        if(mesh->skeleton >= 0)
+        {
+            // the skin mesh replaces the interleaved streams
+            skin_create_mesh(mesh, skinmeshes + i);
+            scenecache_release_stream(cache, mesh, 0);
+            scenecache_release_stream(cache, mesh, 2);
+            numtasks += skin_count_tasks(skinmeshes + i);
+        }
+    }
+    // every batch adds the same tasks for each instance: the skinning
+    // tasks, one pose task per skeleton, or one animation or transform task
+    numtasks = (numtasks > numskels) ? numtasks : numskels;
+    numtasks = (numtasks > 1) ? numtasks : 1;
+    tasks = (taskpool_task*) malloc(
+        (numinstances*numtasks + 1) * sizeof(*tasks));
+    pool = taskpool_create(numthreads);
+
+    // the skinned output is written to client memory instead of a vertex
+    // buffer so the benchmark does not need a rendering context
+    instances = (instance*) malloc(numinstances * sizeof(*instances));
+    skinverts = (pnvert**) calloc(
+        numinstances*nummeshes + 1,
+        sizeof(*skinverts));
+    for(i = 0; i < numinstances; ++i)
+    {
+        instance* inst = instances + i;
+        instance_create(scene, sampler, i, numinstances, spacing, inst);
+        for(j = 0; j < nummeshes; ++j)
+        {
+            taa_scenemesh* mesh = scene->meshes + j;
+            if(mesh->skeleton >= 0)
+            {
+                int numverts = mesh->vertexstreams[0].numvertices;
+                pnvert* pndst = (pnvert*) taa_memalign(
+                    16,
+                    numverts*sizeof(*pndst));
+                inst->skinjobs[j].smesh = skinmeshes + j;
+                inst->skinjobs[j].pndst = pndst;
+                skinverts[i*nummeshes + j] = pndst;
+            }
+        }
+    }
+
+    for(i = 0; i < BENCH_NUM_STAGES; ++i)
+    {
+        stages[i].samples = (int64_t*) malloc(
+            numframes*sizeof(*stages[i].samples));
+    }
+    totals = (int64_t*) malloc(numframes*sizeof(*totals));
+
+    elapsed = 0;
+    for(frame = 0; frame < numframes; ++frame)
+    {
+        int64_t t0;
+        int64_t t1;
+        int64_t t2;
+        int64_t t3;
+        int64_t t4;
+        t0 = prof_sample_ns();
+        // update animate sqts at a fixed 60hz step so runs are repeatable
+        numtasks = 0;
+        for(i = 0; i < numinstances; ++i)
+        {
+            numtasks += instance_add_anim_task(
+                instances + i,
+                frame/60.0,
+                tasks + numtasks);
+        }
+        taskpool_run(pool, tasks, numtasks);
+        taskpool_finish(pool);
+        t1 = prof_sample_ns();
+        numtasks = 0;
+        for(i = 0; i < numinstances; ++i)
+        {
+            numtasks += instance_add_pose_tasks(
+                instances + i,
+                tasks + numtasks);
+        }
+        taskpool_run(pool, tasks, numtasks);
+        taskpool_finish(pool);
+        t2 = prof_sample_ns();
+        // skin each mesh once per pose, like play does
+        numtasks = 0;
+        for(i = 0; i < numinstances; ++i)
+        {
+            instance_update_palettes(instances + i);
+            numtasks += instance_add_skin_tasks(
+                instances + i,
+                NULL,
+                tasks + numtasks);
+        }
+        taskpool_run(pool, tasks, numtasks);
+        taskpool_finish(pool);
+        t3 = prof_sample_ns();
+        numtasks = 0;
+        for(i = 0; i < numinstances; ++i)
+        {
+            numtasks += instance_add_xform_task(
+                instances + i,
+                tasks + numtasks);
+        }
+        taskpool_run(pool, tasks, numtasks);
+        taskpool_finish(pool);
+        for(i = 0; i < numinstances; ++i)
+        {
+            instance_clear_dirty(instances + i);
+        }
+        t4 = prof_sample_ns();
+        stages[BENCH_STAGE_ANIM].samples[frame] = t1 - t0;
+        stages[BENCH_STAGE_JOINTS].samples[frame] = t2 - t1;
+        stages[BENCH_STAGE_SKIN].samples[frame] = t3 - t2;
+        stages[BENCH_STAGE_TRANSFORM].samples[frame] = t4 - t3;
+        totals[frame] = t4 - t0;
+        elapsed += t4 - t0;
+    }
+
+    printf(
+        "%d frames, %d threads, %d instances\n",
+        numframes,
+        numthreads,
+        numinstances);
+    printf(
+        "%-10s %12s %12s %12s\n",
+        "stage",
+        "min ms",
+        "median ms",
+        "p99 ms");
+    for(i = 0; i < BENCH_NUM_STAGES; ++i)
+    {
+        bench_print_stage(stages[i].name, stages[i].samples, numframes);
+    }
+    bench_print_stage("total", totals, numframes);
+    printf(
+        "%.1f frames/sec\n",
+        (elapsed > 0) ? (numframes * 1.0e9) / elapsed : 0.0);
+
+    // clean up
+    taskpool_destroy(pool);
+    for(i = 0; i < BENCH_NUM_STAGES; ++i)
+    {
+        free(stages[i].samples);
+    }
+    for(i = 0; i < numinstances; ++i)
+    {
+        for(j = 0; j < nummeshes; ++j)
+        {
+            if(skinverts[i*nummeshes + j] != NULL)
+            {
+                taa_memalign_free(skinverts[i*nummeshes + j]);
+            }
+        }
+        instance_destroy(instances + i);
+    }
+    for(i = 0; i < nummeshes; ++i)
+    {
+        if(scene->meshes[i].skeleton >= 0)
+        {
+            skin_destroy_mesh(skinmeshes + i);
+        }
+    }
+    free(totals);
+    free(tasks);
+    free(skinverts);
+    free(instances);
+    free(skinmeshes);
+    return 0;
+}
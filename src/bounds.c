@@ -0,0 +1,159 @@
+#include "bounds.h"
+#include "skin.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+//****************************************************************************
+static void aabb_add_point(
+    aabb* box,
+    const taa_vec3* p)
+{
+    box->min.x = (p->x < box->min.x) ? p->x : box->min.x;
+    box->min.y = (p->y < box->min.y) ? p->y : box->min.y;
+    box->min.z = (p->z < box->min.z) ? p->z : box->min.z;
+    box->max.x = (p->x > box->max.x) ? p->x : box->max.x;
+    box->max.y = (p->y > box->max.y) ? p->y : box->max.y;
+    box->max.z = (p->z > box->max.z) ? p->z : box->max.z;
+}
+
+//****************************************************************************
+void aabb_set_empty(
+    aabb* box_out)
+{
+    box_out->min.x = box_out->min.y = box_out->min.z = FLT_MAX;
+    box_out->max.x = box_out->max.y = box_out->max.z = -FLT_MAX;
+}
+
+//****************************************************************************
+void aabb_merge(
+    const aabb* a,
+    const aabb* b,
+    aabb* box_out)
+{
+    box_out->min.x = (a->min.x < b->min.x) ? a->min.x : b->min.x;
+    box_out->min.y = (a->min.y < b->min.y) ? a->min.y : b->min.y;
+    box_out->min.z = (a->min.z < b->min.z) ? a->min.z : b->min.z;
+    box_out->max.x = (a->max.x > b->max.x) ? a->max.x : b->max.x;
+    box_out->max.y = (a->max.y > b->max.y) ? a->max.y : b->max.y;
+    box_out->max.z = (a->max.z > b->max.z) ? a->max.z : b->max.z;
+}
+
+//****************************************************************************
+void aabb_transform(
+    const aabb* box,
+    const taa_mat44* m,
+    aabb* box_out)
+{
+    const taa_vec4* cols = &m->x;
+    float c[3];
+    float e[3];
+    int r;
+    if(box->min.x > box->max.x)
+    {
+        *box_out = *box;
+        return;
+    }
+    c[0] = (box->min.x + box->max.x) * 0.5f;
+    c[1] = (box->min.y + box->max.y) * 0.5f;
+    c[2] = (box->min.z + box->max.z) * 0.5f;
+    e[0] = (box->max.x - box->min.x) * 0.5f;
+    e[1] = (box->max.y - box->min.y) * 0.5f;
+    e[2] = (box->max.z - box->min.z) * 0.5f;
+    // the transformed center, plus the extents transformed by the absolute
+    // values of the matrix. the matrix is column major, so row r of the
+    // matrix is the r'th component of each column.
+    for(r = 0; r < 3; ++r)
+    {
+        float tc = (&cols[3].x)[r];
+        float te = 0.0f;
+        int k;
+        for(k = 0; k < 3; ++k)
+        {
+            float v = (&cols[k].x)[r];
+            tc += v * c[k];
+            te += (float) fabs(v) * e[k];
+        }
+        (&box_out->min.x)[r] = tc - te;
+        (&box_out->max.x)[r] = tc + te;
+    }
+}
+
+//****************************************************************************
+void bounds_create_mesh(
+    const taa_scenemesh* mesh,
+    meshbounds* mb_out)
+{
+    const pnvert* pnitr = (const pnvert*) mesh->vertexstreams[0].buffer;
+    const pnvert* pnend = pnitr + mesh->vertexstreams[0].numvertices;
+    const jwvert* jw;
+    int i;
+    aabb_set_empty(&mb_out->box);
+    mb_out->jointboxes = NULL;
+    mb_out->numjoints = 0;
+    if(mesh->skeleton >= 0)
+    {
+        mb_out->jointboxes = (aabb*) malloc(
+            (mesh->numjoints + 1) * sizeof(*mb_out->jointboxes));
+        for(i = 0; i < (int) mesh->numjoints; ++i)
+        {
+            aabb_set_empty(mb_out->jointboxes + i);
+        }
+    }
+    jw = (const jwvert*) mesh->vertexstreams[2].buffer;
+    while(pnitr != pnend)
+    {
+        aabb_add_point(&mb_out->box, &pnitr->pos);
+        if(mb_out->jointboxes != NULL)
+        {
+            // the influences are sorted by descending weight, and unused
+            // influences have zero weight
+            int k = 0;
+            while(k < SKIN_MAX_INFLUENCES && jw->weights[k] > 0.0f)
+            {
+                int j = jw->joints[k];
+                aabb_add_point(mb_out->jointboxes + j, &pnitr->pos);
+                mb_out->numjoints = (j >= mb_out->numjoints) ?
+                    j + 1 :
+                    mb_out->numjoints;
+                ++k;
+            }
+            ++jw;
+        }
+        ++pnitr;
+    }
+}
+
+//****************************************************************************
+void bounds_destroy_mesh(
+    meshbounds* mb)
+{
+    free(mb->jointboxes);
+}
+
+//****************************************************************************
+void bounds_calc_mesh(
+    const meshbounds* mb,
+    const taa_mat44* palette,
+    aabb* box_out)
+{
+    if(mb->jointboxes != NULL)
+    {
+        int i;
+        aabb_set_empty(box_out);
+        for(i = 0; i < mb->numjoints; ++i)
+        {
+            const aabb* jbox = mb->jointboxes + i;
+            if(jbox->min.x <= jbox->max.x)
+            {
+                aabb tbox;
+                aabb_transform(jbox, palette + i, &tbox);
+                aabb_merge(box_out, &tbox, box_out);
+            }
+        }
+    }
+    else
+    {
+        *box_out = mb->box;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef BOUNDS_H_
+#define BOUNDS_H_
+
+#include <taa/scene.h>
+
+typedef struct aabb_s aabb;
+typedef struct meshbounds_s meshbounds;
+
+// axis aligned box. a box is empty if any min component is greater than the
+// max component.
+struct aabb_s
+{
+    taa_vec3 min;
+    taa_vec3 max;
+};
+
+// bounds of the bind pose vertices of a mesh. skinned meshes also bound
+// the vertices influenced by each skin joint, so that the posed mesh can be
+// bounded without skinning it.
+struct meshbounds_s
+{
+    aabb box;
+    // one box per skin joint, or NULL if the mesh is not skinned
+    aabb* jointboxes;
+    // one past the highest skin joint index of the vertices
+    int numjoints;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void aabb_set_empty(
+    aabb* box_out);
+
+void aabb_merge(
+    const aabb* a,
+    const aabb* b,
+    aabb* box_out);
+
+// bounds the box after it has been transformed by the matrix
+void aabb_transform(
+    const aabb* box,
+    const taa_mat44* m,
+    aabb* box_out);
+
+// the mesh must have been formatted by skin_format_mesh
+void bounds_create_mesh(
+    const taa_scenemesh* mesh,
+    meshbounds* mb_out);
+
+void bounds_destroy_mesh(
+    meshbounds* mb);
+
+// bounds the mesh skinned by the palette. every skinned vertex is a
+// weighted average of its bind pose position transformed by each of its
+// joints, so it lies inside the union of the transformed joint boxes. the
+// palette must hold mb->numjoints matrices, and is ignored if the mesh is
+// not skinned.
+void bounds_calc_mesh(
+    const meshbounds* mb,
+    const taa_mat44* palette,
+    aabb* box_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOUNDS_H_
@@ -0,0 +1,272 @@
+#include "cullbvh.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//****************************************************************************
+static float cullbvh_center(
+    const aabb* box,
+    int axis)
+{
+    // empty boxes are placed at the origin
+    if(box->min.x > box->max.x)
+    {
+        return 0.0f;
+    }
+    return ((&box->min.x)[axis] + (&box->max.x)[axis]) * 0.5f;
+}
+
+//****************************************************************************
+// makes the node a leaf if it holds one item, otherwise splits the items
+// between two new children
+static void cullbvh_build_node(
+    cullbvh* bvh,
+    const aabb* boxes,
+    int* items,
+    int numitems,
+    int node)
+{
+    cullbvh_node* n = bvh->nodes + node;
+    if(numitems == 1)
+    {
+        n->box = boxes[items[0]];
+        n->child = -1;
+        n->item = items[0];
+        bvh->leaves[items[0]] = node;
+    }
+    else
+    {
+        float lo[3];
+        float hi[3];
+        float split;
+        int axis;
+        int mid;
+        int i;
+        for(axis = 0; axis < 3; ++axis)
+        {
+            lo[axis] = hi[axis] = cullbvh_center(boxes + items[0], axis);
+            for(i = 1; i < numitems; ++i)
+            {
+                float c = cullbvh_center(boxes + items[i], axis);
+                lo[axis] = (c < lo[axis]) ? c : lo[axis];
+                hi[axis] = (c > hi[axis]) ? c : hi[axis];
+            }
+        }
+        axis = 0;
+        if(hi[1] - lo[1] > hi[axis] - lo[axis])
+        {
+            axis = 1;
+        }
+        if(hi[2] - lo[2] > hi[axis] - lo[axis])
+        {
+            axis = 2;
+        }
+        split = (lo[axis] + hi[axis]) * 0.5f;
+        // move the items whose centers are below the split to the front
+        mid = 0;
+        for(i = 0; i < numitems; ++i)
+        {
+            if(cullbvh_center(boxes + items[i], axis) < split)
+            {
+                int tmp = items[i];
+                items[i] = items[mid];
+                items[mid] = tmp;
+                ++mid;
+            }
+        }
+        if(mid == 0 || mid == numitems)
+        {
+            // the centers coincide, so any split is as good
+            mid = numitems / 2;
+        }
+        n->child = bvh->numnodes;
+        n->item = -1;
+        bvh->numnodes += 2;
+        cullbvh_build_node(bvh, boxes, items, mid, n->child);
+        cullbvh_build_node(
+            bvh,
+            boxes,
+            items + mid,
+            numitems - mid,
+            n->child + 1);
+        aabb_merge(
+            &bvh->nodes[n->child].box,
+            &bvh->nodes[n->child + 1].box,
+            &n->box);
+    }
+}
+
+//****************************************************************************
+void cullbvh_create(
+    const aabb* boxes,
+    int numitems,
+    cullbvh* bvh_out)
+{
+    int maxnodes = (numitems > 0) ? 2*numitems - 1 : 0;
+    int* items;
+    int i;
+    bvh_out->nodes = (cullbvh_node*) malloc(
+        (maxnodes + 1) * sizeof(*bvh_out->nodes));
+    bvh_out->leaves = (int*) malloc((numitems + 1) * sizeof(int));
+    bvh_out->changed = (uint8_t*) calloc(maxnodes + 1, sizeof(uint8_t));
+    bvh_out->stack = (int*) malloc((2*maxnodes + 2) * sizeof(int));
+    bvh_out->numitems = numitems;
+    bvh_out->numchanged = 0;
+    bvh_out->numnodes = 0;
+    if(numitems > 0)
+    {
+        items = (int*) malloc(numitems * sizeof(*items));
+        for(i = 0; i < numitems; ++i)
+        {
+            items[i] = i;
+        }
+        bvh_out->numnodes = 1;
+        cullbvh_build_node(bvh_out, boxes, items, numitems, 0);
+        free(items);
+    }
+}
+
+//****************************************************************************
+void cullbvh_destroy(
+    cullbvh* bvh)
+{
+    free(bvh->stack);
+    free(bvh->changed);
+    free(bvh->leaves);
+    free(bvh->nodes);
+}
+
+//****************************************************************************
+void cullbvh_set_box(
+    cullbvh* bvh,
+    int item,
+    const aabb* box)
+{
+    int leaf = bvh->leaves[item];
+    bvh->nodes[leaf].box = *box;
+    bvh->changed[leaf] = 1;
+    ++bvh->numchanged;
+}
+
+//****************************************************************************
+void cullbvh_refit(
+    cullbvh* bvh)
+{
+    if(bvh->numchanged > 0)
+    {
+        cullbvh_node* nodes = bvh->nodes;
+        uint8_t* changed = bvh->changed;
+        int i;
+        // children are stored after their parents, so walking backwards
+        // visits every child before its parent
+        for(i = bvh->numnodes - 1; i >= 0; --i)
+        {
+            int child = nodes[i].child;
+            if(child >= 0 && (changed[child] || changed[child + 1]))
+            {
+                aabb_merge(
+                    &nodes[child].box,
+                    &nodes[child + 1].box,
+                    &nodes[i].box);
+                changed[i] = 1;
+            }
+        }
+        memset(changed, 0, bvh->numnodes * sizeof(*changed));
+        bvh->numchanged = 0;
+    }
+}
+
+//****************************************************************************
+void cullbvh_calc_frustum(
+    const taa_mat44* viewproj,
+    taa_vec4* planes_out)
+{
+    const taa_vec4* cols = &viewproj->x;
+    int i;
+    int c;
+    // each pair of planes is the bottom row of the matrix plus and minus
+    // one of the other rows. the matrix is column major, so row r is the
+    // r'th component of each column.
+    for(i = 0; i < 3; ++i)
+    {
+        float* lo = &planes_out[i*2 + 0].x;
+        float* hi = &planes_out[i*2 + 1].x;
+        for(c = 0; c < 4; ++c)
+        {
+            float w = (&cols[c].x)[3];
+            float v = (&cols[c].x)[i];
+            lo[c] = w + v;
+            hi[c] = w - v;
+        }
+    }
+}
+
+//****************************************************************************
+int cullbvh_cull(
+    cullbvh* bvh,
+    const taa_vec4* planes,
+    uint8_t* visible_out)
+{
+    const cullbvh_node* nodes = bvh->nodes;
+    int* stack = bvh->stack;
+    int top = 0;
+    int numvisible = 0;
+    memset(visible_out, 0, bvh->numitems * sizeof(*visible_out));
+    if(bvh->numnodes > 0)
+    {
+        // start with the root, tested against every plane
+        stack[top++] = 0;
+        stack[top++] = (1 << CULLBVH_NUM_PLANES) - 1;
+    }
+    while(top > 0)
+    {
+        int mask = stack[--top];
+        const cullbvh_node* n = nodes + stack[--top];
+        const aabb* box = &n->box;
+        int visible = (box->min.x <= box->max.x);
+        int p;
+        // the planes the node is entirely inside of are not tested again
+        // for its descendants
+        for(p = 0; visible && p < CULLBVH_NUM_PLANES; ++p)
+        {
+            if(mask & (1 << p))
+            {
+                const taa_vec4* pl = planes + p;
+                float d;
+                float r;
+                d = pl->x * (box->min.x + box->max.x) +
+                    pl->y * (box->min.y + box->max.y) +
+                    pl->z * (box->min.z + box->max.z);
+                r = (float) fabs(pl->x) * (box->max.x - box->min.x) +
+                    (float) fabs(pl->y) * (box->max.y - box->min.y) +
+                    (float) fabs(pl->z) * (box->max.z - box->min.z);
+                // d and r are both doubled, so the plane distance is too
+                d += 2.0f * pl->w;
+                if(d + r < 0.0f)
+                {
+                    visible = 0;
+                }
+                else if(d - r >= 0.0f)
+                {
+                    mask &= ~(1 << p);
+                }
+            }
+        }
+        if(visible)
+        {
+            if(n->child >= 0)
+            {
+                stack[top++] = n->child;
+                stack[top++] = mask;
+                stack[top++] = n->child + 1;
+                stack[top++] = mask;
+            }
+            else
+            {
+                visible_out[n->item] = 1;
+                ++numvisible;
+            }
+        }
+    }
+    return numvisible;
+}
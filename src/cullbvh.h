@@ -0,0 +1,84 @@
+#ifndef CULLBVH_H_
+#define CULLBVH_H_
+
+#include "bounds.h"
+
+typedef struct cullbvh_node_s cullbvh_node;
+typedef struct cullbvh_s cullbvh;
+
+enum
+{
+    CULLBVH_NUM_PLANES = 6
+};
+
+struct cullbvh_node_s
+{
+    aabb box;
+    // first of the node's two children, which are adjacent, or -1 for a leaf
+    int child;
+    // item of a leaf, or -1 for an internal node
+    int item;
+};
+
+// bounding volume hierarchy over a fixed set of items. the hierarchy is
+// built once, and afterwards the boxes of moving items are refitted
+// without changing its structure. children are always stored after their
+// parents.
+struct cullbvh_s
+{
+    cullbvh_node* nodes;
+    int numnodes;
+    // leaf node of each item
+    int* leaves;
+    int numitems;
+    // set for each node whose box changed since the previous refit
+    uint8_t* changed;
+    int numchanged;
+    // traversal stack of node and plane mask pairs
+    int* stack;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// builds the hierarchy by splitting the items at the middle of the
+// longest axis of their centers
+void cullbvh_create(
+    const aabb* boxes,
+    int numitems,
+    cullbvh* bvh_out);
+
+void cullbvh_destroy(
+    cullbvh* bvh);
+
+// replaces the box of an item. the ancestors are not updated until the
+// next refit.
+void cullbvh_set_box(
+    cullbvh* bvh,
+    int item,
+    const aabb* box);
+
+// recalculates the boxes of the ancestors of the items whose boxes changed
+void cullbvh_refit(
+    cullbvh* bvh);
+
+// extracts the clipping planes of a combined projection and view matrix.
+// points whose dot product with every plane is positive are inside.
+void cullbvh_calc_frustum(
+    const taa_mat44* viewproj,
+    taa_vec4* planes_out);
+
+// sets visible_out for each item whose box intersects the frustum, and
+// clears it for the rest. returns the number of visible items.
+int cullbvh_cull(
+    cullbvh* bvh,
+    const taa_vec4* planes,
+    uint8_t* visible_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CULLBVH_H_
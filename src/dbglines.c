@@ -0,0 +1,74 @@
+#include "dbglines.h"
+#include <string.h>
+
+//****************************************************************************
+void dbglines_create(
+    const glext* ext,
+    int maxlines,
+    dbglines* dl_out)
+{
+    size_t size = maxlines * 2 * sizeof(dbgvert);
+    dl_out->ext = *ext;
+    dl_out->sb = streambuf_create(&size, 1, ext);
+    dl_out->verts = NULL;
+    dl_out->numverts = 0;
+    dl_out->maxverts = maxlines * 2;
+}
+
+//****************************************************************************
+void dbglines_destroy(
+    dbglines* dl)
+{
+    streambuf_destroy(dl->sb);
+}
+
+//****************************************************************************
+void dbglines_begin(
+    dbglines* dl)
+{
+    streambuf_begin_frame(dl->sb);
+    dl->verts = (dbgvert*) streambuf_begin_write(dl->sb, 0);
+    dl->numverts = 0;
+}
+
+//****************************************************************************
+void dbglines_add(
+    dbglines* dl,
+    const taa_vec3* a,
+    const taa_vec3* b,
+    const uint8_t* color)
+{
+    if(dl->numverts + 2 <= dl->maxverts)
+    {
+        dbgvert* v = dl->verts + dl->numverts;
+        v[0].pos = *a;
+        v[1].pos = *b;
+        memcpy(v[0].color, color, sizeof(v[0].color));
+        memcpy(v[1].color, color, sizeof(v[1].color));
+        dl->numverts += 2;
+    }
+}
+
+//****************************************************************************
+void dbglines_end(
+    dbglines* dl)
+{
+    const glext* ext = &dl->ext;
+    const char* base;
+    streambuf_end_write(dl->sb, 0);
+    base = (const char*) streambuf_get_offset(dl->sb, 0);
+    if(dl->numverts > 0)
+    {
+        ext->bindbuffer(GL_ARRAY_BUFFER, streambuf_get_buffer(dl->sb));
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(3, GL_FLOAT, sizeof(dbgvert), base);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(dbgvert), base + 12);
+        glDrawArrays(GL_LINES, 0, dl->numverts);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        ext->bindbuffer(GL_ARRAY_BUFFER, 0);
+    }
+    streambuf_end_frame(dl->sb);
+    dl->verts = NULL;
+}
@@ -0,0 +1,65 @@
+#ifndef DBGLINES_H_
+#define DBGLINES_H_
+
+#include "streambuf.h"
+#include <taa/vec3.h>
+
+typedef struct dbgvert_s dbgvert;
+typedef struct dbglines_s dbglines;
+
+struct dbgvert_s
+{
+    taa_vec3 pos;
+    // rgba
+    uint8_t color[4];
+};
+
+// collects the world space debug lines of a frame into one range of a
+// stream buffer, and draws them all with a single draw call
+struct dbglines_s
+{
+    glext ext;
+    streambuf* sb;
+    // where the lines of the current frame are written, or NULL outside of
+    // dbglines_begin and dbglines_end
+    dbgvert* verts;
+    int numverts;
+    int maxverts;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// must be called from the rendering thread
+void dbglines_create(
+    const glext* ext,
+    int maxlines,
+    dbglines* dl_out);
+
+void dbglines_destroy(
+    dbglines* dl);
+
+// starts the lines of a frame
+void dbglines_begin(
+    dbglines* dl);
+
+// lines past the maximum are dropped
+void dbglines_add(
+    dbglines* dl,
+    const taa_vec3* a,
+    const taa_vec3* b,
+    const uint8_t* color);
+
+// draws the lines of the frame with the current modelview and projection
+// matrices. the vertex and color arrays are enabled for the draw only, and
+// the array buffer binding is left at zero.
+void dbglines_end(
+    dbglines* dl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DBGLINES_H_
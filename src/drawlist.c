@@ -0,0 +1,293 @@
+#include "drawlist.h"
+#include <stdlib.h>
+#include <string.h>
+
+//****************************************************************************
+static int drawlist_compare_cmds(
+    const void* a,
+    const void* b)
+{
+    const drawcmd* ca = (const drawcmd*) a;
+    const drawcmd* cb = (const drawcmd*) b;
+    // texture first since it is the most expensive state to change, then
+    // mesh so nodes that share vertices are drawn together
+    if(ca->texture != cb->texture)
+    {
+        return (ca->texture < cb->texture) ? -1 : 1;
+    }
+    if(ca->mesh != cb->mesh)
+    {
+        return (ca->mesh < cb->mesh) ? -1 : 1;
+    }
+    if(ca->node != cb->node)
+    {
+        return (ca->node < cb->node) ? -1 : 1;
+    }
+    return (ca->firstindex < cb->firstindex) ?
+        -1 :
+        (ca->firstindex > cb->firstindex);
+}
+
+//****************************************************************************
+// adds a command for each material binding of the mesh that has faces
+static int drawlist_add_cmds(
+    const taa_scene* scene,
+    int meshid,
+    int node,
+    int group,
+    drawcmd* cmds_out)
+{
+    const taa_scenemesh* mesh = scene->meshes + meshid;
+    const taa_scenemesh_binding* binditr = mesh->bindings;
+    const taa_scenemesh_binding* bindend = binditr + mesh->numbindings;
+    drawcmd* cmd = cmds_out;
+    while(binditr != bindend)
+    {
+        if(binditr->numfaces > 0)
+        {
+            const taa_scenemesh_face* fface;
+            const taa_scenemesh_face* lface;
+            fface = mesh->faces + binditr->firstface;
+            lface = fface + binditr->numfaces - 1;
+            cmd->texture = -1;
+            if(binditr->materialid >= 0)
+            {
+                const taa_scenematerial* mat;
+                mat = scene->materials + binditr->materialid;
+                cmd->texture = mat->diffusetexture;
+            }
+            cmd->mesh = meshid;
+            cmd->node = node;
+            cmd->group = group;
+            cmd->firstindex = fface->firstindex;
+            cmd->numindices = lface->firstindex + lface->numindices;
+            cmd->numindices -= cmd->firstindex;
+            cmd->firstbinding = (int) (binditr - mesh->bindings);
+            cmd->lastbinding = cmd->firstbinding;
+            ++cmd;
+        }
+        ++binditr;
+    }
+    return (int) (cmd - cmds_out);
+}
+
+//****************************************************************************
+void drawlist_create(
+    const taa_scene* scene,
+    int grouping,
+    drawlist* dl_out)
+{
+    int nummeshes = scene->nummeshes;
+    int numnodes = scene->numnodes;
+    int* meshgroups;
+    drawcmd* cmds;
+    int maxcmds;
+    int numcmds;
+    int i;
+    int j;
+    memset(dl_out, 0, sizeof(*dl_out));
+    dl_out->numnodes = numnodes;
+    // every unskinned mesh that a node references gets a group
+    meshgroups = (int*) malloc((nummeshes + 1) * sizeof(*meshgroups));
+    dl_out->groups = (drawgroup*) calloc(nummeshes+1, sizeof(*dl_out->groups));
+    dl_out->groupnodes = (int*) malloc((numnodes + 1) * sizeof(int));
+    for(i = 0; i < nummeshes; ++i)
+    {
+        meshgroups[i] = -1;
+    }
+    maxcmds = 0;
+    for(i = 0; i < numnodes; ++i)
+    {
+        const taa_scenenode* node = scene->nodes + i;
+        if(node->type == taa_SCENENODE_REF_MESH)
+        {
+            int meshid = node->value.meshid;
+            const taa_scenemesh* mesh = scene->meshes + meshid;
+            maxcmds += mesh->numbindings;
+            if(grouping && mesh->skeleton < 0 && meshgroups[meshid] < 0)
+            {
+                meshgroups[meshid] = dl_out->numgroups;
+                dl_out->groups[dl_out->numgroups].mesh = meshid;
+                ++dl_out->numgroups;
+            }
+            if(meshgroups[meshid] >= 0)
+            {
+                ++dl_out->groups[meshgroups[meshid]].numnodes;
+            }
+        }
+    }
+    j = 0;
+    for(i = 0; i < dl_out->numgroups; ++i)
+    {
+        dl_out->groups[i].firstnode = j;
+        j += dl_out->groups[i].numnodes;
+        dl_out->groups[i].numnodes = 0;
+    }
+    cmds = (drawcmd*) malloc((maxcmds + 1) * sizeof(*cmds));
+    numcmds = 0;
+    for(i = 0; i < numnodes; ++i)
+    {
+        const taa_scenenode* node = scene->nodes + i;
+        if(node->type == taa_SCENENODE_REF_MESH)
+        {
+            int meshid = node->value.meshid;
+            int group = meshgroups[meshid];
+            if(group >= 0)
+            {
+                drawgroup* g = dl_out->groups + group;
+                dl_out->groupnodes[g->firstnode + g->numnodes] = i;
+                ++g->numnodes;
+            }
+            else
+            {
+                numcmds += drawlist_add_cmds(
+                    scene,
+                    meshid,
+                    i,
+                    -1,
+                    cmds + numcmds);
+            }
+        }
+    }
+    for(i = 0; i < dl_out->numgroups; ++i)
+    {
+        numcmds += drawlist_add_cmds(
+            scene,
+            dl_out->groups[i].mesh,
+            -1,
+            i,
+            cmds + numcmds);
+    }
+    qsort(cmds, numcmds, sizeof(*cmds), drawlist_compare_cmds);
+    // the sort places ranges of the same node and texture in index order,
+    // so ranges that continue the previous one can be appended to it. the
+    // bindings must be consecutive as well, so that the merged range is
+    // also contiguous in simplified levels, which order their indices by
+    // binding.
+    j = 0;
+    for(i = 0; i < numcmds; ++i)
+    {
+        drawcmd* prev = cmds + j - 1;
+        const drawcmd* cmd = cmds + i;
+        if(j > 0 &&
+           prev->texture == cmd->texture &&
+           prev->mesh == cmd->mesh &&
+           prev->node == cmd->node &&
+           prev->firstindex + prev->numindices == cmd->firstindex &&
+           prev->lastbinding + 1 == cmd->firstbinding)
+        {
+            prev->numindices += cmd->numindices;
+            prev->lastbinding = cmd->lastbinding;
+        }
+        else
+        {
+            cmds[j++] = *cmd;
+        }
+    }
+    dl_out->cmds = cmds;
+    dl_out->numcmds = j;
+    free(meshgroups);
+}
+
+//****************************************************************************
+void drawlist_destroy(
+    drawlist* dl)
+{
+    free(dl->cmds);
+    free(dl->groups);
+    free(dl->groupnodes);
+}
+
+//****************************************************************************
+void drawstate_reset(
+    drawstate* ds)
+{
+    memset(ds, 0, sizeof(*ds));
+    ds->texturing = -1;
+    ds->quantized = -1;
+}
+
+//****************************************************************************
+void drawstate_set_texture(
+    drawstate* ds,
+    GLuint texture)
+{
+    int texturing = (texture != 0);
+    if(texturing != ds->texturing)
+    {
+        if(texturing)
+        {
+            glEnable(GL_TEXTURE_2D);
+        }
+        else
+        {
+            glDisable(GL_TEXTURE_2D);
+        }
+        ds->texturing = texturing;
+    }
+    if(texturing && texture != ds->texture)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        ds->texture = texture;
+    }
+}
+
+//****************************************************************************
+void drawstate_set_vertices(
+    drawstate* ds,
+    const glext* ext,
+    GLuint pnvbo,
+    size_t pnoffset,
+    GLuint texvbo,
+    GLuint ibo,
+    const vquant* vq)
+{
+    int quantized = (vq != NULL);
+    int layout = (quantized != ds->quantized);
+    if(layout || pnvbo != ds->pnvbo || pnoffset != ds->pnoffset)
+    {
+        const char* base = (const char*) pnoffset;
+        ext->bindbuffer(GL_ARRAY_BUFFER, pnvbo);
+        if(quantized)
+        {
+            // the texture coordinates are in the same buffer
+            glVertexPointer(3, GL_SHORT, sizeof(qvert), base);
+            glNormalPointer(GL_BYTE, sizeof(qvert), base + 8);
+            glTexCoordPointer(2, GL_SHORT, sizeof(qvert), base + 12);
+            ds->texvbo = 0;
+        }
+        else
+        {
+            glVertexPointer(3, GL_FLOAT, 24, base);
+            glNormalPointer(GL_FLOAT, 24, base + 12);
+        }
+        ds->pnvbo = pnvbo;
+        ds->pnoffset = pnoffset;
+    }
+    if(!quantized && (layout || texvbo != ds->texvbo))
+    {
+        ext->bindbuffer(GL_ARRAY_BUFFER, texvbo);
+        glTexCoordPointer(2, GL_FLOAT, 8, NULL);
+        ds->texvbo = texvbo;
+    }
+    if(layout || vq != ds->vq)
+    {
+        glMatrixMode(GL_TEXTURE);
+        if(quantized)
+        {
+            glLoadMatrixf(&vq->texmat.x.x);
+        }
+        else
+        {
+            glLoadIdentity();
+        }
+        glMatrixMode(GL_MODELVIEW);
+        ds->quantized = quantized;
+        ds->vq = vq;
+    }
+    if(ibo != ds->ibo)
+    {
+        ext->bindbuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        ds->ibo = ibo;
+    }
+}
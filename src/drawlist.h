@@ -0,0 +1,117 @@
+#ifndef DRAWLIST_H_
+#define DRAWLIST_H_
+
+#include "glext.h"
+#include "vquant.h"
+#include <taa/scene.h>
+
+typedef struct drawcmd_s drawcmd;
+typedef struct drawgroup_s drawgroup;
+typedef struct drawlist_s drawlist;
+typedef struct drawstate_s drawstate;
+
+// one indexed draw of a range of a mesh referenced by a node, or by every
+// node of a group
+struct drawcmd_s
+{
+    // diffuse texture of the material, or -1 if the range is untextured
+    int texture;
+    int mesh;
+    // node that references the mesh, or -1 if the command draws a group
+    int node;
+    // index of the group, or -1 if the command draws a single node
+    int group;
+    uint32_t firstindex;
+    uint32_t numindices;
+    // the consecutive material bindings of the mesh that the range covers
+    int firstbinding;
+    int lastbinding;
+};
+
+// unskinned mesh and the nodes that reference it, which are drawn together
+// by instanced draws
+struct drawgroup_s
+{
+    int mesh;
+    // range of the group's node indices in the drawlist's groupnodes
+    int firstnode;
+    int numnodes;
+};
+
+// draws of every mesh node of a scene, sorted by texture so that each
+// texture is bound once per frame. ranges of consecutive bindings of a node
+// that are adjacent in the index buffer and use the same texture are
+// merged into one draw.
+struct drawlist_s
+{
+    drawcmd* cmds;
+    int numcmds;
+    drawgroup* groups;
+    int numgroups;
+    int* groupnodes;
+    // number of nodes in the scene
+    int numnodes;
+};
+
+// the state last set through the cache, so redundant gl calls are skipped.
+// names are zero until they have been set.
+struct drawstate_s
+{
+    // -1 until set, otherwise whether GL_TEXTURE_2D is enabled
+    int texturing;
+    GLuint texture;
+    GLuint pnvbo;
+    size_t pnoffset;
+    GLuint texvbo;
+    GLuint ibo;
+    // -1 until set, otherwise whether the arrays point at qverts
+    int quantized;
+    // transforms of the quantized vertices, whose texture matrix is loaded
+    const vquant* vq;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// if grouping is set, the nodes that reference each unskinned mesh are
+// drawn by one command per range instead of one per range per node
+void drawlist_create(
+    const taa_scene* scene,
+    int grouping,
+    drawlist* dl_out);
+
+void drawlist_destroy(
+    drawlist* dl);
+
+// forgets the cached state. must be called whenever gl state is changed
+// without the cache, such as at the start of each frame.
+void drawstate_reset(
+    drawstate* ds);
+
+// binds the texture, or disables texturing if the texture is zero
+void drawstate_set_texture(
+    drawstate* ds,
+    GLuint texture);
+
+// points the vertex, normal, and texture coordinate arrays at the buffers,
+// and binds the index buffer. pnoffset is the byte offset of the position
+// normal vertices in pnvbo. if vq is not NULL, pnvbo holds qverts instead,
+// texvbo is ignored, and the texture matrix is set to the texture
+// transform of vq. the modelview matrix must include its position
+// transform. otherwise the texture matrix is the identity.
+void drawstate_set_vertices(
+    drawstate* ds,
+    const glext* ext,
+    GLuint pnvbo,
+    size_t pnoffset,
+    GLuint texvbo,
+    GLuint ibo,
+    const vquant* vq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DRAWLIST_H_
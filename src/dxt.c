@@ -0,0 +1,420 @@
+#include "dxt.h"
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+
+// byte offsets of the channels in a source pixel. the alpha offset is -1 if
+// the format has no alpha.
+typedef struct dxt_layout_s dxt_layout;
+
+struct dxt_layout_s
+{
+    int bpp;
+    int r;
+    int g;
+    int b;
+    int a;
+};
+
+//****************************************************************************
+static void dxt_get_layout(
+    int srcformat,
+    dxt_layout* layout_out)
+{
+    dxt_layout lum8  = { 1, 0, 0, 0, -1 };
+    dxt_layout bgr8  = { 3, 2, 1, 0, -1 };
+    dxt_layout bgra8 = { 4, 2, 1, 0,  3 };
+    dxt_layout rgb8  = { 3, 0, 1, 2, -1 };
+    dxt_layout rgba8 = { 4, 0, 1, 2,  3 };
+    switch(srcformat)
+    {
+    case taa_SCENETEXTURE_LUM8 : *layout_out = lum8 ; break;
+    case taa_SCENETEXTURE_BGR8 : *layout_out = bgr8 ; break;
+    case taa_SCENETEXTURE_BGRA8: *layout_out = bgra8; break;
+    case taa_SCENETEXTURE_RGB8 : *layout_out = rgb8 ; break;
+    case taa_SCENETEXTURE_RGBA8: *layout_out = rgba8; break;
+    default                    : *layout_out = lum8 ; break;
+    }
+}
+
+//****************************************************************************
+// copies a 4x4 block to rgba order. pixels past the edge of the image
+// repeat the last row or column.
+static void dxt_fetch_block(
+    const dxtlevel* level,
+    const dxt_layout* layout,
+    uint32_t bx,
+    uint32_t by,
+    unsigned char* rgba)
+{
+    const unsigned char* src = (const unsigned char*) level->src;
+    uint32_t x;
+    uint32_t y;
+    for(y = 0; y < 4; ++y)
+    {
+        uint32_t sy = by*4 + y;
+        sy = (sy < level->height) ? sy : level->height - 1;
+        for(x = 0; x < 4; ++x)
+        {
+            uint32_t sx = bx*4 + x;
+            const unsigned char* p;
+            sx = (sx < level->width) ? sx : level->width - 1;
+            p = src + (((size_t) sy)*level->width + sx)*layout->bpp;
+            rgba[0] = p[layout->r];
+            rgba[1] = p[layout->g];
+            rgba[2] = p[layout->b];
+            rgba[3] = (layout->a >= 0) ? p[layout->a] : 255;
+            rgba += 4;
+        }
+    }
+}
+
+//****************************************************************************
+static int dxt_to_565(
+    int r,
+    int g,
+    int b)
+{
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+//****************************************************************************
+static void dxt_from_565(
+    int c,
+    int* rgb_out)
+{
+    int r = (c >> 11) & 31;
+    int g = (c >> 5) & 63;
+    int b = c & 31;
+    rgb_out[0] = (r << 3) | (r >> 2);
+    rgb_out[1] = (g << 2) | (g >> 4);
+    rgb_out[2] = (b << 3) | (b >> 2);
+}
+
+//****************************************************************************
+// dot products of four pixels with the axis. the axis is 16 bit r,g,b,0
+// repeated for two pixels.
+static __m128 dxt_project(
+    __m128i pixels,
+    __m128i axis)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), axis);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), axis);
+    // each pixel is now r*dr+g*dg and b*db in adjacent lanes
+    lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+    hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+    return _mm_cvtepi32_ps(_mm_castps_si128(_mm_shuffle_ps(
+        _mm_castsi128_ps(lo),
+        _mm_castsi128_ps(hi),
+        _MM_SHUFFLE(2,0,2,0))));
+}
+
+//****************************************************************************
+// bc1 color block using the inset bounding box of the block as endpoints.
+// each pixel is assigned to the nearest palette entry along the endpoint
+// axis.
+static void dxt_encode_color(
+    const unsigned char* rgba,
+    unsigned char* out)
+{
+    // index in the block for each position between the min and max color
+    static const unsigned int remap[4] = { 1, 3, 2, 0 };
+    const __m128i* block = (const __m128i*) rgba;
+    __m128i mn;
+    __m128i mx;
+    int cmin;
+    int cmax;
+    int emin[3];
+    int emax[3];
+    int c0;
+    int c1;
+    unsigned int bits = 0;
+    int i;
+    mn = _mm_min_epu8(
+        _mm_min_epu8(block[0], block[1]),
+        _mm_min_epu8(block[2], block[3]));
+    mx = _mm_max_epu8(
+        _mm_max_epu8(block[0], block[1]),
+        _mm_max_epu8(block[2], block[3]));
+    mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(1,0,3,2)));
+    mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(2,3,0,1)));
+    mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(1,0,3,2)));
+    mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(2,3,0,1)));
+    cmin = _mm_cvtsi128_si32(mn);
+    cmax = _mm_cvtsi128_si32(mx);
+    for(i = 0; i < 3; ++i)
+    {
+        // pull the endpoints in by 1/16 of the range to reduce the error
+        // of the colors in the middle of the block
+        int lo = (cmin >> (i*8)) & 0xff;
+        int hi = (cmax >> (i*8)) & 0xff;
+        int inset = (hi - lo) >> 4;
+        emin[i] = lo + inset;
+        emax[i] = hi - inset;
+    }
+    c0 = dxt_to_565(emax[0], emax[1], emax[2]);
+    c1 = dxt_to_565(emin[0], emin[1], emin[2]);
+    if(c0 < c1)
+    {
+        int tmp = c0;
+        c0 = c1;
+        c1 = tmp;
+    }
+    if(c0 != c1)
+    {
+        __m128i axis;
+        __m128 scale;
+        __m128 bias;
+        __m128 three = _mm_set1_ps(3.0f);
+        __m128 zero = _mm_setzero_ps();
+        float d0;
+        float d1;
+        unsigned int t[16];
+        dxt_from_565(c0, emax);
+        dxt_from_565(c1, emin);
+        axis = _mm_set_epi16(
+            0,
+            (short) (emax[2] - emin[2]),
+            (short) (emax[1] - emin[1]),
+            (short) (emax[0] - emin[0]),
+            0,
+            (short) (emax[2] - emin[2]),
+            (short) (emax[1] - emin[1]),
+            (short) (emax[0] - emin[0]));
+        d0 = (float) ((emax[0]-emin[0])*emax[0] +
+                      (emax[1]-emin[1])*emax[1] +
+                      (emax[2]-emin[2])*emax[2]);
+        d1 = (float) ((emax[0]-emin[0])*emin[0] +
+                      (emax[1]-emin[1])*emin[1] +
+                      (emax[2]-emin[2])*emin[2]);
+        // t = round(3 * (dot - d1) / (d0 - d1)) clamped to [0, 3]
+        scale = _mm_set1_ps(3.0f / (d0 - d1));
+        bias = _mm_set1_ps(0.5f - d1*3.0f/(d0 - d1));
+        for(i = 0; i < 4; ++i)
+        {
+            __m128 f = dxt_project(block[i], axis);
+            f = _mm_add_ps(_mm_mul_ps(f, scale), bias);
+            f = _mm_min_ps(_mm_max_ps(f, zero), three);
+            _mm_storeu_si128((__m128i*) (t + i*4), _mm_cvttps_epi32(f));
+        }
+        for(i = 0; i < 16; ++i)
+        {
+            bits |= remap[t[i]] << (i*2);
+        }
+    }
+    out[0] = (unsigned char) (c0 & 0xff);
+    out[1] = (unsigned char) (c0 >> 8);
+    out[2] = (unsigned char) (c1 & 0xff);
+    out[3] = (unsigned char) (c1 >> 8);
+    out[4] = (unsigned char) (bits & 0xff);
+    out[5] = (unsigned char) ((bits >> 8) & 0xff);
+    out[6] = (unsigned char) ((bits >> 16) & 0xff);
+    out[7] = (unsigned char) (bits >> 24);
+}
+
+//****************************************************************************
+// bc3 alpha block in the eight value mode
+static void dxt_encode_alpha(
+    const unsigned char* rgba,
+    unsigned char* out)
+{
+    int amin = 255;
+    int amax = 0;
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+    int i;
+    for(i = 0; i < 16; ++i)
+    {
+        int a = rgba[i*4 + 3];
+        amin = (a < amin) ? a : amin;
+        amax = (a > amax) ? a : amax;
+    }
+    if(amax > amin)
+    {
+        int range = amax - amin;
+        for(i = 0; i < 16; ++i)
+        {
+            // t is the position between the min and max alpha. index 0 is
+            // the max, 1 is the min, and 2-7 interpolate from max to min.
+            int t = ((rgba[i*4 + 3] - amin)*7 + range/2) / range;
+            uint32_t idx = (t == 7) ? 0 : ((t == 0) ? 1 : 8 - t);
+            if(i < 8)
+            {
+                lo |= idx << (i*3);
+            }
+            else
+            {
+                hi |= idx << ((i - 8)*3);
+            }
+        }
+    }
+    out[0] = (unsigned char) amax;
+    out[1] = (unsigned char) amin;
+    out[2] = (unsigned char) (lo & 0xff);
+    out[3] = (unsigned char) ((lo >> 8) & 0xff);
+    out[4] = (unsigned char) ((lo >> 16) & 0xff);
+    out[5] = (unsigned char) (hi & 0xff);
+    out[6] = (unsigned char) ((hi >> 8) & 0xff);
+    out[7] = (unsigned char) ((hi >> 16) & 0xff);
+}
+
+//****************************************************************************
+static void dxt_compress_rows(
+    const dxtlevel* level,
+    int format,
+    uint32_t firstrow,
+    uint32_t endrow)
+{
+    __m128i block[4];
+    unsigned char* rgba = (unsigned char*) block;
+    uint32_t numcols = (level->width + 3) / 4;
+    size_t blocksize = (format == DXT_BC3) ? 16 : 8;
+    unsigned char* dst = (unsigned char*) level->dst;
+    dxt_layout layout;
+    uint32_t bx;
+    uint32_t by;
+    dxt_get_layout(level->srcformat, &layout);
+    dst += ((size_t) firstrow) * numcols * blocksize;
+    for(by = firstrow; by < endrow; ++by)
+    {
+        for(bx = 0; bx < numcols; ++bx)
+        {
+            dxt_fetch_block(level, &layout, bx, by, rgba);
+            if(format == DXT_BC3)
+            {
+                dxt_encode_alpha(rgba, dst);
+                dxt_encode_color(rgba, dst + 8);
+            }
+            else
+            {
+                dxt_encode_color(rgba, dst);
+            }
+            dst += blocksize;
+        }
+    }
+}
+
+//****************************************************************************
+static void dxt_run_bc1_task(
+    void* userdata,
+    int first,
+    int end)
+{
+    dxt_compress_rows((const dxtlevel*) userdata, DXT_BC1, first, end);
+}
+
+//****************************************************************************
+static void dxt_run_bc3_task(
+    void* userdata,
+    int first,
+    int end)
+{
+    dxt_compress_rows((const dxtlevel*) userdata, DXT_BC3, first, end);
+}
+
+//****************************************************************************
+size_t dxt_get_level_size(
+    int format,
+    uint32_t width,
+    uint32_t height)
+{
+    size_t numblocks = ((width + 3) / 4) * ((height + 3) / 4);
+    size_t blocksize = 0;
+    switch(format)
+    {
+    case DXT_BC1: blocksize = 8; break;
+    case DXT_BC3: blocksize = 16; break;
+    }
+    return numblocks * blocksize;
+}
+
+//****************************************************************************
+void dxt_create_texture(
+    const taa_scenetexture* scntex,
+    dxttexture* tex_out)
+{
+    int format = DXT_BC1;
+    size_t size = 0;
+    char* itr;
+    uint32_t i;
+    if(scntex->format == taa_SCENETEXTURE_BGRA8 ||
+       scntex->format == taa_SCENETEXTURE_RGBA8)
+    {
+        format = DXT_BC3;
+    }
+    tex_out->format = format;
+    tex_out->numlevels = scntex->numlevels;
+    tex_out->levels = (dxtlevel*) calloc(
+        scntex->numlevels + 1,
+        sizeof(*tex_out->levels));
+    for(i = 0; i < scntex->numlevels; ++i)
+    {
+        dxtlevel* level = tex_out->levels + i;
+        uint32_t w = scntex->width >> i;
+        uint32_t h = scntex->height >> i;
+        level->src = scntex->images[i];
+        level->srcformat = scntex->format;
+        level->width = (w > 0) ? w : 1;
+        level->height = (h > 0) ? h : 1;
+        level->size = dxt_get_level_size(format, level->width, level->height);
+        size += level->size;
+    }
+    tex_out->data = malloc(size + 1);
+    itr = (char*) tex_out->data;
+    for(i = 0; i < scntex->numlevels; ++i)
+    {
+        tex_out->levels[i].dst = itr;
+        itr += tex_out->levels[i].size;
+    }
+}
+
+//****************************************************************************
+void dxt_destroy_texture(
+    dxttexture* tex)
+{
+    free(tex->data);
+    free(tex->levels);
+}
+
+//****************************************************************************
+int dxt_count_tasks(
+    const dxttexture* tex)
+{
+    int numtasks = 0;
+    uint32_t i;
+    for(i = 0; i < tex->numlevels; ++i)
+    {
+        uint32_t numrows = (tex->levels[i].height + 3) / 4;
+        numtasks += (numrows + DXT_TASK_ROWS - 1) / DXT_TASK_ROWS;
+    }
+    return numtasks;
+}
+
+//****************************************************************************
+int dxt_add_tasks(
+    dxttexture* tex,
+    taskpool_task* tasks_out)
+{
+    taskpool_task* task = tasks_out;
+    uint32_t i;
+    for(i = 0; i < tex->numlevels; ++i)
+    {
+        dxtlevel* level = tex->levels + i;
+        uint32_t numrows = (level->height + 3) / 4;
+        uint32_t row;
+        for(row = 0; row < numrows; row += DXT_TASK_ROWS)
+        {
+            uint32_t end = row + DXT_TASK_ROWS;
+            task->func = (tex->format == DXT_BC3) ?
+                dxt_run_bc3_task :
+                dxt_run_bc1_task;
+            task->userdata = level;
+            task->first = row;
+            task->end = (end < numrows) ? end : numrows;
+            task->counter = NULL;
+            ++task;
+        }
+    }
+    return (int) (task - tasks_out);
+}
@@ -0,0 +1,81 @@
+#ifndef DXT_H_
+#define DXT_H_
+
+#include "taskpool.h"
+#include <taa/scene.h>
+
+typedef struct dxtlevel_s dxtlevel;
+typedef struct dxttexture_s dxttexture;
+
+enum
+{
+    DXT_NONE,
+    // rgb, 8 bytes per 4x4 block
+    DXT_BC1,
+    // rgba, 16 bytes per 4x4 block
+    DXT_BC3
+};
+
+enum
+{
+    // number of rows of blocks compressed by one task
+    DXT_TASK_ROWS = 16
+};
+
+struct dxtlevel_s
+{
+    // uncompressed pixels in one of the taa_SCENETEXTURE formats. may be
+    // NULL if the level was loaded already compressed.
+    const void* src;
+    int srcformat;
+    uint32_t width;
+    uint32_t height;
+    // compressed blocks, in rows from the top left
+    void* dst;
+    size_t size;
+};
+
+// block compressed copy of a scene texture
+struct dxttexture_s
+{
+    int format;
+    uint32_t numlevels;
+    dxtlevel* levels;
+    // allocation holding the compressed levels, or NULL if the levels point
+    // to memory owned by something else
+    void* data;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+size_t dxt_get_level_size(
+    int format,
+    uint32_t width,
+    uint32_t height);
+
+// allocates the compressed levels of a scene texture. textures with alpha
+// are compressed to bc3, and the rest to bc1. the blocks are not filled in
+// until the tasks from dxt_add_tasks are run.
+void dxt_create_texture(
+    const taa_scenetexture* scntex,
+    dxttexture* tex_out);
+
+void dxt_destroy_texture(
+    dxttexture* tex);
+
+int dxt_count_tasks(
+    const dxttexture* tex);
+
+// adds tasks that compress DXT_TASK_ROWS rows of blocks each
+int dxt_add_tasks(
+    dxttexture* tex,
+    taskpool_task* tasks_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DXT_H_
@@ -0,0 +1,245 @@
+#include "glext.h"
+#include <stdio.h>
+#include <string.h>
+#ifndef WIN32
+#include <GL/glx.h>
+#endif
+
+//****************************************************************************
+static void* glext_get_proc(
+    const char* name)
+{
+#ifdef WIN32
+    return (void*) wglGetProcAddress(name);
+#else
+    return (void*) glXGetProcAddressARB((const GLubyte*) name);
+#endif
+}
+
+//****************************************************************************
+// loads the core entry point, or the entry point of the extension it was
+// promoted from
+static void* glext_get_proc2(
+    const char* name,
+    const char* extname)
+{
+    void* proc = glext_get_proc(name);
+    return (proc != NULL) ? proc : glext_get_proc(extname);
+}
+
+//****************************************************************************
+static int glext_has_version(
+    const glext* ext,
+    int major,
+    int minor)
+{
+    return ext->major > major || (ext->major == major && ext->minor >= minor);
+}
+
+//****************************************************************************
+int glext_is_supported(
+    const char* name)
+{
+    const char* exts = (const char*) glGetString(GL_EXTENSIONS);
+    size_t len = strlen(name);
+    int found = 0;
+    if(exts != NULL)
+    {
+        const char* itr = strstr(exts, name);
+        while(itr != NULL && !found)
+        {
+            // only match whole names, not prefixes of longer names
+            int start = (itr == exts || itr[-1] == ' ');
+            int end = (itr[len] == ' ' || itr[len] == '\0');
+            found = start && end;
+            itr = strstr(itr + len, name);
+        }
+    }
+    return found;
+}
+
+//****************************************************************************
+void glext_load(
+    glext* ext_out)
+{
+    const char* version = (const char*) glGetString(GL_VERSION);
+    memset(ext_out, 0, sizeof(*ext_out));
+    if(version != NULL)
+    {
+        sscanf(version, "%d.%d", &ext_out->major, &ext_out->minor);
+    }
+    // some drivers return addresses for entry points they do not support,
+    // so the version or extension is always checked as well
+    ext_out->compressedteximage2d = (glext_compressedteximage2d_fn)
+        glext_get_proc2(
+            "glCompressedTexImage2D",
+            "glCompressedTexImage2DARB");
+    ext_out->s3tc =
+        ext_out->compressedteximage2d != NULL &&
+        glext_is_supported("GL_EXT_texture_compression_s3tc");
+
+    ext_out->genbuffers = (glext_genbuffers_fn)
+        glext_get_proc2("glGenBuffers", "glGenBuffersARB");
+    ext_out->deletebuffers = (glext_deletebuffers_fn)
+        glext_get_proc2("glDeleteBuffers", "glDeleteBuffersARB");
+    ext_out->bindbuffer = (glext_bindbuffer_fn)
+        glext_get_proc2("glBindBuffer", "glBindBufferARB");
+    ext_out->bufferdata = (glext_bufferdata_fn)
+        glext_get_proc2("glBufferData", "glBufferDataARB");
+    ext_out->buffersubdata = (glext_buffersubdata_fn)
+        glext_get_proc2("glBufferSubData", "glBufferSubDataARB");
+    ext_out->vbo =
+        (glext_has_version(ext_out, 1, 5) ||
+         glext_is_supported("GL_ARB_vertex_buffer_object")) &&
+        ext_out->genbuffers != NULL &&
+        ext_out->deletebuffers != NULL &&
+        ext_out->bindbuffer != NULL &&
+        ext_out->bufferdata != NULL &&
+        ext_out->buffersubdata != NULL;
+
+    ext_out->bufferstorage = (glext_bufferstorage_fn)
+        glext_get_proc("glBufferStorage");
+    ext_out->mapbufferrange = (glext_mapbufferrange_fn)
+        glext_get_proc("glMapBufferRange");
+    ext_out->unmapbuffer = (glext_unmapbuffer_fn)
+        glext_get_proc2("glUnmapBuffer", "glUnmapBufferARB");
+    ext_out->fencesync = (glext_fencesync_fn)
+        glext_get_proc("glFenceSync");
+    ext_out->clientwaitsync = (glext_clientwaitsync_fn)
+        glext_get_proc("glClientWaitSync");
+    ext_out->deletesync = (glext_deletesync_fn)
+        glext_get_proc("glDeleteSync");
+    ext_out->persistent =
+        ext_out->vbo &&
+        (glext_has_version(ext_out, 4, 4) ||
+         (glext_is_supported("GL_ARB_buffer_storage") &&
+          glext_is_supported("GL_ARB_map_buffer_range") &&
+          glext_is_supported("GL_ARB_sync"))) &&
+        ext_out->bufferstorage != NULL &&
+        ext_out->mapbufferrange != NULL &&
+        ext_out->unmapbuffer != NULL &&
+        ext_out->fencesync != NULL &&
+        ext_out->clientwaitsync != NULL &&
+        ext_out->deletesync != NULL;
+
+    ext_out->createshader = (glext_createshader_fn)
+        glext_get_proc("glCreateShader");
+    ext_out->shadersource = (glext_shadersource_fn)
+        glext_get_proc("glShaderSource");
+    ext_out->compileshader = (glext_compileshader_fn)
+        glext_get_proc("glCompileShader");
+    ext_out->getshaderiv = (glext_getshaderiv_fn)
+        glext_get_proc("glGetShaderiv");
+    ext_out->getshaderinfolog = (glext_getshaderinfolog_fn)
+        glext_get_proc("glGetShaderInfoLog");
+    ext_out->deleteshader = (glext_deleteshader_fn)
+        glext_get_proc("glDeleteShader");
+    ext_out->createprogram = (glext_createprogram_fn)
+        glext_get_proc("glCreateProgram");
+    ext_out->attachshader = (glext_attachshader_fn)
+        glext_get_proc("glAttachShader");
+    ext_out->bindattriblocation = (glext_bindattriblocation_fn)
+        glext_get_proc("glBindAttribLocation");
+    ext_out->linkprogram = (glext_linkprogram_fn)
+        glext_get_proc("glLinkProgram");
+    ext_out->getprogramiv = (glext_getprogramiv_fn)
+        glext_get_proc("glGetProgramiv");
+    ext_out->getprograminfolog = (glext_getprograminfolog_fn)
+        glext_get_proc("glGetProgramInfoLog");
+    ext_out->deleteprogram = (glext_deleteprogram_fn)
+        glext_get_proc("glDeleteProgram");
+    ext_out->useprogram = (glext_useprogram_fn)
+        glext_get_proc("glUseProgram");
+    ext_out->getuniformlocation = (glext_getuniformlocation_fn)
+        glext_get_proc("glGetUniformLocation");
+    ext_out->uniform4fv = (glext_uniform4fv_fn)
+        glext_get_proc("glUniform4fv");
+    ext_out->vertexattribpointer = (glext_vertexattribpointer_fn)
+        glext_get_proc("glVertexAttribPointer");
+    ext_out->enablevertexattribarray = (glext_enablevertexattribarray_fn)
+        glext_get_proc("glEnableVertexAttribArray");
+    ext_out->disablevertexattribarray = (glext_disablevertexattribarray_fn)
+        glext_get_proc("glDisableVertexAttribArray");
+    ext_out->shaders =
+        glext_has_version(ext_out, 2, 0) &&
+        ext_out->createshader != NULL &&
+        ext_out->shadersource != NULL &&
+        ext_out->compileshader != NULL &&
+        ext_out->getshaderiv != NULL &&
+        ext_out->getshaderinfolog != NULL &&
+        ext_out->deleteshader != NULL &&
+        ext_out->createprogram != NULL &&
+        ext_out->attachshader != NULL &&
+        ext_out->bindattriblocation != NULL &&
+        ext_out->linkprogram != NULL &&
+        ext_out->getprogramiv != NULL &&
+        ext_out->getprograminfolog != NULL &&
+        ext_out->deleteprogram != NULL &&
+        ext_out->useprogram != NULL &&
+        ext_out->getuniformlocation != NULL &&
+        ext_out->uniform4fv != NULL &&
+        ext_out->vertexattribpointer != NULL &&
+        ext_out->enablevertexattribarray != NULL &&
+        ext_out->disablevertexattribarray != NULL;
+
+    ext_out->drawelementsinstanced = (glext_drawelementsinstanced_fn)
+        glext_get_proc2(
+            "glDrawElementsInstanced",
+            "glDrawElementsInstancedARB");
+    ext_out->vertexattribdivisor = (glext_vertexattribdivisor_fn)
+        glext_get_proc2("glVertexAttribDivisor", "glVertexAttribDivisorARB");
+    ext_out->instancing =
+        ext_out->shaders &&
+        (glext_has_version(ext_out, 3, 3) ||
+         (glext_is_supported("GL_ARB_draw_instanced") &&
+          glext_is_supported("GL_ARB_instanced_arrays"))) &&
+        ext_out->drawelementsinstanced != NULL &&
+        ext_out->vertexattribdivisor != NULL;
+}
+
+//****************************************************************************
+GLuint glext_create_program(
+    const glext* ext,
+    const GLchar* const* sources,
+    int numsources,
+    const char* const* attribs,
+    int numattribs,
+    GLuint firstattrib)
+{
+    GLuint vsh;
+    GLuint program = 0;
+    GLint status;
+    int i;
+    vsh = ext->createshader(GL_VERTEX_SHADER);
+    ext->shadersource(vsh, numsources, sources, NULL);
+    ext->compileshader(vsh);
+    ext->getshaderiv(vsh, GL_COMPILE_STATUS, &status);
+    if(status == GL_FALSE)
+    {
+        char log[1024];
+        ext->getshaderinfolog(vsh, sizeof(log), NULL, log);
+        printf("could not compile shader:\n%s\n", log);
+    }
+    else
+    {
+        program = ext->createprogram();
+        ext->attachshader(program, vsh);
+        for(i = 0; i < numattribs; ++i)
+        {
+            ext->bindattriblocation(program, firstattrib + i, attribs[i]);
+        }
+        ext->linkprogram(program);
+        ext->getprogramiv(program, GL_LINK_STATUS, &status);
+        if(status == GL_FALSE)
+        {
+            char log[1024];
+            ext->getprograminfolog(program, sizeof(log), NULL, log);
+            printf("could not link shader:\n%s\n", log);
+            ext->deleteprogram(program);
+            program = 0;
+        }
+    }
+    // the shader is freed along with the program
+    ext->deleteshader(vsh);
+    return program;
+}
@@ -0,0 +1,294 @@
+#ifndef GLEXT_H_
+#define GLEXT_H_
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#ifndef GL_VERSION_1_5
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_STATIC_DRAW 0x88E4
+#define GL_STREAM_DRAW 0x88E0
+#define GL_DYNAMIC_DRAW 0x88E8
+#endif
+#ifndef GL_VERSION_2_0
+typedef char GLchar;
+#define GL_VERTEX_SHADER 0x8B31
+#define GL_MAX_VERTEX_UNIFORM_COMPONENTS 0x8B4A
+#define GL_COMPILE_STATUS 0x8B81
+#define GL_LINK_STATUS 0x8B82
+#define GL_INFO_LOG_LENGTH 0x8B84
+#endif
+#ifndef GL_VERSION_3_0
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_VERSION_3_2
+typedef struct __GLsync* GLsync;
+typedef uint64_t GLuint64;
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_WAIT_FAILED 0x911D
+#endif
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+typedef struct glext_s glext;
+
+typedef void (APIENTRY *glext_compressedteximage2d_fn)(
+    GLenum target,
+    GLint level,
+    GLenum internalformat,
+    GLsizei width,
+    GLsizei height,
+    GLint border,
+    GLsizei imagesize,
+    const GLvoid* data);
+
+typedef void (APIENTRY *glext_genbuffers_fn)(
+    GLsizei n,
+    GLuint* buffers);
+
+typedef void (APIENTRY *glext_deletebuffers_fn)(
+    GLsizei n,
+    const GLuint* buffers);
+
+typedef void (APIENTRY *glext_bindbuffer_fn)(
+    GLenum target,
+    GLuint buffer);
+
+typedef void (APIENTRY *glext_bufferdata_fn)(
+    GLenum target,
+    GLsizeiptr size,
+    const GLvoid* data,
+    GLenum usage);
+
+typedef void (APIENTRY *glext_buffersubdata_fn)(
+    GLenum target,
+    GLintptr offset,
+    GLsizeiptr size,
+    const GLvoid* data);
+
+typedef void (APIENTRY *glext_bufferstorage_fn)(
+    GLenum target,
+    GLsizeiptr size,
+    const GLvoid* data,
+    GLbitfield flags);
+
+typedef void* (APIENTRY *glext_mapbufferrange_fn)(
+    GLenum target,
+    GLintptr offset,
+    GLsizeiptr length,
+    GLbitfield access);
+
+typedef GLboolean (APIENTRY *glext_unmapbuffer_fn)(
+    GLenum target);
+
+typedef GLsync (APIENTRY *glext_fencesync_fn)(
+    GLenum condition,
+    GLbitfield flags);
+
+typedef GLenum (APIENTRY *glext_clientwaitsync_fn)(
+    GLsync sync,
+    GLbitfield flags,
+    GLuint64 timeout);
+
+typedef void (APIENTRY *glext_deletesync_fn)(
+    GLsync sync);
+
+typedef GLuint (APIENTRY *glext_createshader_fn)(
+    GLenum type);
+
+typedef void (APIENTRY *glext_shadersource_fn)(
+    GLuint shader,
+    GLsizei count,
+    const GLchar* const* string,
+    const GLint* length);
+
+typedef void (APIENTRY *glext_compileshader_fn)(
+    GLuint shader);
+
+typedef void (APIENTRY *glext_getshaderiv_fn)(
+    GLuint shader,
+    GLenum pname,
+    GLint* params);
+
+typedef void (APIENTRY *glext_getshaderinfolog_fn)(
+    GLuint shader,
+    GLsizei bufsize,
+    GLsizei* length,
+    GLchar* infolog);
+
+typedef void (APIENTRY *glext_deleteshader_fn)(
+    GLuint shader);
+
+typedef GLuint (APIENTRY *glext_createprogram_fn)(
+    void);
+
+typedef void (APIENTRY *glext_attachshader_fn)(
+    GLuint program,
+    GLuint shader);
+
+typedef void (APIENTRY *glext_bindattriblocation_fn)(
+    GLuint program,
+    GLuint index,
+    const GLchar* name);
+
+typedef void (APIENTRY *glext_linkprogram_fn)(
+    GLuint program);
+
+typedef void (APIENTRY *glext_getprogramiv_fn)(
+    GLuint program,
+    GLenum pname,
+    GLint* params);
+
+typedef void (APIENTRY *glext_getprograminfolog_fn)(
+    GLuint program,
+    GLsizei bufsize,
+    GLsizei* length,
+    GLchar* infolog);
+
+typedef void (APIENTRY *glext_deleteprogram_fn)(
+    GLuint program);
+
+typedef void (APIENTRY *glext_useprogram_fn)(
+    GLuint program);
+
+typedef GLint (APIENTRY *glext_getuniformlocation_fn)(
+    GLuint program,
+    const GLchar* name);
+
+typedef void (APIENTRY *glext_uniform4fv_fn)(
+    GLint location,
+    GLsizei count,
+    const GLfloat* value);
+
+typedef void (APIENTRY *glext_vertexattribpointer_fn)(
+    GLuint index,
+    GLint size,
+    GLenum type,
+    GLboolean normalized,
+    GLsizei stride,
+    const GLvoid* pointer);
+
+typedef void (APIENTRY *glext_enablevertexattribarray_fn)(
+    GLuint index);
+
+typedef void (APIENTRY *glext_disablevertexattribarray_fn)(
+    GLuint index);
+
+typedef void (APIENTRY *glext_drawelementsinstanced_fn)(
+    GLenum mode,
+    GLsizei count,
+    GLenum type,
+    const GLvoid* indices,
+    GLsizei primcount);
+
+typedef void (APIENTRY *glext_vertexattribdivisor_fn)(
+    GLuint index,
+    GLuint divisor);
+
+// opengl entry points and extensions beyond 1.1, which have to be queried
+// at runtime. entry points that are not available are NULL.
+struct glext_s
+{
+    int major;
+    int minor;
+    // GL_EXT_texture_compression_s3tc
+    int s3tc;
+    glext_compressedteximage2d_fn compressedteximage2d;
+    // opengl 1.5 or GL_ARB_vertex_buffer_object
+    int vbo;
+    glext_genbuffers_fn genbuffers;
+    glext_deletebuffers_fn deletebuffers;
+    glext_bindbuffer_fn bindbuffer;
+    glext_bufferdata_fn bufferdata;
+    glext_buffersubdata_fn buffersubdata;
+    // persistently mapped buffers, which need opengl 4.4 or
+    // GL_ARB_buffer_storage along with mapped ranges and fences
+    int persistent;
+    glext_bufferstorage_fn bufferstorage;
+    glext_mapbufferrange_fn mapbufferrange;
+    glext_unmapbuffer_fn unmapbuffer;
+    glext_fencesync_fn fencesync;
+    glext_clientwaitsync_fn clientwaitsync;
+    glext_deletesync_fn deletesync;
+    // glsl shaders, which need opengl 2.0
+    int shaders;
+    glext_createshader_fn createshader;
+    glext_shadersource_fn shadersource;
+    glext_compileshader_fn compileshader;
+    glext_getshaderiv_fn getshaderiv;
+    glext_getshaderinfolog_fn getshaderinfolog;
+    glext_deleteshader_fn deleteshader;
+    glext_createprogram_fn createprogram;
+    glext_attachshader_fn attachshader;
+    glext_bindattriblocation_fn bindattriblocation;
+    glext_linkprogram_fn linkprogram;
+    glext_getprogramiv_fn getprogramiv;
+    glext_getprograminfolog_fn getprograminfolog;
+    glext_deleteprogram_fn deleteprogram;
+    glext_useprogram_fn useprogram;
+    glext_getuniformlocation_fn getuniformlocation;
+    glext_uniform4fv_fn uniform4fv;
+    glext_vertexattribpointer_fn vertexattribpointer;
+    glext_enablevertexattribarray_fn enablevertexattribarray;
+    glext_disablevertexattribarray_fn disablevertexattribarray;
+    // instanced draws with per instance attributes, which need shaders and
+    // opengl 3.3 or GL_ARB_draw_instanced and GL_ARB_instanced_arrays
+    int instancing;
+    glext_drawelementsinstanced_fn drawelementsinstanced;
+    glext_vertexattribdivisor_fn vertexattribdivisor;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// must be called with the rendering context current
+void glext_load(
+    glext* ext_out);
+
+// checks the extension string of the current context for the extension
+int glext_is_supported(
+    const char* name);
+
+// compiles and links a program with only a vertex shader, so fragments are
+// shaded by fixed function. the named attributes are bound to consecutive
+// locations starting at firstattrib. prints the log and returns zero if the
+// program fails to build.
+GLuint glext_create_program(
+    const glext* ext,
+    const GLchar* const* sources,
+    int numsources,
+    const char* const* attribs,
+    int numattribs,
+    GLuint firstattrib);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GLEXT_H_
@@ -0,0 +1,182 @@
+#include "gpuskin.h"
+#include "skin.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+    // vertex uniform components left for the built in matrices and lights
+    GPUSKIN_RESERVED_UNIFORMS = 128
+};
+
+// the palette holds three rows per joint, since the bottom row of a joint
+// matrix is always 0 0 0 1. the blended rows are the same as blending the
+// transformed vertices. the indices of unused influences are clamped,
+// since their weight is zero but they may be out of range.
+static const char gpuskin_vsh[] =
+    "uniform vec4 palette[MAX_JOINTS * 3];\n"
+    "attribute vec4 joints;\n"
+    "attribute vec4 weights;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 r0 = vec4(0.0);\n"
+    "    vec4 r1 = vec4(0.0);\n"
+    "    vec4 r2 = vec4(0.0);\n"
+    "    vec4 pos;\n"
+    "    vec3 n;\n"
+    "    vec3 l;\n"
+    "    for(int i = 0; i < 4; ++i)\n"
+    "    {\n"
+    "        float j = clamp(joints[i], 0.0, float(MAX_JOINTS - 1));\n"
+    "        int k = int(j) * 3;\n"
+    "        r0 += weights[i] * palette[k + 0];\n"
+    "        r1 += weights[i] * palette[k + 1];\n"
+    "        r2 += weights[i] * palette[k + 2];\n"
+    "    }\n"
+    "    pos = vec4(\n"
+    "        dot(r0, gl_Vertex),\n"
+    "        dot(r1, gl_Vertex),\n"
+    "        dot(r2, gl_Vertex),\n"
+    "        1.0);\n"
+    "    n = vec3(\n"
+    "        dot(r0.xyz, gl_Normal),\n"
+    "        dot(r1.xyz, gl_Normal),\n"
+    "        dot(r2.xyz, gl_Normal));\n"
+    "    n = normalize(gl_NormalMatrix * n);\n"
+    "    l = normalize(gl_LightSource[0].position.xyz);\n"
+    "    gl_FrontColor =\n"
+    "        gl_FrontLightModelProduct.sceneColor +\n"
+    "        gl_FrontLightProduct[0].ambient +\n"
+    "        gl_FrontLightProduct[0].diffuse * max(dot(n, l), 0.0);\n"
+    "    gl_FrontColor.a = gl_FrontMaterial.diffuse.a;\n"
+    "    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * pos;\n"
+    "}\n";
+
+// bound to GPUSKIN_JOINT_ATTRIB and GPUSKIN_WEIGHT_ATTRIB
+static const char* const gpuskin_attribs[] = { "joints", "weights" };
+
+//****************************************************************************
+int gpuskin_create(
+    const glext* ext,
+    gpuskin* gs_out)
+{
+    char header[64];
+    const GLchar* src[2];
+    GLint maxuniforms;
+    int err = 0;
+    memset(gs_out, 0, sizeof(*gs_out));
+    gs_out->ext = *ext;
+    if(!ext->shaders)
+    {
+        printf("glsl shaders are not supported\n");
+        return -1;
+    }
+    maxuniforms = 0;
+    glGetIntegerv(GL_MAX_VERTEX_UNIFORM_COMPONENTS, &maxuniforms);
+    gs_out->maxjoints = (maxuniforms - GPUSKIN_RESERVED_UNIFORMS) / 12;
+    if(gs_out->maxjoints > GPUSKIN_MAX_JOINTS)
+    {
+        gs_out->maxjoints = GPUSKIN_MAX_JOINTS;
+    }
+    if(gs_out->maxjoints < 1)
+    {
+        printf("too few vertex uniforms for a joint palette\n");
+        return -1;
+    }
+    sprintf(
+        header,
+        "#version 120\n#define MAX_JOINTS %d\n",
+        gs_out->maxjoints);
+    src[0] = header;
+    src[1] = gpuskin_vsh;
+    gs_out->program = glext_create_program(
+        ext,
+        src,
+        2,
+        gpuskin_attribs,
+        2,
+        GPUSKIN_JOINT_ATTRIB);
+    if(gs_out->program == 0)
+    {
+        err = -1;
+    }
+    else
+    {
+        gs_out->paletteloc = ext->getuniformlocation(
+            gs_out->program,
+            "palette");
+        gs_out->rows = (float*) malloc(
+            gs_out->maxjoints * 12 * sizeof(*gs_out->rows));
+    }
+    return err;
+}
+
+//****************************************************************************
+void gpuskin_destroy(
+    gpuskin* gs)
+{
+    if(gs->program != 0)
+    {
+        gs->ext.deleteprogram(gs->program);
+    }
+    free(gs->rows);
+}
+
+//****************************************************************************
+void gpuskin_begin(
+    gpuskin* gs,
+    const taa_mat44* palette,
+    int numjoints,
+    GLuint jwvbo)
+{
+    const glext* ext = &gs->ext;
+    float* row = gs->rows;
+    int i;
+    int r;
+    // the matrices are column major, so row r of a matrix is the r'th
+    // component of each column
+    for(i = 0; i < numjoints; ++i)
+    {
+        const taa_mat44* m = palette + i;
+        for(r = 0; r < 3; ++r)
+        {
+            row[0] = (&m->x.x)[r];
+            row[1] = (&m->y.x)[r];
+            row[2] = (&m->z.x)[r];
+            row[3] = (&m->w.x)[r];
+            row += 4;
+        }
+    }
+    ext->useprogram(gs->program);
+    ext->uniform4fv(gs->paletteloc, numjoints * 3, gs->rows);
+    ext->bindbuffer(GL_ARRAY_BUFFER, jwvbo);
+    ext->vertexattribpointer(
+        GPUSKIN_JOINT_ATTRIB,
+        4,
+        GL_INT,
+        GL_FALSE,
+        sizeof(jwvert),
+        (const GLvoid*) offsetof(jwvert, joints));
+    ext->vertexattribpointer(
+        GPUSKIN_WEIGHT_ATTRIB,
+        4,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(jwvert),
+        (const GLvoid*) offsetof(jwvert, weights));
+    ext->enablevertexattribarray(GPUSKIN_JOINT_ATTRIB);
+    ext->enablevertexattribarray(GPUSKIN_WEIGHT_ATTRIB);
+}
+
+//****************************************************************************
+void gpuskin_end(
+    gpuskin* gs)
+{
+    const glext* ext = &gs->ext;
+    ext->disablevertexattribarray(GPUSKIN_WEIGHT_ATTRIB);
+    ext->disablevertexattribarray(GPUSKIN_JOINT_ATTRIB);
+    ext->useprogram(0);
+}
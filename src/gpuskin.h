@@ -0,0 +1,62 @@
+#ifndef GPUSKIN_H_
+#define GPUSKIN_H_
+
+#include "glext.h"
+#include <taa/mat44.h>
+
+typedef struct gpuskin_s gpuskin;
+
+enum
+{
+    // generic attributes of the joint indices and weights. 6 and 7 do not
+    // alias any fixed function attribute on drivers that alias them.
+    GPUSKIN_JOINT_ATTRIB = 6,
+    GPUSKIN_WEIGHT_ATTRIB = 7,
+    GPUSKIN_MAX_JOINTS = 256
+};
+
+// vertex program that blends the bind pose by a palette of joint matrices
+// and lights the result like the fixed function pipeline with one
+// directional light. the fragments are still shaded by fixed function.
+struct gpuskin_s
+{
+    glext ext;
+    GLuint program;
+    GLint paletteloc;
+    // largest palette that fits in the vertex uniforms
+    int maxjoints;
+    // first three rows of each palette matrix
+    float* rows;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// compiles and links the program. returns nonzero and prints the log if
+// shaders are not supported or the program fails to build.
+int gpuskin_create(
+    const glext* ext,
+    gpuskin* gs_out);
+
+void gpuskin_destroy(
+    gpuskin* gs);
+
+// binds the program with the palette, and points the joint attributes at
+// the jwvert stream in jwvbo. the positions and normals are read from the
+// vertex and normal arrays. numjoints must not exceed maxjoints.
+void gpuskin_begin(
+    gpuskin* gs,
+    const taa_mat44* palette,
+    int numjoints,
+    GLuint jwvbo);
+
+void gpuskin_end(
+    gpuskin* gs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GPUSKIN_H_
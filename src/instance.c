@@ -0,0 +1,262 @@
+#include "instance.h"
+#include <taa/mat44.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//****************************************************************************
+void instance_create(
+    const taa_scene* scene,
+    const animsampler* sampler,
+    int index,
+    int numinstances,
+    float spacing,
+    instance* inst_out)
+{
+    int numnodes = scene->numnodes;
+    int numskels = scene->numskeletons;
+    int nummeshes = scene->nummeshes;
+    int side = (int) ceil(sqrt((double) numinstances));
+    float center = (side - 1) * 0.5f;
+    int i;
+    inst_out->scene = scene;
+    inst_out->sampler = sampler;
+    inst_out->animnodes = (taa_scenenode*) taa_memalign(
+        16,
+        numnodes*sizeof(*inst_out->animnodes));
+    memcpy(inst_out->animnodes, scene->nodes, numnodes*sizeof(*scene->nodes));
+    xformcache_create(inst_out->animnodes, numnodes, &inst_out->xforms);
+    if(sampler != NULL)
+    {
+        animsampler_create_player(sampler, &inst_out->player);
+    }
+    inst_out->poses = (skinpose*) malloc(
+        (numskels + 1) * sizeof(*inst_out->poses));
+    for(i = 0; i < numskels; ++i)
+    {
+        skin_create_pose(scene->skeletons + i, inst_out->poses + i);
+    }
+    inst_out->skinjobs = (skinjob*) calloc(
+        nummeshes + 1,
+        sizeof(*inst_out->skinjobs));
+    inst_out->palettes = (taa_mat44**) calloc(
+        nummeshes + 1,
+        sizeof(*inst_out->palettes));
+    inst_out->paletteversions = (int*) malloc(
+        (nummeshes + 1) * sizeof(*inst_out->paletteversions));
+    for(i = 0; i < nummeshes; ++i)
+    {
+        const taa_scenemesh* mesh = scene->meshes + i;
+        skinjob* job = inst_out->skinjobs + i;
+        if(mesh->skeleton >= 0)
+        {
+            // the skinned mesh never references more joints than the mesh
+            inst_out->palettes[i] = (taa_mat44*) taa_memalign(
+                16,
+                (mesh->numjoints + 1)*sizeof(*inst_out->palettes[i]));
+            job->palette = inst_out->palettes[i];
+        }
+        job->version = -1;
+        inst_out->paletteversions[i] = -1;
+    }
+    taa_mat44_identity(&inst_out->gridmat);
+    inst_out->gridmat.w.x = ((index % side) - center) * spacing;
+    inst_out->gridmat.w.z = ((index / side) - center) * spacing;
+    // spread the instances evenly over the length of the animation
+    inst_out->timeoffset = 0.0f;
+    if(sampler != NULL)
+    {
+        double phase = index * 0.6180339887;
+        phase -= floor(phase);
+        inst_out->timeoffset = (float) (phase * sampler->length);
+    }
+    inst_out->sec = 0.0;
+    inst_out->nodesdirty = 1;
+    inst_out->xformversion = 0;
+}
+
+//****************************************************************************
+void instance_destroy(
+    instance* inst)
+{
+    const taa_scene* scene = inst->scene;
+    int i;
+    for(i = 0; i < (int) scene->nummeshes; ++i)
+    {
+        if(inst->palettes[i] != NULL)
+        {
+            taa_memalign_free(inst->palettes[i]);
+        }
+    }
+    for(i = 0; i < (int) scene->numskeletons; ++i)
+    {
+        skin_destroy_pose(inst->poses + i);
+    }
+    if(inst->sampler != NULL)
+    {
+        animsampler_destroy_player(&inst->player);
+    }
+    xformcache_destroy(&inst->xforms);
+    taa_memalign_free(inst->animnodes);
+    free(inst->paletteversions);
+    free(inst->palettes);
+    free(inst->skinjobs);
+    free(inst->poses);
+}
+
+//****************************************************************************
+static void instance_run_anim_task(
+    void* userdata,
+    int first,
+    int end)
+{
+    instance* inst = (instance*) userdata;
+    float length = inst->sampler->length;
+    double sec = inst->sec + inst->timeoffset;
+    sec = sec - length*floor(sec/length);
+    animsampler_play(
+        inst->sampler,
+        &inst->player,
+        (float) sec,
+        inst->animnodes);
+    inst->nodesdirty = 1;
+}
+
+//****************************************************************************
+int instance_add_anim_task(
+    instance* inst,
+    double sec,
+    taskpool_task* tasks_out)
+{
+    if(inst->sampler == NULL)
+    {
+        return 0;
+    }
+    inst->sec = sec;
+    tasks_out->func = instance_run_anim_task;
+    tasks_out->userdata = inst;
+    tasks_out->first = 0;
+    tasks_out->end = 1;
+    tasks_out->counter = NULL;
+    return 1;
+}
+
+//****************************************************************************
+int instance_add_pose_tasks(
+    instance* inst,
+    taskpool_task* tasks_out)
+{
+    if(!inst->nodesdirty)
+    {
+        return 0;
+    }
+    return skin_add_pose_tasks(
+        inst->poses,
+        inst->scene->numskeletons,
+        inst->animnodes,
+        tasks_out);
+}
+
+//****************************************************************************
+static void instance_run_xform_task(
+    void* userdata,
+    int first,
+    int end)
+{
+    instance* inst = (instance*) userdata;
+    if(xformcache_update(&inst->xforms, inst->animnodes) > 0)
+    {
+        ++inst->xformversion;
+    }
+}
+
+//****************************************************************************
+int instance_add_xform_task(
+    instance* inst,
+    taskpool_task* tasks_out)
+{
+    if(!inst->nodesdirty)
+    {
+        return 0;
+    }
+    tasks_out->func = instance_run_xform_task;
+    tasks_out->userdata = inst;
+    tasks_out->first = 0;
+    tasks_out->end = 1;
+    tasks_out->counter = NULL;
+    return 1;
+}
+
+//****************************************************************************
+void instance_clear_dirty(
+    instance* inst)
+{
+    inst->nodesdirty = 0;
+}
+
+//****************************************************************************
+int instance_is_skin_stale(
+    const instance* inst,
+    int meshid)
+{
+    const taa_scenemesh* mesh = inst->scene->meshes + meshid;
+    const skinjob* job = inst->skinjobs + meshid;
+    int stale = 0;
+    if(mesh->skeleton >= 0 && job->smesh != NULL)
+    {
+        stale = (job->version != inst->poses[mesh->skeleton].version);
+    }
+    return stale;
+}
+
+//****************************************************************************
+void instance_update_palettes(
+    instance* inst)
+{
+    const taa_scene* scene = inst->scene;
+    int i;
+    for(i = 0; i < (int) scene->nummeshes; ++i)
+    {
+        const taa_scenemesh* mesh = scene->meshes + i;
+        const skinjob* job = inst->skinjobs + i;
+        if(mesh->skeleton >= 0 && job->smesh != NULL)
+        {
+            const skinpose* pose = inst->poses + mesh->skeleton;
+            if(inst->paletteversions[i] != pose->version)
+            {
+                // every joint of the mesh is calculated, since the owner
+                // may switch the job between meshes that use fewer
+                skin_calc_palette(
+                    mesh,
+                    mesh->numjoints,
+                    pose->jointmats,
+                    inst->palettes[i]);
+                inst->paletteversions[i] = pose->version;
+            }
+        }
+    }
+}
+
+//****************************************************************************
+int instance_add_skin_tasks(
+    instance* inst,
+    const uint8_t* visible,
+    taskpool_task* tasks_out)
+{
+    const taa_scene* scene = inst->scene;
+    int numtasks = 0;
+    int i;
+    for(i = 0; i < (int) scene->nummeshes; ++i)
+    {
+        skinjob* job = inst->skinjobs + i;
+        if(job->pndst != NULL &&
+           (visible == NULL || visible[i]) &&
+           instance_is_skin_stale(inst, i))
+        {
+            const taa_scenemesh* mesh = scene->meshes + i;
+            numtasks += skin_add_tasks(job, tasks_out + numtasks);
+            job->version = inst->poses[mesh->skeleton].version;
+        }
+    }
+    return numtasks;
+}
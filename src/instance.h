@@ -0,0 +1,108 @@
+#ifndef INSTANCE_H_
+#define INSTANCE_H_
+
+#include "animsampler.h"
+#include "skin.h"
+#include "taskpool.h"
+#include "xformcache.h"
+#include <taa/scene.h>
+
+typedef struct instance_s instance;
+
+// one animated copy of the scene. the meshes, textures, and animation data
+// are shared by all instances, while the animated nodes, transforms, poses,
+// and skinned vertices are owned by each instance.
+struct instance_s
+{
+    const taa_scene* scene;
+    const animsampler* sampler;
+    taa_scenenode* animnodes;
+    animplayer player;
+    xformcache xforms;
+    skinpose* poses;
+    // skinning of each mesh of the scene. the palettes of meshes with a
+    // skeleton are allocated, the skinned mesh and destination are set by
+    // the owner of the vertices.
+    skinjob* skinjobs;
+    taa_mat44** palettes;
+    // pose version of each palette, or -1 before it is first calculated
+    int* paletteversions;
+    // placement of the instance on the grid
+    taa_mat44 gridmat;
+    // added to the global time so the instances do not move in lockstep
+    float timeoffset;
+    // global time the animation task samples
+    double sec;
+    // set when the animated nodes may have changed
+    int nodesdirty;
+    // incremented whenever an update changes any of the node transforms
+    int xformversion;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// places the instance at its index in a square grid centered on the origin
+// the sampler may be NULL if the scene has no animations
+void instance_create(
+    const taa_scene* scene,
+    const animsampler* sampler,
+    int index,
+    int numinstances,
+    float spacing,
+    instance* inst_out);
+
+void instance_destroy(
+    instance* inst);
+
+// adds a task that samples the animation at the global time plus the
+// offset of the instance. adds nothing if the scene has no animation.
+int instance_add_anim_task(
+    instance* inst,
+    double sec,
+    taskpool_task* tasks_out);
+
+// adds one task per skeleton if the nodes changed
+int instance_add_pose_tasks(
+    instance* inst,
+    taskpool_task* tasks_out);
+
+// adds a task that updates the node transforms if the nodes changed
+int instance_add_xform_task(
+    instance* inst,
+    taskpool_task* tasks_out);
+
+// marks the changed nodes as handled once the pose and transform tasks
+// have completed
+void instance_clear_dirty(
+    instance* inst);
+
+// returns nonzero if the mesh is skinned and its pose changed since it was
+// last skinned, so the next skinning tasks will write its vertices
+int instance_is_skin_stale(
+    const instance* inst,
+    int meshid);
+
+// recalculates the palettes of the skinned meshes whose pose changed since
+// their palette was last calculated. must be called once the pose tasks
+// have completed, and before the skinning tasks are added.
+void instance_update_palettes(
+    instance* inst);
+
+// adds skinning tasks for the meshes whose pose changed since they were
+// last skinned. meshes whose visible flag is clear keep their previous
+// vertices and stay stale until they are visible again. visible may be
+// NULL to skin every mesh. jobs without a destination are skipped, for
+// meshes that are skinned on the gpu.
+int instance_add_skin_tasks(
+    instance* inst,
+    const uint8_t* visible,
+    taskpool_task* tasks_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INSTANCE_H_
@@ -0,0 +1,260 @@
+#include "instdraw.h"
+#include <taa/mat44.h>
+#include <stdlib.h>
+#include <string.h>
+
+// transforms the vertex by the per instance model matrix before the view,
+// and lights it like the fixed function pipeline with one directional
+// light. normals are transformed by the upper 3x3 of the model matrix, so
+// like GL_NORMALIZE they are only correct for uniform scales.
+static const char instdraw_vsh[] =
+    "#version 120\n"
+    "attribute mat4 model;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 pos = model * gl_Vertex;\n"
+    "    vec3 n = gl_NormalMatrix * (mat3(model) * gl_Normal);\n"
+    "    vec3 l = normalize(gl_LightSource[0].position.xyz);\n"
+    "    n = normalize(n);\n"
+    "    gl_FrontColor =\n"
+    "        gl_FrontLightModelProduct.sceneColor +\n"
+    "        gl_FrontLightProduct[0].ambient +\n"
+    "        gl_FrontLightProduct[0].diffuse * max(dot(n, l), 0.0);\n"
+    "    gl_FrontColor.a = gl_FrontMaterial.diffuse.a;\n"
+    "    gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * pos;\n"
+    "}\n";
+
+// a mat4 attribute takes four consecutive locations, one per column
+static const char* const instdraw_attribs[] = { "model" };
+
+//****************************************************************************
+int instdraw_create(
+    const glext* ext,
+    const drawlist* dl,
+    int numinstances,
+    const taa_mat44* meshmats,
+    instdraw* id_out)
+{
+    const GLchar* src = instdraw_vsh;
+    int nummats;
+    int i;
+    memset(id_out, 0, sizeof(*id_out));
+    if(!ext->instancing)
+    {
+        return -1;
+    }
+    id_out->program = glext_create_program(
+        ext,
+        &src,
+        1,
+        instdraw_attribs,
+        1,
+        INSTDRAW_MATRIX_ATTRIB);
+    if(id_out->program == 0)
+    {
+        return -1;
+    }
+    id_out->ext = *ext;
+    id_out->dl = dl;
+    id_out->meshmats = meshmats;
+    id_out->groupmats = (int*) malloc(
+        (dl->numgroups + 1) * sizeof(*id_out->groupmats));
+    nummats = 0;
+    for(i = 0; i < dl->numgroups; ++i)
+    {
+        id_out->groupmats[i] = nummats;
+        nummats += dl->groups[i].numnodes * numinstances;
+    }
+    id_out->mats = (taa_mat44*) calloc(nummats+1, sizeof(*id_out->mats));
+    id_out->nummats = nummats;
+    id_out->numinstances = numinstances;
+    id_out->versions = (int*) malloc(
+        (numinstances + 1) * sizeof(*id_out->versions));
+    for(i = 0; i < numinstances; ++i)
+    {
+        // nothing has been written yet
+        id_out->versions[i] = -1;
+    }
+    ext->genbuffers(1, &id_out->matvbo);
+    ext->bindbuffer(GL_ARRAY_BUFFER, id_out->matvbo);
+    ext->bufferdata(
+        GL_ARRAY_BUFFER,
+        nummats * sizeof(*id_out->mats),
+        NULL,
+        GL_DYNAMIC_DRAW);
+    ext->bindbuffer(GL_ARRAY_BUFFER, 0);
+    return 0;
+}
+
+//****************************************************************************
+void instdraw_destroy(
+    instdraw* id)
+{
+    if(id->program != 0)
+    {
+        id->ext.deleteprogram(id->program);
+        id->ext.deletebuffers(1, &id->matvbo);
+    }
+    free(id->versions);
+    free(id->mats);
+    free(id->groupmats);
+}
+
+//****************************************************************************
+void instdraw_update(
+    instdraw* id,
+    const instance* instances)
+{
+    const drawlist* dl = id->dl;
+    int first = id->nummats;
+    int end = 0;
+    int i;
+    int j;
+    int k;
+    for(i = 0; i < id->numinstances; ++i)
+    {
+        const instance* inst = instances + i;
+        const xformcache* xforms = &inst->xforms;
+        int all = (id->versions[i] < 0);
+        if(inst->xformversion != id->versions[i])
+        {
+            for(j = 0; j < dl->numgroups; ++j)
+            {
+                const drawgroup* group = dl->groups + j;
+                const int* nodes = dl->groupnodes + group->firstnode;
+                int base = id->groupmats[j] + i*group->numnodes;
+                for(k = 0; k < group->numnodes; ++k)
+                {
+                    if(all || xforms->dirty[nodes[k]])
+                    {
+                        int m = base + k;
+                        taa_mat44_multiply(
+                            &inst->gridmat,
+                            xforms->worldmats + nodes[k],
+                            id->mats + m);
+                        if(id->meshmats != NULL)
+                        {
+                            taa_mat44 modelmat = id->mats[m];
+                            taa_mat44_multiply(
+                                &modelmat,
+                                id->meshmats + group->mesh,
+                                id->mats + m);
+                        }
+                        first = (m < first) ? m : first;
+                        end = (m + 1 > end) ? m + 1 : end;
+                    }
+                }
+            }
+            id->versions[i] = inst->xformversion;
+        }
+    }
+    // one upload of the span that covers every changed matrix
+    if(first < end)
+    {
+        const glext* ext = &id->ext;
+        ext->bindbuffer(GL_ARRAY_BUFFER, id->matvbo);
+        ext->buffersubdata(
+            GL_ARRAY_BUFFER,
+            first * sizeof(*id->mats),
+            (end - first) * sizeof(*id->mats),
+            id->mats + first);
+    }
+}
+
+//****************************************************************************
+// draws count instances of the command, starting from the matrix at index
+// first of the buffer
+static void instdraw_draw_run(
+    instdraw* id,
+    const drawcmd* cmd,
+    GLenum indextype,
+    int first,
+    int count)
+{
+    const glext* ext = &id->ext;
+    size_t offset = first * sizeof(*id->mats);
+    size_t indexsize = sizeof(uint32_t);
+    int c;
+    if(indextype == GL_UNSIGNED_SHORT)
+    {
+        indexsize = sizeof(uint16_t);
+    }
+    for(c = 0; c < 4; ++c)
+    {
+        ext->vertexattribpointer(
+            INSTDRAW_MATRIX_ATTRIB + c,
+            4,
+            GL_FLOAT,
+            GL_FALSE,
+            sizeof(taa_mat44),
+            (const GLvoid*) (offset + c*sizeof(taa_vec4)));
+    }
+    ext->drawelementsinstanced(
+        GL_TRIANGLES,
+        cmd->numindices,
+        indextype,
+        (const GLvoid*) (cmd->firstindex * indexsize),
+        count);
+}
+
+//****************************************************************************
+void instdraw_draw(
+    instdraw* id,
+    const drawcmd* cmd,
+    GLenum indextype,
+    const uint8_t* levels,
+    int level)
+{
+    const glext* ext = &id->ext;
+    const drawlist* dl = id->dl;
+    const drawgroup* group = dl->groups + cmd->group;
+    const int* nodes = dl->groupnodes + group->firstnode;
+    int base = id->groupmats[cmd->group];
+    int first = 0;
+    int count = 0;
+    int c;
+    int i;
+    int k;
+    ext->useprogram(id->program);
+    ext->bindbuffer(GL_ARRAY_BUFFER, id->matvbo);
+    for(c = 0; c < 4; ++c)
+    {
+        GLuint attrib = INSTDRAW_MATRIX_ATTRIB + c;
+        ext->vertexattribdivisor(attrib, 1);
+        ext->enablevertexattribarray(attrib);
+    }
+    // the matrices are ordered by instance, then by node, so nodes that
+    // are culled or drawn at other levels split the group into runs of
+    // matrices that are drawn together
+    for(i = 0; i < id->numinstances; ++i)
+    {
+        for(k = 0; k < group->numnodes; ++k)
+        {
+            if(levels == NULL || levels[i*dl->numnodes + nodes[k]] == level)
+            {
+                if(count == 0)
+                {
+                    first = base + i*group->numnodes + k;
+                }
+                ++count;
+            }
+            else if(count > 0)
+            {
+                instdraw_draw_run(id, cmd, indextype, first, count);
+                count = 0;
+            }
+        }
+    }
+    if(count > 0)
+    {
+        instdraw_draw_run(id, cmd, indextype, first, count);
+    }
+    for(c = 0; c < 4; ++c)
+    {
+        GLuint attrib = INSTDRAW_MATRIX_ATTRIB + c;
+        ext->vertexattribdivisor(attrib, 0);
+        ext->disablevertexattribarray(attrib);
+    }
+    ext->useprogram(0);
+}
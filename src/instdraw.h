@@ -0,0 +1,85 @@
+#ifndef INSTDRAW_H_
+#define INSTDRAW_H_
+
+#include "drawlist.h"
+#include "glext.h"
+#include "instance.h"
+
+typedef struct instdraw_s instdraw;
+
+enum
+{
+    // first of the four generic attributes of the model matrix. 12 to 15
+    // alias texture units that are never used on drivers that alias them.
+    INSTDRAW_MATRIX_ATTRIB = 12
+};
+
+// draws the groups of a drawlist for every instance with one instanced draw
+// per command. the model matrix of each node of each instance is a per
+// instance attribute, read from a buffer that holds the matrices of every
+// group.
+struct instdraw_s
+{
+    glext ext;
+    const drawlist* dl;
+    // matrix applied to the vertices of each mesh before the model matrix,
+    // or NULL
+    const taa_mat44* meshmats;
+    GLuint program;
+    GLuint matvbo;
+    // copy of the buffer. the matrices of a group are ordered by instance,
+    // then by node.
+    taa_mat44* mats;
+    // first matrix of each group
+    int* groupmats;
+    int nummats;
+    int numinstances;
+    // transform version of each instance when its matrices were written
+    int* versions;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// returns nonzero if instancing is not supported or the program fails to
+// build. must be called from the rendering thread. meshmats holds a matrix
+// for each mesh of the scene that is folded into the model matrices of its
+// nodes, such as the position transform of quantized vertices, and must
+// outlive the instdraw. it may be NULL if no mesh needs one.
+int instdraw_create(
+    const glext* ext,
+    const drawlist* dl,
+    int numinstances,
+    const taa_mat44* meshmats,
+    instdraw* id_out);
+
+void instdraw_destroy(
+    instdraw* id);
+
+// rewrites and uploads the matrices of the nodes whose transforms changed
+// since the previous update. the transforms only flag the nodes changed by
+// their last update, so this must be called after every transform update.
+void instdraw_update(
+    instdraw* id,
+    const instance* instances);
+
+// draws the command for every node of its group in every instance whose
+// entry in levels is level, with one instanced draw per run of adjacent
+// matrices. levels is indexed by instance * the number of scene nodes +
+// node, or may be NULL to draw every node. the vertex arrays and index
+// buffer of the level must already be set, with indices of the given type,
+// and the modelview matrix must be the view matrix.
+void instdraw_draw(
+    instdraw* id,
+    const drawcmd* cmd,
+    GLenum indextype,
+    const uint8_t* levels,
+    int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INSTDRAW_H_
@@ -3,7 +3,14 @@
 #include <float.h>
 #endif
 
+#include "animsampler.h"
+#include "dxt.h"
 #include "freecam.h"
+#include "meshlod.h"
+#include "mipgen.h"
+#include "scenecache.h"
+#include "skin.h"
+#include "taskpool.h"
 #include <taa/scenefile.h>
 #include <taa/path.h>
 #include <taa/glcontext.h>
@@ -16,7 +23,26 @@ void play(
     taa_window win,
     taa_glcontext_display rcdisplay,
     taa_glcontext_surface rcsurface,
-    taa_scene* scene);
+    taa_scene* scene,
+    scenecache* cache,
+    const dxttexture* dxttextures,
+    const animsampler* sampler,
+    meshlod* lods,
+    int gpuskinning,
+    int quantize,
+    int numthreads,
+    int numinstances,
+    float spacing,
+    const char* tracepath);
+
+int bench(
+    taa_scene* scene,
+    scenecache* cache,
+    const animsampler* sampler,
+    int numframes,
+    int numthreads,
+    int numinstances,
+    float spacing);
 
 typedef struct main_win_s main_win;
 
@@ -135,62 +161,447 @@ static void main_close_window(
     }
 }
 
-int main(int argc, char* argv[])
+//****************************************************************************
+// generates the mip chains of the textures that only have their top level
+static mipchain* main_generate_mips(
+    taa_scene* scene,
+    taskpool* pool)
 {
-    enum
+    int numtextures = scene->numtextures;
+    mipchain* chains;
+    taskpool_task* tasks;
+    uint32_t numlevels;
+    uint32_t level;
+    int numtasks;
+    int i;
+    chains = (mipchain*) calloc(numtextures + 1, sizeof(*chains));
+    numlevels = 0;
+    for(i = 0; i < numtextures; ++i)
     {
-        ARG_SCENE = 1,
-        NUM_ARGS
-    };
+        taa_scenetexture* scntex = scene->textures + i;
+        if(scntex->numlevels == 1)
+        {
+            uint32_t n = mipgen_create(
+                scntex,
+                MIPGEN_FILTER_KAISER,
+                MIPGEN_GAMMA,
+                chains + i);
+            numlevels = (n > numlevels) ? n : numlevels;
+        }
+    }
+    // the first generated level has the most tasks
+    numtasks = 0;
+    for(i = 0; i < numtextures; ++i)
+    {
+        numtasks += mipgen_count_tasks(chains + i, 1);
+    }
+    tasks = (taskpool_task*) malloc((numtasks + 1) * sizeof(*tasks));
+    // every texture's level is filtered from the previous level, so the
+    // levels are generated one batch at a time
+    for(level = 1; level < numlevels; ++level)
+    {
+        numtasks = 0;
+        for(i = 0; i < numtextures; ++i)
+        {
+            numtasks += mipgen_add_tasks(chains + i, level, tasks + numtasks);
+        }
+        taskpool_run(pool, tasks, numtasks);
+        taskpool_finish(pool);
+    }
+    free(tasks);
+    return chains;
+}
+
+//****************************************************************************
+// compresses every texture of the scene across a task pool
+static dxttexture* main_compress_textures(
+    const taa_scene* scene,
+    taskpool* pool)
+{
+    int numtextures = scene->numtextures;
+    dxttexture* textures;
+    taskpool_task* tasks;
+    int numtasks;
+    int i;
+    textures = (dxttexture*) calloc(numtextures + 1, sizeof(*textures));
+    numtasks = 0;
+    for(i = 0; i < numtextures; ++i)
+    {
+        dxt_create_texture(scene->textures + i, textures + i);
+        numtasks += dxt_count_tasks(textures + i);
+    }
+    tasks = (taskpool_task*) malloc((numtasks + 1) * sizeof(*tasks));
+    numtasks = 0;
+    for(i = 0; i < numtextures; ++i)
+    {
+        numtasks += dxt_add_tasks(textures + i, tasks + numtasks);
+    }
+    taskpool_run(pool, tasks, numtasks);
+    taskpool_finish(pool);
+    free(tasks);
+    return textures;
+}
+
+//****************************************************************************
+// bakes every animation of the scene into compressed tracks, starting from
+// the nodes of the scene
+static animsampler* main_bake_animations(
+    const taa_scene* scene)
+{
+    uint32_t numanimations = scene->numanimations;
+    animsampler* samplers;
+    uint32_t i;
+    samplers = (animsampler*) malloc((numanimations+1) * sizeof(*samplers));
+    for(i = 0; i < numanimations; ++i)
+    {
+        animsampler_create(
+            scene->animations + i,
+            scene->nodes,
+            scene->numnodes,
+            samplers + i);
+        animsampler_print_report(samplers + i, i);
+    }
+    return samplers;
+}
+
+//****************************************************************************
+// makes the levels of detail of every mesh. the levels stored in the cache
+// are loaded, and a mesh is only simplified if the cache is NULL or its
+// levels can not be loaded.
+static meshlod* main_create_lods(
+    const taa_scene* scene,
+    const scenecache* cache)
+{
+    uint32_t nummeshes = scene->nummeshes;
+    meshlod* lods;
+    uint32_t i;
+    lods = (meshlod*) malloc((nummeshes + 1) * sizeof(*lods));
+    for(i = 0; i < nummeshes; ++i)
+    {
+        int err = -1;
+        if(cache != NULL)
+        {
+            err = meshlod_load(
+                scene->meshes + i,
+                cache->lodlevels + i*MESHLOD_MAX_LEVELS,
+                cache->numlodlevels[i],
+                lods + i);
+        }
+        if(err != 0)
+        {
+            meshlod_create(scene->meshes + i, lods + i);
+        }
+    }
+    return lods;
+}
+
+//****************************************************************************
+// frees the data made from the scene on the first view of a file. any of
+// the arrays may be NULL.
+static void main_destroy_prepared(
+    const taa_scene* scene,
+    dxttexture* dxttextures,
+    mipchain* mipchains,
+    animsampler* samplers,
+    int numsamplers,
+    meshlod* lods)
+{
+    uint32_t i;
+    int j;
+    if(lods != NULL)
+    {
+        for(i = 0; i < scene->nummeshes; ++i)
+        {
+            meshlod_destroy(lods + i);
+        }
+        free(lods);
+    }
+    if(dxttextures != NULL)
+    {
+        for(i = 0; i < scene->numtextures; ++i)
+        {
+            dxt_destroy_texture(dxttextures + i);
+        }
+        free(dxttextures);
+    }
+    if(mipchains != NULL)
+    {
+        for(i = 0; i < scene->numtextures; ++i)
+        {
+            mipgen_destroy(mipchains + i);
+        }
+        free(mipchains);
+    }
+    if(samplers != NULL)
+    {
+        for(j = 0; j < numsamplers; ++j)
+        {
+            animsampler_destroy(samplers + j);
+        }
+        free(samplers);
+    }
+}
+
+int main(int argc, char* argv[])
+{
     int err = 0;
     main_win mwin;
     taa_scene scene;
+    const char* path = NULL;
+    int benchframes = 0;
+    int numthreads = taskpool_get_numcpus();
+    int gpuskinning = 0;
+    int quantize = 0;
+    int numinstances = 1;
+    float spacing = 2.0f;
+    const char* tracepath = NULL;
+    int argi;
     FILE* fp = NULL;
+    char* cachepath = NULL;
+    scenecache cache;
+    int cached = 0;
+    dxttexture* dxttextures = NULL;
+    mipchain* mipchains = NULL;
+    animsampler* samplers = NULL;
+    int numsamplers = 0;
+    const animsampler* sampler = NULL;
+    meshlod* lods = NULL;
 
     taa_scene_create(&scene, taa_SCENE_Y_UP);
-    if(argc != NUM_ARGS)
+    for(argi = 1; argi < argc && err == 0; ++argi)
     {
         // check arguments
-        puts("usage: taasceneview <taascene path>\n");
+        if(!strcmp(argv[argi], "--bench") && argi + 1 < argc)
+        {
+            benchframes = atoi(argv[++argi]);
+            err = (benchframes > 0) ? 0 : -1;
+        }
+        else if(!strcmp(argv[argi], "--threads") && argi + 1 < argc)
+        {
+            numthreads = atoi(argv[++argi]);
+            err = (numthreads > 0) ? 0 : -1;
+        }
+        else if(!strcmp(argv[argi], "--instances") && argi + 1 < argc)
+        {
+            numinstances = atoi(argv[++argi]);
+            err = (numinstances > 0) ? 0 : -1;
+        }
+        else if(!strcmp(argv[argi], "--spacing") && argi + 1 < argc)
+        {
+            spacing = (float) atof(argv[++argi]);
+        }
+        else if(!strcmp(argv[argi], "--skinning") && argi + 1 < argc)
+        {
+            const char* mode = argv[++argi];
+            gpuskinning = !strcmp(mode, "gpu");
+            err = (gpuskinning || !strcmp(mode, "cpu")) ? 0 : -1;
+        }
+        else if(!strcmp(argv[argi], "--static") && argi + 1 < argc)
+        {
+            const char* format = argv[++argi];
+            quantize = !strcmp(format, "quantized");
+            err = (quantize || !strcmp(format, "float")) ? 0 : -1;
+        }
+        else if(!strcmp(argv[argi], "--trace") && argi + 1 < argc)
+        {
+            tracepath = argv[++argi];
+        }
+        else if(path == NULL && argv[argi][0] != '-')
+        {
+            path = argv[argi];
+        }
+        else
+        {
+            err = -1;
+        }
+    }
+    if(err != 0 || path == NULL)
+    {
+        puts(
+            "usage: taasceneview [--bench <frames>] [--threads <count>] "
+            "[--instances <count>] [--spacing <distance>] "
+            "[--skinning <cpu|gpu>] [--static <float|quantized>] "
+            "[--trace <path>] <taascene path>\n");
         err = -1;
     }
     if(err == 0)
+    {
+        // the formatted scene is cached next to the source file, so the
+        // meshes only need to be formatted the first time a file is viewed.
+        // the source is only opened if the cache can not be used.
+        size_t pathlen = strlen(path);
+        cachepath = (char*) malloc(pathlen + sizeof(".cache"));
+        memcpy(cachepath, path, pathlen);
+        memcpy(cachepath + pathlen, ".cache", sizeof(".cache"));
+        cached = (scenecache_load(cachepath, path, &scene, &cache) == 0);
+        if(!cached)
+        {
+            // discard anything read from an invalid cache
+            taa_scene_destroy(&scene);
+            taa_scene_create(&scene, taa_SCENE_Y_UP);
+        }
+    }
+    if(err == 0 && !cached)
     {
         // open input file
-        fp = fopen(argv[ARG_SCENE], "rb");
+        fp = fopen(path, "rb");
         if(fp == NULL)
         {
-            printf("could not open input file %s\n", argv[ARG_SCENE]);
+            printf("could not open input file %s\n", path);
             err = -1;
         }
     }
-    if(err == 0)
+    if(err == 0 && !cached)
     {
         // read file and deserialize contents
         taa_filestream infs;
         taa_filestream_create(fp, 1024 * 1024, taa_FILESTREAM_READ, &infs);
         err = taa_scenefile_deserialize(&infs, &scene);
         taa_filestream_destroy(&infs);
-        fclose(fp);
         if(err != 0)
         {
             printf("error parsing scene file\n");
         }
     }
+    if(fp != NULL)
+    {
+        fclose(fp);
+    }
+    if(err == 0 && !cached)
+    {
+        taskpool* pool = taskpool_create(numthreads);
+        uint32_t i;
+        for(i = 0; i < scene.nummeshes; ++i)
+        {
+            float oldacmr;
+            float newacmr;
+            skin_format_mesh(scene.meshes + i, &oldacmr, &newacmr);
+            printf(
+                "mesh %u: %u vertices, %u triangles, acmr %.3f -> %.3f\n",
+                i,
+                scene.meshes[i].vertexstreams[0].numvertices,
+                scene.meshes[i].numindices / 3,
+                oldacmr,
+                newacmr);
+        }
+        lods = main_create_lods(&scene, NULL);
+        mipchains = main_generate_mips(&scene, pool);
+        dxttextures = main_compress_textures(&scene, pool);
+        taskpool_destroy(pool);
+        samplers = main_bake_animations(&scene);
+        numsamplers = scene.numanimations;
+        if(scenecache_save(
+            cachepath,
+            path,
+            &scene,
+            dxttextures,
+            samplers,
+            numsamplers,
+            lods) != 0)
+        {
+            // view the scene as it is, with its source animations
+            printf("could not write scene cache %s\n", cachepath);
+        }
+        else
+        {
+            // view the scene from the cache like later runs do, which drops
+            // the source animations and the uncompressed data
+            main_destroy_prepared(
+                &scene,
+                dxttextures,
+                mipchains,
+                samplers,
+                numsamplers,
+                lods);
+            dxttextures = NULL;
+            mipchains = NULL;
+            samplers = NULL;
+            lods = NULL;
+            taa_scene_destroy(&scene);
+            taa_scene_create(&scene, taa_SCENE_Y_UP);
+            err = scenecache_load(cachepath, path, &scene, &cache);
+            cached = (err == 0);
+            if(err != 0)
+            {
+                printf("could not read scene cache %s\n", cachepath);
+            }
+        }
+    }
     if(err == 0)
+    {
+        // the source animations are only still loaded if the cache could
+        // not be written. the first animation is played.
+        const animsampler* baked = cached ? cache.samplers : samplers;
+        int numbaked = cached ? cache.numsamplers : numsamplers;
+        size_t srcsize = 0;
+        size_t size = 0;
+        int i;
+        for(i = 0; i < numbaked; ++i)
+        {
+            srcsize += baked[i].srcsize;
+            size += baked[i].size;
+        }
+        if(numbaked > 0)
+        {
+            sampler = baked;
+            printf(
+                "animations: %lu bytes before baking, %lu bytes after\n",
+                (unsigned long) srcsize,
+                (unsigned long) (cached ? size : srcsize + size));
+        }
+    }
+    if(err == 0 && benchframes > 0)
+    {
+        // run the cpu pipeline without a window or rendering context
+        err = bench(
+            &scene,
+            cached ? &cache : NULL,
+            sampler,
+            benchframes,
+            numthreads,
+            numinstances,
+            spacing);
+    }
+    else if(err == 0)
     {
         err = main_init_window(&mwin);
+        if(err == 0 && lods == NULL)
+        {
+            lods = main_create_lods(&scene, cached ? &cache : NULL);
+        }
         if(err == 0)
         {
             play(mwin.windisplay,
                 mwin.win,
                 mwin.rcdisplay,
                 mwin.rcsurface,
-                &scene);
+                &scene,
+                cached ? &cache : NULL,
+                cached ? cache.dxttextures : dxttextures,
+                sampler,
+                lods,
+                gpuskinning,
+                quantize,
+                numthreads,
+                numinstances,
+                spacing,
+                tracepath);
         }
         main_close_window(&mwin);
     }
+    main_destroy_prepared(
+        &scene,
+        dxttextures,
+        mipchains,
+        samplers,
+        numsamplers,
+        lods);
+    if(cached)
+    {
+        scenecache_unload(&cache);
+    }
     taa_scene_destroy(&scene);
+    free(cachepath);
 
 #if defined(_DEBUG) && defined(_MSC_FULL_VER)
     _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
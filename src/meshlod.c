@@ -0,0 +1,1012 @@
+#include "meshlod.h"
+#include "skin.h"
+#include "vcache.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct meshlod_collapse_s meshlod_collapse;
+typedef struct meshlod_state_s meshlod_state;
+
+// squared edge length added to the error of a collapse for each unit of
+// skin weight that differs between its vertices
+static const double meshlod_skin_penalty = 1.0;
+
+// collapse of a vertex onto one of its neighbors. collapses are queued
+// lazily, so an entry is stale if its stamp is not the vertex's current one.
+struct meshlod_collapse_s
+{
+    double cost;
+    int vert;
+    int target;
+    int stamp;
+};
+
+// working copy of a mesh being simplified. vertices are only ever removed
+// by moving them onto a neighbor, so the remaining vertices keep their
+// original attributes.
+struct meshlod_state_s
+{
+    const pnvert* pn;
+    const jwvert* jw;
+    int skinned;
+    int numverts;
+    // three vertices per triangle, renumbered as vertices collapse
+    int* tris;
+    int* tribindings;
+    uint8_t* deadtris;
+    int numtris;
+    int numalive;
+    // the corners of a vertex are linked through nextcorner, starting from
+    // its firstcorner. corners of removed triangles stay in the lists.
+    int* firstcorner;
+    int* nextcorner;
+    uint8_t* locked;
+    uint8_t* deadverts;
+    // symmetric 4x4 plane quadric of each vertex, upper triangle only
+    double* quadrics;
+    int* stamps;
+    int* marks;
+    int mark;
+    meshlod_collapse* heap;
+    int heapsize;
+    int maxheap;
+    float maxerror;
+};
+
+//****************************************************************************
+static uint32_t meshlod_hash(
+    const uint32_t* words,
+    int numwords)
+{
+    uint32_t h = 2166136261u;
+    int i;
+    for(i = 0; i < numwords; ++i)
+    {
+        h = (h ^ words[i]) * 16777619u;
+        h ^= h >> 15;
+    }
+    return h;
+}
+
+//****************************************************************************
+// returns the first vertex with the same position as each vertex
+static int* meshlod_weld_positions(
+    const pnvert* pn,
+    int numverts)
+{
+    int size = 1;
+    int* table;
+    int* posids;
+    int i;
+    while(size < numverts*2)
+    {
+        size *= 2;
+    }
+    table = (int*) malloc(size * sizeof(*table));
+    posids = (int*) malloc((numverts + 1) * sizeof(*posids));
+    for(i = 0; i < size; ++i)
+    {
+        table[i] = -1;
+    }
+    for(i = 0; i < numverts; ++i)
+    {
+        uint32_t bits[3];
+        uint32_t slot;
+        memcpy(bits, &pn[i].pos, sizeof(bits));
+        slot = meshlod_hash(bits, 3) & (size - 1);
+        while(table[slot] >= 0 &&
+              memcmp(&pn[table[slot]].pos, &pn[i].pos, sizeof(bits)) != 0)
+        {
+            slot = (slot + 1) & (size - 1);
+        }
+        if(table[slot] < 0)
+        {
+            table[slot] = i;
+        }
+        posids[i] = table[slot];
+    }
+    free(table);
+    return posids;
+}
+
+//****************************************************************************
+// locks the vertices that share their position with another vertex, which
+// are on a uv or normal seam, and the vertices of edges that do not have
+// exactly two triangles, which are on a border or are not manifold
+static void meshlod_lock_vertices(
+    meshlod_state* st)
+{
+    int numverts = st->numverts;
+    int* posids = meshlod_weld_positions(st->pn, numverts);
+    int* counts = (int*) calloc(numverts + 1, sizeof(*counts));
+    uint32_t* keys;
+    int* edgecounts;
+    int size = 1;
+    int i;
+    int k;
+    for(i = 0; i < numverts; ++i)
+    {
+        ++counts[posids[i]];
+    }
+    while(size < st->numtris*6)
+    {
+        size *= 2;
+    }
+    keys = (uint32_t*) malloc(size * 2 * sizeof(*keys));
+    edgecounts = (int*) calloc(size, sizeof(*edgecounts));
+    for(i = 0; i < st->numtris; ++i)
+    {
+        for(k = 0; k < 3; ++k)
+        {
+            uint32_t key[2];
+            uint32_t slot;
+            int a = posids[st->tris[i*3 + k]];
+            int b = posids[st->tris[i*3 + (k + 1)%3]];
+            key[0] = (uint32_t) ((a < b) ? a : b);
+            key[1] = (uint32_t) ((a < b) ? b : a);
+            slot = meshlod_hash(key, 2) & (size - 1);
+            while(edgecounts[slot] != 0 &&
+                  (keys[slot*2] != key[0] || keys[slot*2 + 1] != key[1]))
+            {
+                slot = (slot + 1) & (size - 1);
+            }
+            keys[slot*2 + 0] = key[0];
+            keys[slot*2 + 1] = key[1];
+            ++edgecounts[slot];
+        }
+    }
+    for(i = 0; i < size; ++i)
+    {
+        if(edgecounts[i] != 0 && edgecounts[i] != 2)
+        {
+            // counts of locked positions are made negative
+            counts[keys[i*2 + 0]] = -1;
+            counts[keys[i*2 + 1]] = -1;
+        }
+    }
+    for(i = 0; i < numverts; ++i)
+    {
+        int count = counts[posids[i]];
+        st->locked[i] = (uint8_t) (count != 1);
+    }
+    free(edgecounts);
+    free(keys);
+    free(counts);
+    free(posids);
+}
+
+//****************************************************************************
+static void meshlod_calc_normal(
+    const taa_vec3* a,
+    const taa_vec3* b,
+    const taa_vec3* c,
+    double* n_out)
+{
+    double e0[3];
+    double e1[3];
+    e0[0] = b->x - a->x;
+    e0[1] = b->y - a->y;
+    e0[2] = b->z - a->z;
+    e1[0] = c->x - a->x;
+    e1[1] = c->y - a->y;
+    e1[2] = c->z - a->z;
+    n_out[0] = e0[1]*e1[2] - e0[2]*e1[1];
+    n_out[1] = e0[2]*e1[0] - e0[0]*e1[2];
+    n_out[2] = e0[0]*e1[1] - e0[1]*e1[0];
+}
+
+//****************************************************************************
+static void meshlod_add_quadrics(
+    meshlod_state* st)
+{
+    int i;
+    int k;
+    memset(st->quadrics, 0, st->numverts * 10 * sizeof(*st->quadrics));
+    for(i = 0; i < st->numtris; ++i)
+    {
+        const int* tri = st->tris + i*3;
+        const taa_vec3* p = &st->pn[tri[0]].pos;
+        double n[3];
+        double len;
+        meshlod_calc_normal(p, &st->pn[tri[1]].pos, &st->pn[tri[2]].pos, n);
+        len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if(len > 0.0)
+        {
+            double q[10];
+            double d;
+            n[0] /= len;
+            n[1] /= len;
+            n[2] /= len;
+            d = -(n[0]*p->x + n[1]*p->y + n[2]*p->z);
+            q[0] = n[0]*n[0];
+            q[1] = n[0]*n[1];
+            q[2] = n[0]*n[2];
+            q[3] = n[0]*d;
+            q[4] = n[1]*n[1];
+            q[5] = n[1]*n[2];
+            q[6] = n[1]*d;
+            q[7] = n[2]*n[2];
+            q[8] = n[2]*d;
+            q[9] = d*d;
+            for(k = 0; k < 30; ++k)
+            {
+                st->quadrics[tri[k/10]*10 + k%10] += q[k%10];
+            }
+        }
+    }
+}
+
+//****************************************************************************
+// squared distance of the point from the planes of both quadrics
+static double meshlod_eval_quadrics(
+    const double* a,
+    const double* b,
+    const taa_vec3* p)
+{
+    double q[10];
+    double x = p->x;
+    double y = p->y;
+    double z = p->z;
+    int k;
+    for(k = 0; k < 10; ++k)
+    {
+        q[k] = a[k] + b[k];
+    }
+    return
+        x*x*q[0] + 2.0*x*y*q[1] + 2.0*x*z*q[2] + 2.0*x*q[3] +
+        y*y*q[4] + 2.0*y*z*q[5] + 2.0*y*q[6] +
+        z*z*q[7] + 2.0*z*q[8] +
+        q[9];
+}
+
+//****************************************************************************
+// half the summed difference of the weights of each joint, from 0 for the
+// same influences to 1 for disjoint ones
+static double meshlod_calc_skin_difference(
+    const jwvert* a,
+    const jwvert* b)
+{
+    double diff = 0.0;
+    int i;
+    int j;
+    for(i = 0; i < SKIN_MAX_INFLUENCES; ++i)
+    {
+        float wb = 0.0f;
+        for(j = 0; j < SKIN_MAX_INFLUENCES; ++j)
+        {
+            if(b->joints[j] == a->joints[i] && b->weights[j] > 0.0f)
+            {
+                wb = b->weights[j];
+            }
+        }
+        diff += fabs(a->weights[i] - wb);
+    }
+    for(j = 0; j < SKIN_MAX_INFLUENCES; ++j)
+    {
+        int shared = 0;
+        for(i = 0; i < SKIN_MAX_INFLUENCES; ++i)
+        {
+            if(a->joints[i] == b->joints[j] && a->weights[i] > 0.0f)
+            {
+                shared = 1;
+            }
+        }
+        diff += shared ? 0.0 : b->weights[j];
+    }
+    return diff * 0.5;
+}
+
+//****************************************************************************
+static int meshlod_has_vertex(
+    const int* tri,
+    int v)
+{
+    return tri[0] == v || tri[1] == v || tri[2] == v;
+}
+
+//****************************************************************************
+// a collapse is allowed if it does not flip or flatten any remaining
+// triangle, and the edge's only common neighbors are the vertices opposite
+// it, so the surface stays manifold
+static int meshlod_is_valid(
+    meshlod_state* st,
+    int u,
+    int v)
+{
+    const taa_vec3* pv = &st->pn[v].pos;
+    int numedgetris = 0;
+    int numshared = 0;
+    int valid = 1;
+    int c;
+    int k;
+    st->mark += 2;
+    for(c = st->firstcorner[v]; c >= 0; c = st->nextcorner[c])
+    {
+        const int* tri = st->tris + (c/3)*3;
+        if(!st->deadtris[c/3])
+        {
+            for(k = 0; k < 3; ++k)
+            {
+                st->marks[tri[k]] = st->mark;
+            }
+        }
+    }
+    for(c = st->firstcorner[u]; c >= 0 && valid; c = st->nextcorner[c])
+    {
+        const int* tri = st->tris + (c/3)*3;
+        if(!st->deadtris[c/3])
+        {
+            if(meshlod_has_vertex(tri, v))
+            {
+                ++numedgetris;
+            }
+            else
+            {
+                double n0[3];
+                double n1[3];
+                double dot;
+                double len0;
+                double len1;
+                const taa_vec3* p[3];
+                for(k = 0; k < 3; ++k)
+                {
+                    p[k] = &st->pn[tri[k]].pos;
+                }
+                meshlod_calc_normal(p[0], p[1], p[2], n0);
+                p[c%3] = pv;
+                meshlod_calc_normal(p[0], p[1], p[2], n1);
+                dot = n0[0]*n1[0] + n0[1]*n1[1] + n0[2]*n1[2];
+                len0 = sqrt(n0[0]*n0[0] + n0[1]*n0[1] + n0[2]*n0[2]);
+                len1 = sqrt(n1[0]*n1[0] + n1[1]*n1[1] + n1[2]*n1[2]);
+                if(len1 <= len0*1e-3 || dot < 0.25*len0*len1)
+                {
+                    valid = 0;
+                }
+            }
+            for(k = 0; k < 3; ++k)
+            {
+                int w = tri[k];
+                if(w != u && w != v && st->marks[w] == st->mark)
+                {
+                    // marked again so it is only counted once
+                    st->marks[w] = st->mark + 1;
+                    ++numshared;
+                }
+            }
+        }
+    }
+    return valid && numshared == numedgetris;
+}
+
+//****************************************************************************
+static void meshlod_push(
+    meshlod_state* st,
+    const meshlod_collapse* e)
+{
+    meshlod_collapse* heap;
+    int i;
+    if(st->heapsize == st->maxheap)
+    {
+        st->maxheap *= 2;
+        st->heap = (meshlod_collapse*) realloc(
+            st->heap,
+            st->maxheap * sizeof(*st->heap));
+    }
+    heap = st->heap;
+    i = st->heapsize++;
+    while(i > 0 && heap[(i - 1)/2].cost > e->cost)
+    {
+        heap[i] = heap[(i - 1)/2];
+        i = (i - 1)/2;
+    }
+    heap[i] = *e;
+}
+
+//****************************************************************************
+static void meshlod_pop(
+    meshlod_state* st,
+    meshlod_collapse* e_out)
+{
+    meshlod_collapse* heap = st->heap;
+    meshlod_collapse last = heap[--st->heapsize];
+    int n = st->heapsize;
+    int i = 0;
+    int sifting = 1;
+    *e_out = heap[0];
+    while(sifting && i*2 + 1 < n)
+    {
+        int child = i*2 + 1;
+        if(child + 1 < n && heap[child + 1].cost < heap[child].cost)
+        {
+            ++child;
+        }
+        sifting = (heap[child].cost < last.cost);
+        if(sifting)
+        {
+            heap[i] = heap[child];
+            i = child;
+        }
+    }
+    heap[i] = last;
+}
+
+//****************************************************************************
+// queues the cheapest valid collapse of the vertex onto a neighbor
+static void meshlod_queue_vertex(
+    meshlod_state* st,
+    int u)
+{
+    meshlod_collapse best;
+    int c;
+    int k;
+    best.vert = u;
+    best.target = -1;
+    best.cost = 0.0;
+    best.stamp = ++st->stamps[u];
+    if(!st->locked[u] && !st->deadverts[u])
+    {
+        for(c = st->firstcorner[u]; c >= 0; c = st->nextcorner[c])
+        {
+            const int* tri = st->tris + (c/3)*3;
+            for(k = 0; k < 3 && !st->deadtris[c/3]; ++k)
+            {
+                int v = tri[k];
+                if(v != u)
+                {
+                    const taa_vec3* pu = &st->pn[u].pos;
+                    const taa_vec3* pv = &st->pn[v].pos;
+                    double cost = meshlod_eval_quadrics(
+                        st->quadrics + u*10,
+                        st->quadrics + v*10,
+                        pv);
+                    if(st->skinned)
+                    {
+                        double dx = pv->x - pu->x;
+                        double dy = pv->y - pu->y;
+                        double dz = pv->z - pu->z;
+                        cost +=
+                            meshlod_skin_penalty *
+                            meshlod_calc_skin_difference(st->jw+u, st->jw+v) *
+                            (dx*dx + dy*dy + dz*dz);
+                    }
+                    if((best.target < 0 || cost < best.cost) &&
+                       meshlod_is_valid(st, u, v))
+                    {
+                        best.cost = cost;
+                        best.target = v;
+                    }
+                }
+            }
+        }
+    }
+    if(best.target >= 0)
+    {
+        meshlod_push(st, &best);
+    }
+}
+
+//****************************************************************************
+// moves vertex u onto v, which removes the triangles of their edge
+static void meshlod_collapse_vertex(
+    meshlod_state* st,
+    int u,
+    int v)
+{
+    const taa_vec3* pv = &st->pn[v].pos;
+    int last = -1;
+    int c;
+    int k;
+    for(c = st->firstcorner[u]; c >= 0; c = st->nextcorner[c])
+    {
+        int* tri = st->tris + (c/3)*3;
+        if(!st->deadtris[c/3])
+        {
+            if(meshlod_has_vertex(tri, v))
+            {
+                st->deadtris[c/3] = 1;
+                --st->numalive;
+            }
+            else
+            {
+                // the distance v moves the surface from the triangle's
+                // original plane
+                double n[3];
+                double len;
+                const taa_vec3* p = &st->pn[tri[0]].pos;
+                meshlod_calc_normal(
+                    p,
+                    &st->pn[tri[1]].pos,
+                    &st->pn[tri[2]].pos,
+                    n);
+                len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+                if(len > 0.0)
+                {
+                    double d = fabs(
+                        n[0]*(pv->x - p->x) +
+                        n[1]*(pv->y - p->y) +
+                        n[2]*(pv->z - p->z)) / len;
+                    if(d > st->maxerror)
+                    {
+                        st->maxerror = (float) d;
+                    }
+                }
+                tri[c%3] = v;
+            }
+        }
+        last = c;
+    }
+    // the corners of u now belong to v
+    if(last >= 0)
+    {
+        st->nextcorner[last] = st->firstcorner[v];
+        st->firstcorner[v] = st->firstcorner[u];
+        st->firstcorner[u] = -1;
+    }
+    for(k = 0; k < 10; ++k)
+    {
+        st->quadrics[v*10 + k] += st->quadrics[u*10 + k];
+    }
+    st->deadverts[u] = 1;
+    // requeue v and every vertex whose triangles changed
+    meshlod_queue_vertex(st, v);
+    for(c = st->firstcorner[v]; c >= 0; c = st->nextcorner[c])
+    {
+        const int* tri = st->tris + (c/3)*3;
+        for(k = 0; k < 3 && !st->deadtris[c/3]; ++k)
+        {
+            if(tri[k] != v && !st->locked[tri[k]])
+            {
+                meshlod_queue_vertex(st, tri[k]);
+            }
+        }
+    }
+}
+
+//****************************************************************************
+// collapses the cheapest edges until at most numtris triangles remain or
+// nothing can be collapsed
+static void meshlod_simplify(
+    meshlod_state* st,
+    int numtris)
+{
+    while(st->numalive > numtris && st->heapsize > 0)
+    {
+        meshlod_collapse e;
+        meshlod_pop(st, &e);
+        if(e.stamp == st->stamps[e.vert] &&
+           !st->deadverts[e.vert] &&
+           !st->deadverts[e.target])
+        {
+            if(meshlod_is_valid(st, e.vert, e.target))
+            {
+                meshlod_collapse_vertex(st, e.vert, e.target);
+            }
+            else
+            {
+                meshlod_queue_vertex(st, e.vert);
+            }
+        }
+    }
+}
+
+//****************************************************************************
+// copies the vertices of a level from the source mesh, and gives each
+// binding the face of the same index. the faces must already be set.
+static void meshlod_gather_level(
+    const taa_scenemesh* mesh,
+    const int32_t* vertmap,
+    int numused,
+    taa_scenemesh* level)
+{
+    static const int vertsizes[] =
+    {
+        sizeof(pnvert),
+        sizeof(tvert),
+        sizeof(jwvert)
+    };
+    int numbindings = mesh->numbindings;
+    int i;
+    int k;
+    level->vertexstreams = (taa_scenemesh_stream*) malloc(
+        mesh->numstreams * sizeof(*level->vertexstreams));
+    for(k = 0; k < (int) mesh->numstreams; ++k)
+    {
+        const char* src = (const char*) mesh->vertexstreams[k].buffer;
+        char* dst;
+        int size = vertsizes[k];
+        level->vertexstreams[k] = mesh->vertexstreams[k];
+        dst = (char*) malloc(numused*size + 1);
+        for(i = 0; i < numused; ++i)
+        {
+            memcpy(dst + i*size, src + vertmap[i]*size, size);
+        }
+        level->vertexstreams[k].buffer = dst;
+        level->vertexstreams[k].numvertices = numused;
+    }
+    level->bindings = (taa_scenemesh_binding*) malloc(
+        (numbindings + 1) * sizeof(*level->bindings));
+    for(i = 0; i < numbindings; ++i)
+    {
+        level->bindings[i] = mesh->bindings[i];
+        level->bindings[i].firstface = i;
+        level->bindings[i].numfaces = (level->faces[i].numindices > 0);
+    }
+}
+
+//****************************************************************************
+// copies the remaining triangles and the vertices they use into a new mesh
+// with one face per binding
+static void meshlod_create_level(
+    const taa_scenemesh* mesh,
+    const meshlod_state* st,
+    taa_scenemesh* level_out,
+    int32_t** vertmap_out)
+{
+    int numbindings = mesh->numbindings;
+    int numverts = st->numverts;
+    int* remap = (int*) malloc((numverts + 1) * sizeof(*remap));
+    int* starts = (int*) calloc(numbindings + 1, sizeof(*starts));
+    int32_t* vertmap;
+    int numused;
+    int first;
+    int i;
+    int k;
+    *level_out = *mesh;
+    for(i = 0; i < numverts; ++i)
+    {
+        remap[i] = -1;
+    }
+    for(i = 0; i < st->numtris; ++i)
+    {
+        if(!st->deadtris[i])
+        {
+            ++starts[st->tribindings[i]];
+            for(k = 0; k < 3; ++k)
+            {
+                remap[st->tris[i*3 + k]] = 0;
+            }
+        }
+    }
+    // keep the used vertices in their original order
+    vertmap = (int32_t*) malloc((numverts + 1) * sizeof(*vertmap));
+    numused = 0;
+    for(i = 0; i < numverts; ++i)
+    {
+        if(remap[i] == 0)
+        {
+            vertmap[numused] = i;
+            remap[i] = numused++;
+        }
+    }
+    level_out->faces = (taa_scenemesh_face*) malloc(
+        (numbindings + 1) * sizeof(*level_out->faces));
+    first = 0;
+    for(i = 0; i < numbindings; ++i)
+    {
+        int count = starts[i] * 3;
+        level_out->faces[i].firstindex = first;
+        level_out->faces[i].numindices = count;
+        starts[i] = first;
+        first += count;
+    }
+    level_out->faces[numbindings].firstindex = first;
+    level_out->faces[numbindings].numindices = 0;
+    level_out->numfaces = numbindings;
+    level_out->indices = (int32_t*) malloc((first + 1) * sizeof(int32_t));
+    level_out->numindices = first;
+    for(i = 0; i < st->numtris; ++i)
+    {
+        if(!st->deadtris[i])
+        {
+            int32_t* dst = level_out->indices + starts[st->tribindings[i]];
+            for(k = 0; k < 3; ++k)
+            {
+                dst[k] = remap[st->tris[i*3 + k]];
+            }
+            starts[st->tribindings[i]] += 3;
+        }
+    }
+    // the surviving triangles are reordered for the post transform cache
+    // like the source mesh was
+    for(i = 0; i < numbindings; ++i)
+    {
+        vcache_optimize(
+            level_out->indices + level_out->faces[i].firstindex,
+            level_out->faces[i].numindices,
+            numused);
+    }
+    meshlod_gather_level(mesh, vertmap, numused, level_out);
+    *vertmap_out = vertmap;
+    free(starts);
+    free(remap);
+}
+
+//****************************************************************************
+// returns 0 if a stored level only refers to vertices of the mesh and to
+// its own vertices and indices, and has one face per binding in order
+static int meshlod_check_level(
+    const taa_scenemesh* mesh,
+    const meshlod_level* level)
+{
+    uint32_t numverts = mesh->vertexstreams[0].numvertices;
+    uint32_t numbindings = mesh->numbindings;
+    uint32_t first = 0;
+    int err = 0;
+    uint32_t i;
+    if(level->numfaces != numbindings + 1)
+    {
+        err = -1;
+    }
+    for(i = 0; i < level->numvertices && err == 0; ++i)
+    {
+        if(level->vertmap[i] < 0 || (uint32_t) level->vertmap[i] >= numverts)
+        {
+            err = -1;
+        }
+    }
+    for(i = 0; i < level->numindices && err == 0; ++i)
+    {
+        if(level->indices[i] < 0 ||
+           (uint32_t) level->indices[i] >= level->numvertices)
+        {
+            err = -1;
+        }
+    }
+    for(i = 0; i < numbindings && err == 0; ++i)
+    {
+        const taa_scenemesh_face* f = level->faces + i;
+        if(f->firstindex != (int32_t) first ||
+           f->numindices < 0 ||
+           (uint32_t) f->numindices > level->numindices - first)
+        {
+            err = -1;
+        }
+        first += (err == 0) ? f->numindices : 0;
+    }
+    if(err == 0 &&
+       (level->faces[numbindings].firstindex != (int32_t) first ||
+        level->faces[numbindings].numindices != 0 ||
+        first != level->numindices))
+    {
+        err = -1;
+    }
+    return err;
+}
+
+//****************************************************************************
+void meshlod_create(
+    const taa_scenemesh* mesh,
+    meshlod* lod_out)
+{
+    meshlod_state st;
+    int numverts = mesh->vertexstreams[0].numvertices;
+    int numtris = 0;
+    int prevtris;
+    int i;
+    int j;
+    int k;
+    memset(lod_out, 0, sizeof(*lod_out));
+    memset(&st, 0, sizeof(st));
+    lod_out->levels[0] = *mesh;
+    lod_out->numlevels = 1;
+    for(i = 0; i < (int) mesh->numbindings; ++i)
+    {
+        const taa_scenemesh_binding* b = mesh->bindings + i;
+        for(j = 0; j < b->numfaces; ++j)
+        {
+            numtris += mesh->faces[b->firstface + j].numindices / 3;
+        }
+    }
+    st.pn = (const pnvert*) mesh->vertexstreams[0].buffer;
+    st.jw = (const jwvert*) mesh->vertexstreams[2].buffer;
+    st.skinned = (mesh->skeleton >= 0);
+    st.numverts = numverts;
+    st.numtris = numtris;
+    st.numalive = numtris;
+    st.tris = (int*) malloc((numtris*3 + 1) * sizeof(int));
+    st.tribindings = (int*) malloc((numtris + 1) * sizeof(int));
+    st.deadtris = (uint8_t*) calloc(numtris + 1, sizeof(uint8_t));
+    st.firstcorner = (int*) malloc((numverts + 1) * sizeof(int));
+    st.nextcorner = (int*) malloc((numtris*3 + 1) * sizeof(int));
+    st.locked = (uint8_t*) malloc(numverts + 1);
+    st.deadverts = (uint8_t*) calloc(numverts + 1, sizeof(uint8_t));
+    st.quadrics = (double*) malloc((numverts*10 + 1) * sizeof(double));
+    st.stamps = (int*) calloc(numverts + 1, sizeof(int));
+    st.marks = (int*) calloc(numverts + 1, sizeof(int));
+    st.maxheap = numverts + 16;
+    st.heap = (meshlod_collapse*) malloc(st.maxheap * sizeof(*st.heap));
+    numtris = 0;
+    for(i = 0; i < (int) mesh->numbindings; ++i)
+    {
+        const taa_scenemesh_binding* b = mesh->bindings + i;
+        for(j = 0; j < b->numfaces; ++j)
+        {
+            const taa_scenemesh_face* f = mesh->faces + b->firstface + j;
+            int n = f->numindices - f->numindices%3;
+            for(k = 0; k < n; ++k)
+            {
+                st.tris[numtris*3 + k%3] = mesh->indices[f->firstindex + k];
+                if(k%3 == 2)
+                {
+                    st.tribindings[numtris++] = i;
+                }
+            }
+        }
+    }
+    for(i = 0; i < numverts; ++i)
+    {
+        st.firstcorner[i] = -1;
+    }
+    for(i = numtris*3 - 1; i >= 0; --i)
+    {
+        st.nextcorner[i] = st.firstcorner[st.tris[i]];
+        st.firstcorner[st.tris[i]] = i;
+    }
+    meshlod_lock_vertices(&st);
+    meshlod_add_quadrics(&st);
+    for(i = 0; i < numverts; ++i)
+    {
+        meshlod_queue_vertex(&st, i);
+    }
+    // each level halves the triangles of the previous one. the chain ends
+    // early once the locked vertices keep a level from getting much
+    // smaller than the last.
+    prevtris = numtris;
+    while(lod_out->numlevels < MESHLOD_MAX_LEVELS && numtris > 0)
+    {
+        meshlod_simplify(&st, prevtris / 2);
+        if(st.numalive == 0 || st.numalive > prevtris - prevtris/4)
+        {
+            break;
+        }
+        meshlod_create_level(
+            mesh,
+            &st,
+            lod_out->levels + lod_out->numlevels,
+            lod_out->vertmaps + lod_out->numlevels);
+        lod_out->errors[lod_out->numlevels] = st.maxerror;
+        ++lod_out->numlevels;
+        prevtris = st.numalive;
+    }
+    free(st.heap);
+    free(st.marks);
+    free(st.stamps);
+    free(st.quadrics);
+    free(st.deadverts);
+    free(st.locked);
+    free(st.nextcorner);
+    free(st.firstcorner);
+    free(st.deadtris);
+    free(st.tribindings);
+    free(st.tris);
+}
+
+//****************************************************************************
+int meshlod_load(
+    const taa_scenemesh* mesh,
+    const meshlod_level* levels,
+    int numlevels,
+    meshlod* lod_out)
+{
+    int err = 0;
+    int i;
+    memset(lod_out, 0, sizeof(*lod_out));
+    lod_out->levels[0] = *mesh;
+    lod_out->numlevels = 1;
+    if(numlevels < 0 || numlevels >= MESHLOD_MAX_LEVELS)
+    {
+        err = -1;
+    }
+    for(i = 0; i < numlevels && err == 0; ++i)
+    {
+        err = meshlod_check_level(mesh, levels + i);
+    }
+    for(i = 0; i < numlevels && err == 0; ++i)
+    {
+        const meshlod_level* src = levels + i;
+        taa_scenemesh* level = lod_out->levels + i + 1;
+        int32_t* vertmap;
+        *level = *mesh;
+        vertmap = (int32_t*) malloc(
+            (src->numvertices + 1) * sizeof(*vertmap));
+        memcpy(vertmap, src->vertmap, src->numvertices * sizeof(*vertmap));
+        level->faces = (taa_scenemesh_face*) malloc(
+            src->numfaces * sizeof(*level->faces));
+        memcpy(level->faces, src->faces, src->numfaces*sizeof(*level->faces));
+        level->numfaces = src->numfaces - 1;
+        level->indices = (int32_t*) malloc(
+            (src->numindices + 1) * sizeof(*level->indices));
+        memcpy(
+            level->indices,
+            src->indices,
+            src->numindices * sizeof(*level->indices));
+        level->numindices = src->numindices;
+        meshlod_gather_level(mesh, vertmap, src->numvertices, level);
+        lod_out->vertmaps[i + 1] = vertmap;
+        lod_out->errors[i + 1] = src->error;
+        ++lod_out->numlevels;
+    }
+    return err;
+}
+
+//****************************************************************************
+void meshlod_get_level(
+    const meshlod* lod,
+    int level,
+    meshlod_level* level_out)
+{
+    const taa_scenemesh* mesh = lod->levels + level;
+    level_out->vertmap = lod->vertmaps[level];
+    level_out->numvertices = mesh->vertexstreams[0].numvertices;
+    level_out->indices = mesh->indices;
+    level_out->numindices = mesh->numindices;
+    level_out->faces = mesh->faces;
+    level_out->numfaces = mesh->numfaces + 1;
+    level_out->error = lod->errors[level];
+}
+
+//****************************************************************************
+void meshlod_destroy(
+    meshlod* lod)
+{
+    int i;
+    int k;
+    for(i = 1; i < lod->numlevels; ++i)
+    {
+        taa_scenemesh* level = lod->levels + i;
+        for(k = 0; k < (int) level->numstreams; ++k)
+        {
+            free(level->vertexstreams[k].buffer);
+        }
+        free(level->vertexstreams);
+        free(level->indices);
+        free(level->faces);
+        free(level->bindings);
+        free(lod->vertmaps[i]);
+    }
+}
+
+//****************************************************************************
+void meshlod_release_stream(
+    meshlod* lod,
+    int stream)
+{
+    int i;
+    for(i = 1; i < lod->numlevels; ++i)
+    {
+        taa_scenemesh_stream* s = lod->levels[i].vertexstreams + stream;
+        free(s->buffer);
+        s->buffer = NULL;
+    }
+}
+
+//****************************************************************************
+int meshlod_select(
+    const meshlod* lod,
+    float scale)
+{
+    // the errors only grow from one level to the next
+    int level = 0;
+    while(level + 1 < lod->numlevels &&
+          lod->errors[level + 1]*scale <= MESHLOD_MAX_PIXEL_ERROR)
+    {
+        ++level;
+    }
+    return level;
+}
+
+//****************************************************************************
+void meshlod_get_range(
+    const meshlod* lod,
+    int level,
+    int firstbinding,
+    int lastbinding,
+    uint32_t* firstindex_out,
+    uint32_t* numindices_out)
+{
+    const taa_scenemesh_face* faces = lod->levels[level].faces;
+    const taa_scenemesh_face* last = faces + lastbinding;
+    *firstindex_out = faces[firstbinding].firstindex;
+    *numindices_out = last->firstindex + last->numindices - *firstindex_out;
+}
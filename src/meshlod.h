@@ -0,0 +1,114 @@
+#ifndef MESHLOD_H_
+#define MESHLOD_H_
+
+#include <taa/scene.h>
+
+typedef struct meshlod_s meshlod;
+typedef struct meshlod_level_s meshlod_level;
+
+enum
+{
+    // levels per mesh, including the full resolution mesh
+    MESHLOD_MAX_LEVELS = 4,
+    // largest error in pixels a level may have on screen to be drawn
+    MESHLOD_MAX_PIXEL_ERROR = 1,
+    // level of a node that is not drawn
+    MESHLOD_CULLED = 255
+};
+
+// chain of progressively simplified copies of a mesh. every level has
+// about half the triangles of the previous one, and is a complete mesh
+// with the same bindings, vertex streams, and skin joints as the source.
+// the vertices of a level are a subset of the source vertices in the same
+// order, so their attributes, including skin weights, are unchanged and
+// skinned meshes stay sorted by influence count.
+struct meshlod_s
+{
+    // levels[0] is the source mesh, which is not owned. each binding of a
+    // simplified level has exactly one face, which may be empty, so the
+    // indices of bindings b0 to b1 are the range from the first index of
+    // face b0 to the end of face b1.
+    taa_scenemesh levels[MESHLOD_MAX_LEVELS];
+    // largest distance any collapse of each level moved the surface by, in
+    // mesh units
+    float errors[MESHLOD_MAX_LEVELS];
+    // source vertex of each vertex of the simplified levels
+    int32_t* vertmaps[MESHLOD_MAX_LEVELS];
+    int numlevels;
+};
+
+// a simplified level in the form the scene cache stores it. the vertices
+// are copies of source vertices, so only the source vertex of each one is
+// stored.
+struct meshlod_level_s
+{
+    const int32_t* vertmap;
+    uint32_t numvertices;
+    const int32_t* indices;
+    uint32_t numindices;
+    // one face per binding followed by an empty face
+    const taa_scenemesh_face* faces;
+    uint32_t numfaces;
+    float error;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// simplifies the mesh by collapsing edges in order of their quadric error.
+// vertices on uv or normal seams and on open borders are never removed,
+// and the error of collapses between vertices with different skin weights
+// is increased. the mesh must have been formatted by skin_format_mesh.
+void meshlod_create(
+    const taa_scenemesh* mesh,
+    meshlod* lod_out);
+
+// rebuilds the simplified levels of a mesh from the levels returned by
+// meshlod_get_level, without simplifying the mesh again. the arrays of the
+// levels are copied. returns 0 on success, or -1 if the levels do not fit
+// the mesh, in which case the lod only has the source mesh.
+int meshlod_load(
+    const taa_scenemesh* mesh,
+    const meshlod_level* levels,
+    int numlevels,
+    meshlod* lod_out);
+
+// describes a simplified level. the arrays point into the lod.
+void meshlod_get_level(
+    const meshlod* lod,
+    int level,
+    meshlod_level* level_out);
+
+void meshlod_destroy(
+    meshlod* lod);
+
+// frees a vertex stream of the simplified levels once nothing reads it
+// anymore. the source mesh is not affected.
+void meshlod_release_stream(
+    meshlod* lod,
+    int stream);
+
+// returns the coarsest level whose error projects to at most
+// MESHLOD_MAX_PIXEL_ERROR pixels, given the pixels per mesh unit at the
+// distance of the node
+int meshlod_select(
+    const meshlod* lod,
+    float scale);
+
+// range of the indices of bindings firstbinding to lastbinding in a
+// simplified level
+void meshlod_get_range(
+    const meshlod* lod,
+    int level,
+    int firstbinding,
+    int lastbinding,
+    uint32_t* firstindex_out,
+    uint32_t* numindices_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MESHLOD_H_
@@ -0,0 +1,464 @@
+#include "mipgen.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define MIPGEN_AVX 1
+#define MIPGEN_AVX_TARGET __attribute__((target("avx")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1800
+#include <immintrin.h>
+#include <intrin.h>
+#define MIPGEN_AVX 1
+#define MIPGEN_AVX_TARGET
+#endif
+
+enum
+{
+    MIPGEN_SRGB_TABLE_SIZE = 16384
+};
+
+// filled in by the first call to mipgen_create
+static int mipgen_initialized = 0;
+static int mipgen_useavx = 0;
+static float mipgen_srgb_to_linear[256];
+static unsigned char mipgen_linear_to_srgb[MIPGEN_SRGB_TABLE_SIZE];
+
+//****************************************************************************
+static int mipgen_detect_avx(void)
+{
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#elif defined(MIPGEN_AVX)
+    int info[4];
+    __cpuid(info, 1);
+    // require avx, osxsave, and os support for the ymm registers
+    if((info[2] & (1 << 28)) && (info[2] & (1 << 27)))
+    {
+        return (_xgetbv(0) & 6) == 6;
+    }
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+//****************************************************************************
+static void mipgen_init(void)
+{
+    int i;
+    for(i = 0; i < 256; ++i)
+    {
+        double c = i / 255.0;
+        c = (c <= 0.04045) ? c/12.92 : pow((c + 0.055)/1.055, 2.4);
+        mipgen_srgb_to_linear[i] = (float) c;
+    }
+    for(i = 0; i < MIPGEN_SRGB_TABLE_SIZE; ++i)
+    {
+        double l = i / (double) (MIPGEN_SRGB_TABLE_SIZE - 1);
+        l = (l <= 0.0031308) ? l*12.92 : 1.055*pow(l, 1.0/2.4) - 0.055;
+        mipgen_linear_to_srgb[i] = (unsigned char) (l*255.0 + 0.5);
+    }
+    mipgen_useavx = mipgen_detect_avx();
+    mipgen_initialized = 1;
+}
+
+//****************************************************************************
+// modified bessel function of the first kind
+static double mipgen_bessel_i0(
+    double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    int k;
+    for(k = 1; k < 32; ++k)
+    {
+        double t = x / (2.0*k);
+        term *= t*t;
+        sum += term;
+    }
+    return sum;
+}
+
+//****************************************************************************
+static void mipgen_init_taps(
+    int filter,
+    mipgen_level* level)
+{
+    if(filter == MIPGEN_FILTER_KAISER)
+    {
+        // the filter is 3 destination pixels wide with alpha 4. each tap
+        // is at a source pixel center, which is (offset - 0.5) source
+        // pixels from the destination pixel center.
+        const double pi = 3.14159265358979323846;
+        const double alpha = 4.0;
+        const double halfwidth = 1.5;
+        double sum = 0.0;
+        int i;
+        level->numtaps = 6;
+        for(i = 0; i < 6; ++i)
+        {
+            double d = ((i - 2) - 0.5) * 0.5;
+            double x = d / halfwidth;
+            double sinc = sin(pi*d) / (pi*d);
+            double window;
+            window = mipgen_bessel_i0(alpha*sqrt(1.0 - x*x));
+            window /= mipgen_bessel_i0(alpha);
+            level->offsets[i] = i - 2;
+            level->weights[i] = (float) (sinc * window);
+            sum += level->weights[i];
+        }
+        for(i = 0; i < 6; ++i)
+        {
+            level->weights[i] = (float) (level->weights[i] / sum);
+        }
+    }
+    else
+    {
+        level->numtaps = 2;
+        level->offsets[0] = 0;
+        level->offsets[1] = 1;
+        level->weights[0] = 0.5f;
+        level->weights[1] = 0.5f;
+    }
+}
+
+//****************************************************************************
+// converts a source row to 4 floats per pixel
+static void mipgen_decode_row(
+    const mipgen_level* level,
+    const unsigned char* src,
+    float* out)
+{
+    uint32_t bpp = level->bpp;
+    int gamma = (level->flags & MIPGEN_GAMMA) != 0;
+    uint32_t x;
+    uint32_t c;
+    for(x = 0; x < level->srcwidth; ++x)
+    {
+        for(c = 0; c < 4; ++c)
+        {
+            float v = 0.0f;
+            if(c < bpp)
+            {
+                v = (c == 3 || !gamma) ?
+                    src[c] * (1.0f/255.0f) :
+                    mipgen_srgb_to_linear[src[c]];
+            }
+            out[c] = v;
+        }
+        src += bpp;
+        out += 4;
+    }
+}
+
+//****************************************************************************
+static void mipgen_encode_row(
+    const mipgen_level* level,
+    const float* in,
+    unsigned char* dst)
+{
+    uint32_t bpp = level->bpp;
+    int gamma = (level->flags & MIPGEN_GAMMA) != 0;
+    uint32_t x;
+    uint32_t c;
+    for(x = 0; x < level->dstwidth; ++x)
+    {
+        for(c = 0; c < bpp; ++c)
+        {
+            // the negative lobes of the kaiser filter can overshoot
+            float v = in[c];
+            v = (v > 0.0f) ? ((v < 1.0f) ? v : 1.0f) : 0.0f;
+            if(c == 3 || !gamma)
+            {
+                dst[c] = (unsigned char) (v*255.0f + 0.5f);
+            }
+            else
+            {
+                int i = (int) (v*(MIPGEN_SRGB_TABLE_SIZE - 1) + 0.5f);
+                dst[c] = mipgen_linear_to_srgb[i];
+            }
+        }
+        in += 4;
+        dst += bpp;
+    }
+}
+
+//****************************************************************************
+// horizontally filters and decimates a decoded source row
+static void mipgen_filter_row(
+    const mipgen_level* level,
+    const float* line,
+    float* out)
+{
+    int srcmax = level->srcwidth - 1;
+    int numtaps = level->numtaps;
+    int x;
+    int t;
+    for(x = 0; x < (int) level->dstwidth; ++x)
+    {
+        __m128 acc = _mm_setzero_ps();
+        for(t = 0; t < numtaps; ++t)
+        {
+            int sx = 2*x + level->offsets[t];
+            sx = (sx > 0) ? ((sx < srcmax) ? sx : srcmax) : 0;
+            acc = _mm_add_ps(acc, _mm_mul_ps(
+                _mm_set1_ps(level->weights[t]),
+                _mm_loadu_ps(line + sx*4)));
+        }
+        _mm_storeu_ps(out + x*4, acc);
+    }
+}
+
+//****************************************************************************
+// weighted sum of the horizontally filtered rows. n is a multiple of 4.
+static void mipgen_filter_column(
+    const float** rows,
+    const float* weights,
+    int numtaps,
+    uint32_t n,
+    float* out)
+{
+    uint32_t i;
+    int t;
+    for(i = 0; i < n; i += 4)
+    {
+        __m128 acc = _mm_setzero_ps();
+        for(t = 0; t < numtaps; ++t)
+        {
+            acc = _mm_add_ps(acc, _mm_mul_ps(
+                _mm_set1_ps(weights[t]),
+                _mm_loadu_ps(rows[t] + i)));
+        }
+        _mm_storeu_ps(out + i, acc);
+    }
+}
+
+#ifdef MIPGEN_AVX
+//****************************************************************************
+MIPGEN_AVX_TARGET static void mipgen_filter_column_avx(
+    const float** rows,
+    const float* weights,
+    int numtaps,
+    uint32_t n,
+    float* out)
+{
+    uint32_t n8 = n & ~7u;
+    uint32_t i;
+    int t;
+    for(i = 0; i < n8; i += 8)
+    {
+        __m256 acc = _mm256_setzero_ps();
+        for(t = 0; t < numtaps; ++t)
+        {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(
+                _mm256_set1_ps(weights[t]),
+                _mm256_loadu_ps(rows[t] + i)));
+        }
+        _mm256_storeu_ps(out + i, acc);
+    }
+    _mm256_zeroupper();
+    if(n8 < n)
+    {
+        const float* tail[MIPGEN_MAX_TAPS];
+        for(t = 0; t < numtaps; ++t)
+        {
+            tail[t] = rows[t] + n8;
+        }
+        mipgen_filter_column(tail, weights, numtaps, n - n8, out + n8);
+    }
+}
+#endif
+
+//****************************************************************************
+static void mipgen_run_task(
+    void* userdata,
+    int first,
+    int end)
+{
+    const mipgen_level* level = (const mipgen_level*) userdata;
+    int numtaps = level->numtaps;
+    int srcmax = level->srcheight - 1;
+    size_t rowsize = level->dstwidth * 4;
+    // source rows needed by the destination rows of the task
+    int firstrow = 2*first + level->offsets[0];
+    int numrows = 2*(end - 1) + level->offsets[numtaps - 1] - firstrow + 1;
+    float* line;
+    float* hrows;
+    float* vrow;
+    int y;
+    int t;
+    line = (float*) malloc(level->srcwidth * 4 * sizeof(*line));
+    hrows = (float*) malloc(numrows * rowsize * sizeof(*hrows));
+    vrow = (float*) malloc(rowsize * sizeof(*vrow));
+    for(y = 0; y < numrows; ++y)
+    {
+        int sy = firstrow + y;
+        sy = (sy > 0) ? ((sy < srcmax) ? sy : srcmax) : 0;
+        mipgen_decode_row(
+            level,
+            level->src + ((size_t) sy)*level->srcwidth*level->bpp,
+            line);
+        mipgen_filter_row(level, line, hrows + y*rowsize);
+    }
+    for(y = first; y < end; ++y)
+    {
+        const float* rows[MIPGEN_MAX_TAPS];
+        for(t = 0; t < numtaps; ++t)
+        {
+            rows[t] = hrows + (2*y + level->offsets[t] - firstrow)*rowsize;
+        }
+#ifdef MIPGEN_AVX
+        if(mipgen_useavx)
+        {
+            mipgen_filter_column_avx(
+                rows,
+                level->weights,
+                numtaps,
+                (uint32_t) rowsize,
+                vrow);
+        }
+        else
+#endif
+        {
+            mipgen_filter_column(
+                rows,
+                level->weights,
+                numtaps,
+                (uint32_t) rowsize,
+                vrow);
+        }
+        mipgen_encode_row(
+            level,
+            vrow,
+            level->dst + ((size_t) y)*level->dstwidth*level->bpp);
+    }
+    free(vrow);
+    free(hrows);
+    free(line);
+}
+
+//****************************************************************************
+uint32_t mipgen_create(
+    taa_scenetexture* scntex,
+    int filter,
+    int flags,
+    mipchain* chain_out)
+{
+    uint32_t bpp = 1;
+    uint32_t numlevels = 1;
+    uint32_t w = scntex->width;
+    uint32_t h = scntex->height;
+    size_t size = 0;
+    unsigned char* itr;
+    uint32_t i;
+    if(!mipgen_initialized)
+    {
+        mipgen_init();
+    }
+    switch(scntex->format)
+    {
+    case taa_SCENETEXTURE_LUM8 : bpp = 1; break;
+    case taa_SCENETEXTURE_BGR8 : bpp = 3; break;
+    case taa_SCENETEXTURE_BGRA8: bpp = 4; break;
+    case taa_SCENETEXTURE_RGB8 : bpp = 3; break;
+    case taa_SCENETEXTURE_RGBA8: bpp = 4; break;
+    }
+    while(w > 1 || h > 1)
+    {
+        w = (w > 1) ? w >> 1 : 1;
+        h = (h > 1) ? h >> 1 : 1;
+        size += w * h * bpp;
+        ++numlevels;
+    }
+    memset(chain_out, 0, sizeof(*chain_out));
+    chain_out->scntex = scntex;
+    chain_out->srcimages = scntex->images;
+    chain_out->srcnumlevels = scntex->numlevels;
+    chain_out->numlevels = numlevels;
+    chain_out->images = (void**) calloc(numlevels, sizeof(void*));
+    chain_out->levels = (mipgen_level*) calloc(
+        numlevels,
+        sizeof(*chain_out->levels));
+    chain_out->data = malloc(size + 1);
+    chain_out->images[0] = scntex->images[0];
+    itr = (unsigned char*) chain_out->data;
+    w = scntex->width;
+    h = scntex->height;
+    for(i = 1; i < numlevels; ++i)
+    {
+        mipgen_level* level = chain_out->levels + i;
+        level->src = (const unsigned char*) chain_out->images[i - 1];
+        level->dst = itr;
+        level->srcwidth = w;
+        level->srcheight = h;
+        w = (w > 1) ? w >> 1 : 1;
+        h = (h > 1) ? h >> 1 : 1;
+        level->dstwidth = w;
+        level->dstheight = h;
+        level->bpp = bpp;
+        level->flags = flags;
+        mipgen_init_taps(filter, level);
+        chain_out->images[i] = itr;
+        itr += w * h * bpp;
+    }
+    scntex->images = chain_out->images;
+    scntex->numlevels = numlevels;
+    return numlevels;
+}
+
+//****************************************************************************
+void mipgen_destroy(
+    mipchain* chain)
+{
+    if(chain->scntex != NULL)
+    {
+        chain->scntex->images = chain->srcimages;
+        chain->scntex->numlevels = chain->srcnumlevels;
+    }
+    free(chain->data);
+    free(chain->levels);
+    free(chain->images);
+    memset(chain, 0, sizeof(*chain));
+}
+
+//****************************************************************************
+int mipgen_count_tasks(
+    const mipchain* chain,
+    uint32_t level)
+{
+    if(level == 0 || level >= chain->numlevels)
+    {
+        return 0;
+    }
+    return (chain->levels[level].dstheight + MIPGEN_TASK_ROWS - 1) /
+        MIPGEN_TASK_ROWS;
+}
+
+//****************************************************************************
+int mipgen_add_tasks(
+    mipchain* chain,
+    uint32_t level,
+    taskpool_task* tasks_out)
+{
+    taskpool_task* task = tasks_out;
+    if(level > 0 && level < chain->numlevels)
+    {
+        mipgen_level* lvl = chain->levels + level;
+        uint32_t row;
+        for(row = 0; row < lvl->dstheight; row += MIPGEN_TASK_ROWS)
+        {
+            uint32_t end = row + MIPGEN_TASK_ROWS;
+            task->func = mipgen_run_task;
+            task->userdata = lvl;
+            task->first = row;
+            task->end = (end < lvl->dstheight) ? end : lvl->dstheight;
+            task->counter = NULL;
+            ++task;
+        }
+    }
+    return (int) (task - tasks_out);
+}
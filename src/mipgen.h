@@ -0,0 +1,98 @@
+#ifndef MIPGEN_H_
+#define MIPGEN_H_
+
+#include "taskpool.h"
+#include <taa/scene.h>
+
+typedef struct mipgen_level_s mipgen_level;
+typedef struct mipchain_s mipchain;
+
+enum
+{
+    // 2x2 average
+    MIPGEN_FILTER_BOX,
+    // kaiser windowed sinc, which keeps more detail than the box filter
+    // without the ringing of an unwindowed sinc
+    MIPGEN_FILTER_KAISER
+};
+
+enum
+{
+    // filter the color channels in linear space, treating the images as
+    // srgb. alpha is always filtered as is.
+    MIPGEN_GAMMA = 1 << 0
+};
+
+enum
+{
+    // number of rows of a level generated by one task
+    MIPGEN_TASK_ROWS = 16,
+    MIPGEN_MAX_TAPS = 6
+};
+
+// one generated level and the level it is filtered from
+struct mipgen_level_s
+{
+    const unsigned char* src;
+    unsigned char* dst;
+    uint32_t srcwidth;
+    uint32_t srcheight;
+    uint32_t dstwidth;
+    uint32_t dstheight;
+    uint32_t bpp;
+    int flags;
+    int numtaps;
+    // source pixel offsets relative to twice the destination coordinate
+    int offsets[MIPGEN_MAX_TAPS];
+    float weights[MIPGEN_MAX_TAPS];
+};
+
+// full mip chain of a scene texture that only had its top level. while the
+// chain exists, the scene texture's images point to it.
+struct mipchain_s
+{
+    taa_scenetexture* scntex;
+    // image array and level count that the scene texture had
+    void** srcimages;
+    uint32_t srcnumlevels;
+    void** images;
+    uint32_t numlevels;
+    // levels 1 and up, the first level is never copied
+    mipgen_level* levels;
+    void* data;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// allocates the missing levels of the texture down to 1x1, and points the
+// texture's images at them. the levels are not filled in until the tasks
+// from mipgen_add_tasks are run. returns the new number of levels.
+uint32_t mipgen_create(
+    taa_scenetexture* scntex,
+    int filter,
+    int flags,
+    mipchain* chain_out);
+
+// restores the texture's own images and frees the generated levels
+void mipgen_destroy(
+    mipchain* chain);
+
+int mipgen_count_tasks(
+    const mipchain* chain,
+    uint32_t level);
+
+// adds the tasks that filter the level from the one above it. the tasks of
+// each level must complete before the tasks of the next level are run.
+int mipgen_add_tasks(
+    mipchain* chain,
+    uint32_t level,
+    taskpool_task* tasks_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MIPGEN_H_
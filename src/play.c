@@ -5,279 +5,412 @@
 #include <taa/scalar.h>
 #include <taa/vec3.h>
 #include <taa/scene.h>
+#include "animsampler.h"
+#include "dbglines.h"
+#include "drawlist.h"
+#include "dxt.h"
 #include "freecam.h"
+#include "glext.h"
+#include "gpuskin.h"
+#include "instance.h"
+#include "instdraw.h"
+#include "meshlod.h"
+#include "prof.h"
+#include "scenecache.h"
+#include "scenecull.h"
+#include "skin.h"
+#include "streambuf.h"
+#include "texstream.h"
+#include "vquant.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <GL/gl.h>
 
-typedef struct pnvert_s pnvert;
-typedef struct tvert_s tvert;
-typedef struct jwvert_s jwvert;
 typedef struct rendermesh_s rendermesh;
 
 enum
 {
     CAM_WIDTH = 672,
-    CAM_HEIGHT = 480
-};
-
-struct pnvert_s
-{
-    taa_vec3 pos;
-    taa_vec3 normal;
-};
-
-struct tvert_s
-{
-    taa_vec2 texcoord;
-};
-
-struct jwvert_s
-{
-    int32_t joints[4];
-    float weights[4];
+    CAM_HEIGHT = 480,
+    // pixels per millisecond of the profiler graph
+    PROF_GRAPH_SCALE = 4,
+    // distance of the graph from the bottom left corner of the window
+    PROF_GRAPH_MARGIN = 10
 };
 
 struct rendermesh_s
 {
-    // input position normal vertices
-    const pnvert* pnvin;
-    // input joint indices and weights
-    const jwvert* jwvin;
-    // skinned position normal vertices
-    taa_vertexbuffer pnvb;
+    // bind pose vertices, joint indices, and weights. meshes skinned on the
+    // gpu only keep the joint count.
+    skinmesh skin;
+    int skinned;
+    // set if the vertex shader skins the mesh
+    int gpuskinned;
+    // bind pose position normal vertices, only used by meshes that are not
+    // skinned on the cpu. each instance skins into its own range of the
+    // stream buffer.
+    GLuint pnvbo;
+    // joint indices and weights of meshes skinned on the gpu
+    GLuint jwvbo;
     // texture coordinates
-    taa_vertexbuffer texvb;
-    taa_indexbuffer ib;
+    GLuint texvbo;
+    GLuint ibo;
+    // transforms of the mesh if pnvbo holds qverts, in which case there is
+    // no texvbo
+    const vquant* vq;
+    // GL_UNSIGNED_SHORT if every vertex can be indexed with 16 bits,
+    // otherwise GL_UNSIGNED_INT
+    GLenum indextype;
+    int indexsize;
     int numindices;
     int numvertices;
 };
 
 //****************************************************************************
-static void calc_joint_transforms(
-    const taa_sceneskel* skel,
-    const taa_scenenode* nodes,
-    taa_mat44* mats_out)
+static GLuint create_buffer(
+    const glext* ext,
+    GLenum target,
+    size_t size,
+    const void* data)
 {
-    int i;
-    int iend;
-    // calculate world space joint transforms
-    for(i = 0, iend = skel->numjoints; i < iend; ++i)
+    GLuint buf;
+    ext->genbuffers(1, &buf);
+    ext->bindbuffer(target, buf);
+    ext->bufferdata(target, size, data, GL_STATIC_DRAW);
+    ext->bindbuffer(target, 0);
+    return buf;
+}
+
+//****************************************************************************
+// uploads the streams that never change once, so they are not sent to the
+// gpu on every draw. skinned meshes are skinned by gs if it is not NULL and
+// their palette fits. unskinned meshes are quantized with vq if it is not
+// NULL.
+static void create_rendermesh(
+    const glext* ext,
+    const gpuskin* gs,
+    const vquant* vq,
+    taa_scenemesh* mesh,
+    rendermesh* rmesh)
+{
+    int numverts = mesh->vertexstreams[0].numvertices;
+    rmesh->skinned = (mesh->skeleton >= 0);
+    rmesh->gpuskinned = 0;
+    rmesh->pnvbo = 0;
+    rmesh->jwvbo = 0;
+    rmesh->texvbo = 0;
+    rmesh->vq = rmesh->skinned ? NULL : vq;
+    if(rmesh->skinned)
+    {
+        skin_create_mesh(mesh, &rmesh->skin);
+        rmesh->gpuskinned =
+            gs != NULL &&
+            rmesh->skin.numjoints <= gs->maxjoints;
+    }
+    if(rmesh->gpuskinned)
+    {
+        rmesh->jwvbo = create_buffer(
+            ext,
+            GL_ARRAY_BUFFER,
+            numverts * sizeof(jwvert),
+            mesh->vertexstreams[2].buffer);
+        skin_destroy_mesh(&rmesh->skin);
+    }
+    if(rmesh->vq != NULL)
+    {
+        // positions, normals, and texture coordinates in one buffer
+        qvert* qverts = (qvert*) malloc(numverts * sizeof(*qverts) + 1);
+        vquant_encode(rmesh->vq, mesh, qverts);
+        rmesh->pnvbo = create_buffer(
+            ext,
+            GL_ARRAY_BUFFER,
+            numverts * sizeof(*qverts),
+            qverts);
+        free(qverts);
+    }
+    else
     {
-        taa_sceneskel_joint* joint = skel->joints + i;
-        taa_mat44 localmat;
-        taa_sceneskel_calc_transform(skel, nodes, i, &localmat);
-        if(joint->parent >= 0)
+        if(!rmesh->skinned || rmesh->gpuskinned)
         {
-            taa_mat44_multiply(mats_out+joint->parent, &localmat, mats_out+i);
+            rmesh->pnvbo = create_buffer(
+                ext,
+                GL_ARRAY_BUFFER,
+                numverts * sizeof(pnvert),
+                mesh->vertexstreams[0].buffer);
         }
-        else
+        rmesh->texvbo = create_buffer(
+            ext,
+            GL_ARRAY_BUFFER,
+            numverts * 8,
+            mesh->vertexstreams[1].buffer);
+    }
+    if(numverts <= 0x10000)
+    {
+        // halve the index data of meshes small enough for 16 bit indices
+        uint16_t* indices16;
+        uint32_t i;
+        indices16 = (uint16_t*) malloc(mesh->numindices*sizeof(*indices16)+1);
+        for(i = 0; i < mesh->numindices; ++i)
         {
-            mats_out[i] = localmat;
+            indices16[i] = (uint16_t) mesh->indices[i];
         }
+        rmesh->indextype = GL_UNSIGNED_SHORT;
+        rmesh->indexsize = sizeof(uint16_t);
+        rmesh->ibo = create_buffer(
+            ext,
+            GL_ELEMENT_ARRAY_BUFFER,
+            mesh->numindices * sizeof(uint16_t),
+            indices16);
+        free(indices16);
+    }
+    else
+    {
+        rmesh->indextype = GL_UNSIGNED_INT;
+        rmesh->indexsize = sizeof(uint32_t);
+        rmesh->ibo = create_buffer(
+            ext,
+            GL_ELEMENT_ARRAY_BUFFER,
+            mesh->numindices * sizeof(uint32_t),
+            mesh->indices);
     }
+    rmesh->numvertices = numverts;
+    rmesh->numindices = mesh->numindices;
 }
 
 //****************************************************************************
-static void format_mesh(
-    taa_scenemesh* mesh)
+static void destroy_rendermesh(
+    const glext* ext,
+    rendermesh* rmesh)
 {
-    taa_scenemesh_vertformat vf[] =
+    if(rmesh->skinned && !rmesh->gpuskinned)
     {
-        {
-            "pn",
-            taa_SCENEMESH_USAGE_POSITION,
-            0,
-            taa_SCENEMESH_VALUE_FLOAT32,
-            3,
-            0,
-            0
-        },
-        {
-            "pn",
-            taa_SCENEMESH_USAGE_NORMAL,
-            0,
-            taa_SCENEMESH_VALUE_FLOAT32,
-            3,
-            12,
-            0
-        },
-        {
-            "t",
-            taa_SCENEMESH_USAGE_TEXCOORD,
-            0,
-            taa_SCENEMESH_VALUE_FLOAT32,
-            2,
-            0,
-            1
-        },
-        {
-            "jw",
-            taa_SCENEMESH_USAGE_BLENDINDEX,
-            0,
-            taa_SCENEMESH_VALUE_INT32,
-            4,
-            0,
-            2
-        },
-        {
-            "jw",
-            taa_SCENEMESH_USAGE_BLENDWEIGHT,
-            0,
-            taa_SCENEMESH_VALUE_FLOAT32,
-            4,
-            16,
-            2
-        },
-    };
-    taa_scenemesh_format(mesh, vf, sizeof(vf)/sizeof(*vf));
-    taa_scenemesh_triangulate(mesh);
+        skin_destroy_mesh(&rmesh->skin);
+    }
+    // deleting buffer 0 is ignored
+    ext->deletebuffers(1, &rmesh->pnvbo);
+    ext->deletebuffers(1, &rmesh->jwvbo);
+    ext->deletebuffers(1, &rmesh->texvbo);
+    ext->deletebuffers(1, &rmesh->ibo);
 }
 
 //****************************************************************************
-static void create_rendermesh(
-    taa_scenemesh* mesh,
-    rendermesh* rmesh)
+// returns the buffer and byte offset of the position normal vertices that
+// the instance draws the mesh with. waits for the instance's skinning of the
+// mesh, so it only blocks once the vertices are needed.
+static GLuint get_instance_vertices(
+    taskpool* pool,
+    streambuf* sb,
+    instance* inst,
+    int range,
+    int meshid,
+    rendermesh* rmesh,
+    size_t* offset_out)
 {
-
-    taa_vertexbuffer pnvb;
-    taa_vertexbuffer texvb;
-    taa_indexbuffer ib;
-    int numverts;
-    numverts = mesh->vertexstreams[0].numvertices;
-    taa_vertexbuffer_create(&pnvb);
-    taa_vertexbuffer_bind(pnvb);
-    taa_vertexbuffer_data(
-        numverts * 24,
-        mesh->vertexstreams[0].buffer,
-        taa_BUFUSAGE_DYNAMIC_DRAW);
-    // copy texture coords to vertex buffer
-    taa_vertexbuffer_create(&texvb);
-    taa_vertexbuffer_bind(texvb);
-    taa_vertexbuffer_data(
-        numverts * 8,
-        mesh->vertexstreams[1].buffer,
-        taa_BUFUSAGE_STATIC_DRAW);
-    // copy indices to index buffer
-    taa_indexbuffer_create(&ib);
-    taa_indexbuffer_bind(ib);
-    taa_indexbuffer_data(
-        mesh->numindices * 4,
-        mesh->indices,
-        taa_BUFUSAGE_STATIC_DRAW);
-    // place results in rendermesh struct
-    rmesh->pnvin = (const pnvert*) mesh->vertexstreams[0].buffer;
-    rmesh->jwvin = (const jwvert*) mesh->vertexstreams[2].buffer;
-    rmesh->pnvb = pnvb;
-    rmesh->texvb = texvb;
-    rmesh->ib = ib;
-    rmesh->numvertices = numverts;
-    rmesh->numindices = mesh->numindices;
+    if(rmesh->skinned && !rmesh->gpuskinned)
+    {
+        skinjob* job = inst->skinjobs + meshid;
+        taskpool_wait(pool, &job->counter);
+        streambuf_end_write(sb, range);
+        *offset_out = streambuf_get_offset(sb, range);
+        return streambuf_get_buffer(sb);
+    }
+    *offset_out = 0;
+    return rmesh->pnvbo;
 }
 
-static void destroy_rendermesh(
-    rendermesh* rmesh)
+//****************************************************************************
+// copies the command with its index range in a level of the mesh
+static void get_level_cmd(
+    const meshlod* lod,
+    int level,
+    const drawcmd* cmd,
+    drawcmd* cmd_out)
 {
-    taa_vertexbuffer_destroy(rmesh->pnvb);
-    taa_vertexbuffer_destroy(rmesh->texvb);
-    taa_indexbuffer_destroy(rmesh->ib);
+    *cmd_out = *cmd;
+    if(level > 0)
+    {
+        meshlod_get_range(
+            lod,
+            level,
+            cmd->firstbinding,
+            cmd->lastbinding,
+            &cmd_out->firstindex,
+            &cmd_out->numindices);
+    }
 }
 
-static void draw_rendermesh(
+//****************************************************************************
+// adds a line from each joint of every skeleton of the instance to its
+// parent, and the axes of each joint, in world space
+static void add_skeleton_lines(
     const taa_scene* scene,
-    const taa_scenemesh* mesh,
-    const taa_mat44* viewmat,
-    const taa_mat44* modelmat,
-    taa_texture2d* textures,
-    rendermesh* rmesh)
+    const instance* inst,
+    dbglines* lines)
 {
-    taa_scenemesh_binding* binditr = mesh->bindings;
-    taa_scenemesh_binding* bindend = binditr + mesh->numbindings;
-    taa_mat44 vmmat;
-    taa_mat44_multiply(viewmat, modelmat, &vmmat);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadMatrixf(&vmmat.x.x);
-    glVertexPointer(3, GL_FLOAT, 24, &((pnvert**) rmesh->pnvb)[0]->pos);
-    glNormalPointer(GL_FLOAT, 24, &((pnvert**) rmesh->pnvb)[0]->normal);
-    glTexCoordPointer(2, GL_FLOAT, 8, *((void**) rmesh->texvb));
-    while(binditr != bindend)
+    static const uint8_t bonecolor[] = { 255, 255, 255, 255 };
+    static const uint8_t axiscolors[][4] =
     {
-        int32_t firstindex;
-        int32_t indexend;
-        // determine if material binding uses color map
-        taa_scenematerial* mat = scene->materials + binditr->materialid;
-        if(binditr->materialid >= 0 && mat->diffusetexture >= 0)
-        {
-            glEnable(GL_TEXTURE_2D);
-            glBindTexture(
-                GL_TEXTURE_2D,
-                (GLuint) (size_t) textures[mat->diffusetexture]);
-        }
-        else
+        { 255, 0, 0, 255 },
+        { 0, 255, 0, 255 },
+        { 0, 0, 255, 255 }
+    };
+    uint32_t i;
+    int j;
+    int k;
+    for(i = 0; i < scene->numskeletons; ++i)
+    {
+        const taa_sceneskel* skel = scene->skeletons + i;
+        const taa_mat44* jointmats = inst->poses[i].jointmats;
+        for(j = 0; j < (int) skel->numjoints; ++j)
         {
-            glDisable(GL_TEXTURE_2D);
+            int parent = skel->joints[j].parent;
+            taa_mat44 worldmat;
+            taa_vec3 origin;
+            taa_mat44_multiply(&inst->gridmat, jointmats + j, &worldmat);
+            origin.x = worldmat.w.x;
+            origin.y = worldmat.w.y;
+            origin.z = worldmat.w.z;
+            if(parent >= 0)
+            {
+                taa_vec4 p;
+                taa_vec3 end;
+                taa_mat44_transform_vec4(
+                    &inst->gridmat,
+                    &jointmats[parent].w,
+                    &p);
+                end.x = p.x;
+                end.y = p.y;
+                end.z = p.z;
+                dbglines_add(lines, &origin, &end, bonecolor);
+            }
+            // the axes are one unit long in joint space
+            for(k = 0; k < 3; ++k)
+            {
+                const taa_vec4* axis = &worldmat.x + k;
+                taa_vec3 end;
+                end.x = origin.x + axis->x;
+                end.y = origin.y + axis->y;
+                end.z = origin.z + axis->z;
+                dbglines_add(lines, &origin, &end, axiscolors[k]);
+            }
         }
-        // determine the index range for this material binding
-        firstindex = 0;
-        indexend = 0;
-        if(binditr->numfaces > 0)
+    }
+}
+
+//****************************************************************************
+// adds a column for each frame of the profiler history, from oldest to
+// newest, stacking the time of each zone of the render thread. the part of
+// the frame outside of every other zone is stacked last, and lines mark 60
+// and 30 hz.
+static void add_profile_lines(
+    const prof* pf,
+    dbglines* lines)
+{
+    static const uint8_t colors[PROF_NUM_FRAME_ZONES][4] =
+    {
+        { 128, 128, 128, 255 },
+        { 255, 64, 64, 255 },
+        { 255, 160, 0, 255 },
+        { 255, 255, 0, 255 },
+        { 0, 255, 0, 255 },
+        { 0, 160, 255, 255 },
+        { 160, 64, 255, 255 },
+        { 255, 255, 255, 255 }
+    };
+    static const uint8_t markcolor[] = { 64, 64, 64, 255 };
+    float scale = PROF_GRAPH_SCALE * 1.0e-6f;
+    float left = PROF_GRAPH_MARGIN;
+    float right = left + PROF_HISTORY;
+    float bottom = PROF_GRAPH_MARGIN;
+    taa_vec3 a;
+    taa_vec3 b;
+    int n = (pf->numframes < PROF_HISTORY) ? pf->numframes : PROF_HISTORY;
+    int i;
+    int z;
+    a.z = b.z = 0.0f;
+    for(i = 0; i < n; ++i)
+    {
+        const int64_t* times;
+        int64_t rest;
+        times = pf->history[(pf->numframes - n + i) % PROF_HISTORY];
+        rest = times[PROF_ZONE_FRAME];
+        a.x = b.x = left + i + 0.5f;
+        b.y = bottom;
+        for(z = 0; z < PROF_NUM_FRAME_ZONES; ++z)
         {
-            const taa_scenemesh_face* fface = mesh->faces+binditr->firstface;
-            const taa_scenemesh_face* lface = fface + binditr->numfaces - 1;
-            firstindex = fface->firstindex;
-            indexend = lface->firstindex + lface->numindices;
+            // the frame zone is drawn last with the time not in the others
+            int zone = (z + 1) % PROF_NUM_FRAME_ZONES;
+            int64_t t = (zone == PROF_ZONE_FRAME) ? rest : times[zone];
+            rest -= (zone == PROF_ZONE_FRAME) ? 0 : t;
+            if(t > 0)
+            {
+                a.y = b.y;
+                b.y += t * scale;
+                dbglines_add(lines, &a, &b, colors[zone]);
+            }
         }
-        glDrawElements(
-            GL_TRIANGLES,
-            indexend - firstindex,
-            GL_UNSIGNED_INT,
-            *((unsigned int**) rmesh->ib) + firstindex);
-        ++binditr;
     }
+    a.x = left;
+    b.x = right;
+    a.y = b.y = bottom + 1.0e6f/60.0f * scale;
+    dbglines_add(lines, &a, &b, markcolor);
+    a.y = b.y = bottom + 1.0e6f/30.0f * scale;
+    dbglines_add(lines, &a, &b, markcolor);
 }
 
-static void skin_rendermesh(
-    rendermesh* rmesh,
-    taa_scenemesh* mesh,
-    const taa_mat44* jointmats)
+//****************************************************************************
+// picks the level of each visible node of every instance from the projected
+// error of its levels. a mesh that is skinned on the cpu is skinned once per
+// instance at the finest level any of its nodes needs, so all of its nodes
+// are drawn at that level.
+static void select_levels(
+    const taa_scene* scene,
+    const scenecull* sc,
+    const meshlod* lods,
+    const rendermesh* rmeshes,
+    int numinstances,
+    uint8_t* nodelevels_out,
+    uint8_t* meshlevels_out)
 {
-    pnvert* pnitr;
-    pnvert* pnend;
-    const pnvert* pnsrc;
-    const jwvert* jwsrc;
-    int numverts;
-    numverts = rmesh->numvertices;
-    taa_vertexbuffer_bind(rmesh->pnvb);
-    pnitr = (pnvert*) *((void**) rmesh->pnvb); // TODO: fix this; it's nasty
-    pnend = pnitr + numverts;
-    pnsrc = rmesh->pnvin;
-    jwsrc = rmesh->jwvin;
-    while(pnitr != pnend)
+    int numnodes = scene->numnodes;
+    int nummeshes = scene->nummeshes;
+    int i;
+    int j;
+    memset(meshlevels_out, MESHLOD_CULLED, numinstances*nummeshes);
+    for(i = 0; i < numinstances; ++i)
     {
-        uint32_t i = 0;
-        taa_vec3_set(0.0f,0.0f,0.0f, &pnitr->pos);
-        taa_vec3_set(0.0f,0.0f,0.0f, &pnitr->normal);
-        for(i = 0; i < 4; ++i)
+        uint8_t* nodelevels = nodelevels_out + i*numnodes;
+        uint8_t* meshlevels = meshlevels_out + i*nummeshes;
+        for(j = 0; j < sc->nummeshnodes; ++j)
         {
-            taa_scenemesh_skinjoint* sj = mesh->joints + jwsrc->joints[i];
-            float w = jwsrc->weights[i];
-            taa_mat44* invbindmat = &sj->invbindmatrix;
-            taa_mat44 M;
-            taa_vec3 v;
-            taa_vec3 n;
-            taa_mat44_multiply(jointmats + sj->animjoint, invbindmat, &M);
-            taa_mat44_transform_vec3(&M, &pnsrc->pos, &v);
-            taa_vec4_set(0.0f,0.0f,0.0f,1.0f,&M.w);
-            taa_mat44_transform_vec3(&M, &pnsrc->normal, &n);
-            taa_vec3_scale(&v, w, &v);
-            taa_vec3_scale(&n, w, &n);
-            taa_vec3_add(&pnitr->pos, &v, &pnitr->pos);
-            taa_vec3_add(&pnitr->normal, &n, &pnitr->normal);
+            int node = sc->meshnodes[j];
+            int meshid = scene->nodes[node].value.meshid;
+            nodelevels[node] = MESHLOD_CULLED;
+            if(sc->nodevisible[i*numnodes + node])
+            {
+                int level = meshlod_select(
+                    lods + meshid,
+                    sc->nodescales[i*numnodes + node]);
+                nodelevels[node] = (uint8_t) level;
+                if(level < meshlevels[meshid])
+                {
+                    meshlevels[meshid] = (uint8_t) level;
+                }
+            }
+        }
+        for(j = 0; j < sc->nummeshnodes; ++j)
+        {
+            int node = sc->meshnodes[j];
+            int meshid = scene->nodes[node].value.meshid;
+            const rendermesh* rmesh = rmeshes + meshid*MESHLOD_MAX_LEVELS;
+            if(rmesh->skinned &&
+               !rmesh->gpuskinned &&
+               nodelevels[node] != MESHLOD_CULLED)
+            {
+                nodelevels[node] = meshlevels[meshid];
+            }
         }
-        taa_vec3_normalize(&pnitr->normal, &pnitr->normal);
-        ++pnsrc;
-        ++jwsrc;
-        ++pnitr;
     }
 }
 
@@ -287,91 +420,230 @@ void play(
     taa_window win,
     taa_glcontext_display rcdisplay,
     taa_glcontext_surface rcsurface,
-    taa_scene* scene)
+    taa_scene* scene,
+    scenecache* cache,
+    const dxttexture* dxttextures,
+    const animsampler* sampler,
+    meshlod* lods,
+    int gpuskinning,
+    int quantize,
+    int numthreads,
+    int numinstances,
+    float spacing,
+    const char* tracepath)
 {
     taa_mouse_state mouse;
-    taa_scenenode* animnodes;
+    glext ext;
+    gpuskin gs;
+    gpuskin* gsptr;
+    taskpool* pool;
+    taskpool_task* tasks;
+    instance* instances;
     rendermesh* rmeshes;
-    taa_mat44** skelmats;
-    taa_texture2d* textures;
+    vquant* vquants;
+    taa_mat44* meshmats;
+    uint8_t* nodelevels;
+    uint8_t* meshlevels;
+    size_t* skinsizes;
+    streambuf* sb;
+    texstream* ts;
+    drawlist dl;
+    drawstate ds;
+    instdraw idraw;
+    scenecull sc;
+    dbglines lines;
+    dbglines graph;
+    prof pf;
+    int showskels;
+    int showprof;
+    int maxlines;
+    int lastinst;
+    int lastnode;
+    int c;
     int i;
+    int j;
+    int k;
     int numnodes;
     int numskels;
     int nummeshes;
-    int numtextures;
-
-    numnodes = scene->numnodes;
-    animnodes = (taa_scenenode*) taa_memalign(
-        16,
-        numnodes*sizeof(*animnodes));
-    memcpy(animnodes,scene->nodes, numnodes*sizeof(*animnodes));
+    int numtasks;
+    int numjointtasks;
 
-    numskels = scene->numskeletons;
-    skelmats = (taa_mat44**) malloc(numskels * sizeof(*skelmats));
-    for(i = 0; i < numskels; ++i)
+    // the vertex buffers are required, client arrays are not supported
+    glext_load(&ext);
+    if(!ext.vbo)
     {
-        taa_mat44* jointmats;
-        int numjoints = scene->skeletons[i].numjoints;
-        jointmats = (taa_mat44*)  taa_memalign(
-            16,
-            numjoints*sizeof(*jointmats));
-        skelmats[i] = jointmats;
+        printf("vertex buffer objects are not supported\n");
+        return;
+    }
+    gsptr = NULL;
+    if(gpuskinning)
+    {
+        if(gpuskin_create(&ext, &gs) == 0)
+        {
+            gsptr = &gs;
+        }
+        else
+        {
+            printf("skinning on the cpu instead\n");
+        }
     }
 
+    numnodes = scene->numnodes;
+    numskels = scene->numskeletons;
     nummeshes = scene->nummeshes;
-    rmeshes = (rendermesh*) malloc(nummeshes * sizeof(*rmeshes));
+
+    // each level of detail of a mesh gets its own buffers. the levels are
+    // skinned the same way as the full resolution mesh, and never need more
+    // skinning tasks.
+    // the quantized levels of an unskinned mesh share the transforms of
+    // the full mesh, whose bounds contain them. meshmats holds the position
+    // transform of each mesh, which is folded into its model matrices.
+    rmeshes = (rendermesh*) calloc(
+        nummeshes*MESHLOD_MAX_LEVELS + 1,
+        sizeof(*rmeshes));
+    vquants = (vquant*) malloc((nummeshes + 1) * sizeof(*vquants));
+    meshmats = (taa_mat44*) malloc((nummeshes + 1) * sizeof(*meshmats));
+    numtasks = 0;
     for(i = 0; i < nummeshes; ++i)
     {
-        format_mesh(scene->meshes + i);
-        create_rendermesh(scene->meshes + i, rmeshes + i);
+        rendermesh* rmesh = rmeshes + i*MESHLOD_MAX_LEVELS;
+        const vquant* vq = NULL;
+        taa_mat44_identity(meshmats + i);
+        if(quantize && scene->meshes[i].skeleton < 0)
+        {
+            vquant_create(scene->meshes + i, vquants + i);
+            meshmats[i] = vquants[i].posmat;
+            vq = vquants + i;
+        }
+        create_rendermesh(&ext, gsptr, vq, lods[i].levels, rmesh);
+        for(k = 1; k < lods[i].numlevels; ++k)
+        {
+            create_rendermesh(
+                &ext,
+                rmesh->gpuskinned ? gsptr : NULL,
+                vq,
+                lods[i].levels + k,
+                rmesh + k);
+        }
+        if(rmesh->skinned && !rmesh->gpuskinned)
+        {
+            numtasks += skin_count_tasks(&rmesh->skin);
+        }
     }
+    // the largest batch is either the skinning or the pose and transform
+    // updates of every instance
+    numtasks = (numtasks > numskels + 1) ? numtasks : numskels + 1;
+    tasks = (taskpool_task*) malloc(
+        (numinstances*numtasks + 1) * sizeof(*tasks));
+    pool = taskpool_create(numthreads);
 
-    numtextures = scene->numtextures;
-    textures = (taa_texture2d*) malloc(numtextures * sizeof(*textures));
-    for(i = 0; i < numtextures; ++i)
+    // every instance skins each level of each skinned mesh into its own
+    // range of the stream buffer. meshes that are not skinned on the cpu,
+    // and levels past the end of a chain, get empty ranges.
+    skinsizes = (size_t*) calloc(
+        numinstances*nummeshes*MESHLOD_MAX_LEVELS + 1,
+        sizeof(*skinsizes));
+    for(i = 0; i < numinstances; ++i)
     {
-        taa_scenetexture* scntex = scene->textures + i;
-        taa_texfilter minfilter = taa_TEXFILTER_NEAREST_MIPMAP_LINEAR;
-        taa_texfilter magfilter = taa_TEXFILTER_LINEAR;
-        taa_texformat format = taa_TEXFORMAT_LUM8;
-        uint32_t level;
-        uint32_t w;
-        uint32_t h;
-        switch(scntex->format)
+        for(j = 0; j < nummeshes*MESHLOD_MAX_LEVELS; ++j)
         {
-        case taa_SCENETEXTURE_LUM8 : format = taa_TEXFORMAT_LUM8 ; break;
-        case taa_SCENETEXTURE_BGR8 : format = taa_TEXFORMAT_BGR8 ; break;
-        case taa_SCENETEXTURE_BGRA8: format = taa_TEXFORMAT_BGRA8; break;
-        case taa_SCENETEXTURE_RGB8 : format = taa_TEXFORMAT_RGB8 ; break;
-        case taa_SCENETEXTURE_RGBA8: format = taa_TEXFORMAT_RGBA8; break;
+            if(rmeshes[j].skinned && !rmeshes[j].gpuskinned)
+            {
+                skinsizes[i*nummeshes*MESHLOD_MAX_LEVELS + j] =
+                    rmeshes[j].numvertices * sizeof(pnvert);
+            }
         }
-        if(scntex->numlevels == 1)
+    }
+    sb = streambuf_create(
+        skinsizes,
+        numinstances*nummeshes*MESHLOD_MAX_LEVELS,
+        &ext);
+    nodelevels = (uint8_t*) malloc(numinstances*numnodes + 1);
+    meshlevels = (uint8_t*) malloc(numinstances*nummeshes + 1);
+    memset(nodelevels, MESHLOD_CULLED, numinstances*numnodes);
+
+    instances = (instance*) malloc(numinstances * sizeof(*instances));
+    for(i = 0; i < numinstances; ++i)
+    {
+        instance* inst = instances + i;
+        instance_create(scene, sampler, i, numinstances, spacing, inst);
+        for(j = 0; j < nummeshes; ++j)
         {
-            minfilter = taa_TEXFILTER_LINEAR;
+            rendermesh* rmesh = rmeshes + j*MESHLOD_MAX_LEVELS;
+            if(rmesh->gpuskinned)
+            {
+                // the job only calculates the palette
+                inst->skinjobs[j].smesh = &rmesh->skin;
+            }
+            else if(rmesh->skinned)
+            {
+                // start with the bind pose in case the mesh is never posed
+                for(k = 0; k < lods[j].numlevels; ++k)
+                {
+                    int range = (i*nummeshes + j)*MESHLOD_MAX_LEVELS + k;
+                    skin_copy_bind_pose(
+                        &rmesh[k].skin,
+                        (pnvert*) streambuf_begin_write(sb, range));
+                    streambuf_end_write(sb, range);
+                }
+                inst->skinjobs[j].smesh = &rmesh->skin;
+            }
         }
-        taa_texture2d_create(textures + i);
-        taa_texture2d_bind(textures[i]);
-        taa_texture2d_setparameter(taa_TEXPARAM_MAX_LEVEL, scntex->numlevels-1);
-        taa_texture2d_setparameter(taa_TEXPARAM_MIN_FILTER, minfilter);
-        taa_texture2d_setparameter(taa_TEXPARAM_MAG_FILTER, magfilter);
-        taa_texture2d_setparameter(taa_TEXPARAM_WRAP_S, taa_TEXWRAP_CLAMP);
-        taa_texture2d_setparameter(taa_TEXPARAM_WRAP_T, taa_TEXWRAP_CLAMP);
+    }
+
+    // the mesh bounds are calculated once, and the hierarchy over the
+    // nodes of every instance is built by the first update
+    scenecull_create(scene, numinstances, &sc);
 
-        w = scntex->width;
-        h = scntex->height;
-        for(level = 0; level < scntex->numlevels; ++level)
+    // the skin meshes, vertex buffers, levels, and bounds of the skinned
+    // meshes have all been built, so only their texture coordinates are
+    // still kept in the interleaved streams
+    for(i = 0; i < nummeshes; ++i)
+    {
+        if(rmeshes[i*MESHLOD_MAX_LEVELS].skinned)
         {
-            taa_texture2d_image(
-                level,
-                format,
-                w,
-                h,
-                scntex->images[level]);
-            w >>= 1;
-            h >>= 1;
+            scenecache_release_stream(cache, scene->meshes + i, 0);
+            scenecache_release_stream(cache, scene->meshes + i, 2);
+            meshlod_release_stream(lods + i, 0);
+            meshlod_release_stream(lods + i, 2);
         }
     }
 
+    // each joint of each instance has a bone line to its parent and three
+    // axis lines. the skeletons are shown until they are toggled off.
+    maxlines = 0;
+    for(i = 0; i < numskels; ++i)
+    {
+        maxlines += scene->skeletons[i].numjoints * 4 * numinstances;
+    }
+    dbglines_create(&ext, maxlines, &lines);
+    showskels = 1;
+
+    // the profiler only records while its overlay is shown or a trace is
+    // being written. the graph has a line per render thread zone per frame,
+    // plus the 60 and 30 hz marks.
+    if(prof_create(tracepath, &pf) != 0)
+    {
+        printf("could not create trace file %s\n", tracepath);
+    }
+    dbglines_create(&ext, PROF_HISTORY*PROF_NUM_FRAME_ZONES + 2, &graph);
+    showprof = 0;
+
+    // nodes that share an unskinned mesh are drawn together by instanced
+    // draws if the driver supports them
+    drawlist_create(scene, ext.instancing, &dl);
+    if(dl.numgroups > 0 &&
+       instdraw_create(&ext, &dl, numinstances, meshmats, &idraw) != 0)
+    {
+        drawlist_destroy(&dl);
+        drawlist_create(scene, 0, &dl);
+    }
+
+    // the scene is drawn right away, and the textures sharpen as their
+    // levels are uploaded
+    ts = texstream_create(scene, dxttextures, &ext);
+
     taa_mouse_query(windisplay, win, &mouse);
     {
         freecam cam;
@@ -394,7 +666,7 @@ void play(
             1.0f,
             100.0f,
             &o);
-        begintime = taa_timer_sample_cpu();
+        begintime = prof_sample_ns();
         currenttime = 0;
         while(!quit)
         {
@@ -404,6 +676,9 @@ void play(
             int numevents;
             unsigned int vw;
             unsigned int vh;
+            pf.enabled = (showprof || pf.trace != NULL);
+            taskpool_set_clock(pool, pf.enabled ? prof_sample_ns : NULL);
+            prof_begin(&pf, PROF_ZONE_FRAME);
             numevents = taa_window_update(windisplay, win, winevents, 16);
             taa_window_get_size(windisplay, win, &vw, &vh);
             taa_mouse_update(winevents, numevents, &mouse);
@@ -422,6 +697,14 @@ void play(
                     {
                         quit = 1;
                     }
+                    else if(evtitr->key.keycode == taa_KEY_B)
+                    {
+                        showskels = !showskels;
+                    }
+                    else if(evtitr->key.keycode == taa_KEY_P)
+                    {
+                        showprof = !showprof;
+                    }
                     break;
                 default:
                     break;
@@ -430,24 +713,35 @@ void play(
             }
 
             // update animate sqts
-            if(scene->numanimations > 0)
+            prof_begin(&pf, PROF_ZONE_ANIM);
+            if(sampler != NULL)
             {
-                taa_sceneanim* anim = scene->animations;
-                int64_t endtime = taa_timer_sample_cpu();
+                int64_t endtime = prof_sample_ns();
                 int64_t dt;
                 double sec;
                 dt = endtime - begintime;
-                if(dt >= 0 && dt < taa_TIMER_MS_TO_NS(1000))
+                if(dt < taa_TIMER_MS_TO_NS(1000))
                 {
-                    // clamp timer since it is unreliable
+                    // skip stalls, such as while the window is dragged
                     currenttime += dt;
                 }
                 sec = taa_TIMER_NS_TO_S((double) currenttime);
-                sec = sec - anim->length*floor(sec/anim->length);
-                taa_sceneanim_play(anim, (float) sec, animnodes, numnodes);
+                numtasks = 0;
+                for(i = 0; i < numinstances; ++i)
+                {
+                    numtasks += instance_add_anim_task(
+                        instances + i,
+                        sec,
+                        tasks + numtasks);
+                }
+                taskpool_run(pool, tasks, numtasks);
+                taskpool_finish(pool);
+                prof_add_tasks(&pf, PROF_ZONE_ANIM_TASK, tasks, numtasks);
                 begintime = endtime;
             }
+            prof_end(&pf, PROF_ZONE_ANIM);
             freecam_update(&cam, vw, vh, &mouse, winevents, numevents);
+            texstream_update(ts, TEXSTREAM_FRAME_BUDGET);
             // taa_mat44_transform_vec4(&cam.view, &o, &lightdir);
             taa_vec4_set(0.0f,0.0f,1.0f,0.0f,&lightdir);
             lightdir.w = 0.0f;
@@ -480,42 +774,229 @@ void play(
             glEnableClientState(GL_VERTEX_ARRAY);
             glEnableClientState(GL_NORMAL_ARRAY);
             glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-            for(i = 0; i < numskels; ++i)
+            // update the skeletons and node transforms of the instances
+            // whose animated nodes changed
+            prof_begin(&pf, PROF_ZONE_POSE);
+            numtasks = 0;
+            for(i = 0; i < numinstances; ++i)
             {
-                calc_joint_transforms(
-                    scene->skeletons + i,
-                    animnodes,
-                    skelmats[i]);
+                numtasks += instance_add_pose_tasks(
+                    instances + i,
+                    tasks + numtasks);
             }
-            for(i = 0; i < numnodes; ++i)
+            numjointtasks = numtasks;
+            for(i = 0; i < numinstances; ++i)
             {
-                taa_scenenode* node = scene->nodes + i;
-                if(node->type == taa_SCENENODE_REF_MESH)
+                numtasks += instance_add_xform_task(
+                    instances + i,
+                    tasks + numtasks);
+            }
+            taskpool_run(pool, tasks, numtasks);
+            taskpool_finish(pool);
+            prof_add_tasks(&pf, PROF_ZONE_JOINT_TASK, tasks, numjointtasks);
+            prof_add_tasks(
+                &pf,
+                PROF_ZONE_XFORM_TASK,
+                tasks + numjointtasks,
+                numtasks - numjointtasks);
+            prof_end(&pf, PROF_ZONE_POSE);
+            prof_begin(&pf, PROF_ZONE_CULL);
+            if(dl.numgroups > 0)
+            {
+                instdraw_update(&idraw, instances);
+            }
+            // bound the posed meshes, and find the nodes in view before
+            // anything is skinned or drawn
+            for(i = 0; i < numinstances; ++i)
+            {
+                instance_update_palettes(instances + i);
+            }
+            scenecull_update(&sc, instances);
+            scenecull_cull(&sc, &cam.view, &cam.proj, (int) vh);
+            select_levels(
+                scene,
+                &sc,
+                lods,
+                rmeshes,
+                numinstances,
+                nodelevels,
+                meshlevels);
+            prof_end(&pf, PROF_ZONE_CULL);
+            // start skinning the visible meshes whose skeleton pose has
+            // changed since they were last skinned, at their selected
+            // level. they are skinned into the next slot of the level's
+            // range, while the gpu may still be drawing the slots of
+            // previous frames. culled meshes keep their stale vertices
+            // until they come into view.
+            prof_begin(&pf, PROF_ZONE_SKIN_START);
+            streambuf_begin_frame(sb);
+            numtasks = 0;
+            for(i = 0; i < numinstances; ++i)
+            {
+                instance* inst = instances + i;
+                const uint8_t* levels = meshlevels + i*nummeshes;
+                instance_clear_dirty(inst);
+                for(j = 0; j < nummeshes; ++j)
                 {
-                    rendermesh* rmesh;
-                    taa_scenemesh* mesh;
-                    taa_mat44 modelmat;
-                    int meshid;
-                    int skelid;
-                    meshid = node->value.meshid;
-                    rmesh = rmeshes + meshid;
-                    mesh = scene->meshes + meshid;
-                    skelid = mesh->skeleton;
-                    if(skelid >= 0)
+                    const rendermesh* rmesh = rmeshes + j*MESHLOD_MAX_LEVELS;
+                    skinjob* job = inst->skinjobs + j;
+                    if(rmesh->skinned &&
+                       !rmesh->gpuskinned &&
+                       levels[j] != MESHLOD_CULLED)
                     {
-                        const taa_mat44* jointmats = skelmats[mesh->skeleton];
-                        skin_rendermesh(rmesh, mesh, jointmats);
+                        int range = (i*nummeshes + j)*MESHLOD_MAX_LEVELS;
+                        range += levels[j];
+                        if(job->smesh != &rmesh[levels[j]].skin)
+                        {
+                            // the range of the new level is out of date
+                            job->smesh = &rmesh[levels[j]].skin;
+                            job->version = -1;
+                        }
+                        if(instance_is_skin_stale(inst, j))
+                        {
+                            job->pndst = (pnvert*)
+                                streambuf_begin_write(sb, range);
+                        }
                     }
-                    taa_scenenode_calc_transform(animnodes, i, &modelmat);
-                    draw_rendermesh(
-                        scene,
-                        mesh,
-                        &cam.view,
-                        &modelmat,
-                        textures,
-                        rmesh);
                 }
+                numtasks += instance_add_skin_tasks(
+                    inst,
+                    sc.meshvisible + i*nummeshes,
+                    tasks + numtasks);
             }
+            taskpool_run(pool, tasks, numtasks);
+            prof_end(&pf, PROF_ZONE_SKIN_START);
+            prof_begin(&pf, PROF_ZONE_DRAW);
+            // the commands are sorted by texture, and each command is drawn
+            // for every instance, so each texture is bound once per frame
+            drawstate_reset(&ds);
+            lastinst = -1;
+            lastnode = -1;
+            for(c = 0; c < dl.numcmds; ++c)
+            {
+                const drawcmd* cmd = dl.cmds + c;
+                const meshlod* lod = lods + cmd->mesh;
+                rendermesh* rmeshlevels =
+                    rmeshes + cmd->mesh*MESHLOD_MAX_LEVELS;
+                drawcmd lcmd;
+                GLuint tex = 0;
+                // textures that have not been streamed in yet are drawn
+                // untextured
+                if(cmd->texture >= 0 && texstream_is_resident(ts,cmd->texture))
+                {
+                    tex = (GLuint) (size_t) texstream_get_texture(
+                        ts,
+                        cmd->texture);
+                }
+                drawstate_set_texture(&ds, tex);
+                if(cmd->group >= 0)
+                {
+                    // the model matrices of the group come from the
+                    // instance buffer, so only the view is loaded
+                    glLoadMatrixf(&cam.view.x.x);
+                    lastinst = -1;
+                    // each level draws the nodes that selected it
+                    for(k = 0; k < lod->numlevels; ++k)
+                    {
+                        rendermesh* rmesh = rmeshlevels + k;
+                        get_level_cmd(lod, k, cmd, &lcmd);
+                        drawstate_set_vertices(
+                            &ds,
+                            &ext,
+                            rmesh->pnvbo,
+                            0,
+                            rmesh->texvbo,
+                            rmesh->ibo,
+                            rmesh->vq);
+                        instdraw_draw(
+                            &idraw,
+                            &lcmd,
+                            rmesh->indextype,
+                            nodelevels,
+                            k);
+                    }
+                }
+                else
+                {
+                    for(j = 0; j < numinstances; ++j)
+                    {
+                        instance* inst = instances + j;
+                        int level = nodelevels[j*numnodes + cmd->node];
+                        GLuint pnvbo;
+                        size_t pnoffset;
+                        // culled nodes are neither skinned nor drawn
+                        if(level != MESHLOD_CULLED)
+                        {
+                            rendermesh* rmesh = rmeshlevels + level;
+                            int range = j*nummeshes + cmd->mesh;
+                            range = range*MESHLOD_MAX_LEVELS + level;
+                            get_level_cmd(lod, level, cmd, &lcmd);
+                            pnvbo = get_instance_vertices(
+                                pool,
+                                sb,
+                                inst,
+                                range,
+                                cmd->mesh,
+                                rmesh,
+                                &pnoffset);
+                            if(j != lastinst || cmd->node != lastnode)
+                            {
+                                taa_mat44 worldmat;
+                                taa_mat44 modelmat;
+                                taa_mat44 vmmat;
+                                taa_mat44_multiply(
+                                    &inst->gridmat,
+                                    inst->xforms.worldmats + cmd->node,
+                                    &worldmat);
+                                taa_mat44_multiply(
+                                    &worldmat,
+                                    meshmats + cmd->mesh,
+                                    &modelmat);
+                                taa_mat44_multiply(
+                                    &cam.view,
+                                    &modelmat,
+                                    &vmmat);
+                                glLoadMatrixf(&vmmat.x.x);
+                                lastinst = j;
+                                lastnode = cmd->node;
+                            }
+                            if(rmesh->gpuskinned)
+                            {
+                                gpuskin_begin(
+                                    gsptr,
+                                    inst->palettes[cmd->mesh],
+                                    rmesh->skin.numjoints,
+                                    rmesh->jwvbo);
+                            }
+                            drawstate_set_vertices(
+                                &ds,
+                                &ext,
+                                pnvbo,
+                                pnoffset,
+                                rmesh->texvbo,
+                                rmesh->ibo,
+                                rmesh->vq);
+                            glDrawElements(
+                                GL_TRIANGLES,
+                                lcmd.numindices,
+                                rmesh->indextype,
+                                (const GLvoid*) (size_t)
+                                    (lcmd.firstindex * rmesh->indexsize));
+                            if(rmesh->gpuskinned)
+                            {
+                                gpuskin_end(gsptr);
+                            }
+                        }
+                    }
+                }
+            }
+            taskpool_finish(pool);
+            prof_add_tasks(&pf, PROF_ZONE_SKIN_TASK, tasks, numtasks);
+            streambuf_end_frame(sb);
+            prof_end(&pf, PROF_ZONE_DRAW);
+            prof_begin(&pf, PROF_ZONE_OVERLAY);
+            ext.bindbuffer(GL_ARRAY_BUFFER, 0);
+            ext.bindbuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
             glDisable(GL_TEXTURE_2D);
             glDisable(GL_NORMALIZE);
             glDisableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -526,73 +1007,74 @@ void play(
             glDisable(GL_DEPTH_TEST);
             glDisable(GL_CULL_FACE);
             // draw skeletons
-            for(i = 0; i < numskels; ++i)
+            if(showskels)
             {
-                taa_sceneskel* skel = scene->skeletons + i;
-                taa_sceneskel_joint* jitr;
-                taa_mat44* jointmats;
-                taa_mat44* jointmatitr;
-                taa_mat44* jointmatend;
-                jointmats = skelmats[i];
-                jitr = skel->joints;
-                jointmatitr = jointmats;
-                jointmatend = jointmatitr + skel->numjoints;
-                // draw bone lines
                 glMatrixMode(GL_MODELVIEW);
                 glLoadMatrixf(&cam.view.x.x);
-                while(jointmatitr != jointmatend)
-                {
-                    if(jitr->parent >= 0)
-                    {
-                        glBegin(GL_LINES);
-                        glColor4f(1.0f,1.0f,1.0f,1.0f);
-                        glVertex3fv(&jointmatitr->w.x);
-                        glVertex3fv(&jointmats[jitr->parent].w.x);
-                        glEnd();
-                    }
-                    ++jointmatitr;
-                    ++jitr;
-                }
-                // draw joint axes
-                jointmatitr = jointmats;
-                jointmatend = jointmatitr + skel->numjoints;
-                while(jointmatitr != jointmatend)
+                dbglines_begin(&lines);
+                for(j = 0; j < numinstances; ++j)
                 {
-                    taa_mat44 vmmat;
-                    taa_mat44_multiply(&cam.view, jointmatitr, &vmmat);
-                    glLoadMatrixf(&vmmat.x.x);
-                    glBegin(GL_LINES);
-                    glColor4f(1.0f,0.0f,0.0f,1.0f);
-                    glVertex3f(0.0f,0.0f,0.0f);
-                    glVertex3f(1.0f,0.0f,0.0f);
-                    glColor4f(0.0f,1.0f,0.0f,1.0f);
-                    glVertex3f(0.0f,0.0f,0.0f);
-                    glVertex3f(0.0f,1.0f,0.0f);
-                    glColor4f(0.0f,0.0f,1.0f,1.0f);
-                    glVertex3f(0.0f,0.0f,0.0f);
-                    glVertex3f(0.0f,0.0f,1.0f);
-                    glEnd();
-                    ++jointmatitr;
+                    add_skeleton_lines(scene, instances + j, &lines);
                 }
+                dbglines_end(&lines);
             }
+            if(showprof)
+            {
+                glMatrixMode(GL_PROJECTION);
+                glLoadIdentity();
+                glOrtho(0.0, vw, 0.0, vh, -1.0, 1.0);
+                glMatrixMode(GL_MODELVIEW);
+                glLoadIdentity();
+                dbglines_begin(&graph);
+                add_profile_lines(&pf, &graph);
+                dbglines_end(&graph);
+            }
+            prof_end(&pf, PROF_ZONE_OVERLAY);
+            prof_begin(&pf, PROF_ZONE_SWAP);
             taa_glcontext_swap_buffers(rcdisplay, rcsurface);
+            prof_end(&pf, PROF_ZONE_SWAP);
+            prof_end(&pf, PROF_ZONE_FRAME);
+            prof_end_frame(&pf);
+            if(showprof && pf.numframes % PROF_HISTORY == 0)
+            {
+                prof_print_averages(&pf);
+            }
         }
     }
     // clean up
-    for(i = 0; i < numtextures; ++i)
+    taskpool_destroy(pool);
+    texstream_destroy(ts);
+    streambuf_destroy(sb);
+    scenecull_destroy(&sc);
+    dbglines_destroy(&graph);
+    dbglines_destroy(&lines);
+    prof_destroy(&pf);
+    if(dl.numgroups > 0)
     {
-        taa_texture2d_destroy(textures[i]);
+        instdraw_destroy(&idraw);
     }
-    for(i = 0; i < numskels; ++i)
+    drawlist_destroy(&dl);
+    if(gsptr != NULL)
+    {
+        gpuskin_destroy(gsptr);
+    }
+    for(i = 0; i < numinstances; ++i)
     {
-        taa_memalign_free(skelmats[i]);
+        instance_destroy(instances + i);
     }
     for(i = 0; i < nummeshes; ++i)
     {
-        destroy_rendermesh(rmeshes + i);
+        for(k = 0; k < lods[i].numlevels; ++k)
+        {
+            destroy_rendermesh(&ext, rmeshes + i*MESHLOD_MAX_LEVELS + k);
+        }
     }
-    taa_memalign_free(animnodes);
-    free(skelmats);
-    free(textures);
+    free(meshlevels);
+    free(nodelevels);
+    free(skinsizes);
+    free(instances);
+    free(tasks);
+    free(meshmats);
+    free(vquants);
     free(rmeshes);
 }
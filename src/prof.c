@@ -0,0 +1,247 @@
+#include "prof.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+//****************************************************************************
+// taa_timer_sample_cpu is not used because it is not reliable enough to
+// compare individual zones
+int64_t prof_sample_ns(void)
+{
+#ifdef WIN32
+    LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (int64_t) ((count.QuadPart * 1000000000.0) / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t) ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+//****************************************************************************
+const char* prof_get_zone_name(
+    int zone)
+{
+    static const char* const names[PROF_NUM_ZONES] =
+    {
+        "frame",
+        "anim",
+        "pose",
+        "cull",
+        "skin start",
+        "draw",
+        "overlay",
+        "swap",
+        "anim task",
+        "joint task",
+        "xform task",
+        "skin task"
+    };
+    return names[zone];
+}
+
+//****************************************************************************
+int prof_create(
+    const char* tracepath,
+    prof* p_out)
+{
+    int err = 0;
+    int i;
+    memset(p_out, 0, sizeof(*p_out));
+    for(i = 0; i < PROF_NUM_FRAME_ZONES; ++i)
+    {
+        p_out->open[i] = -1;
+    }
+    if(tracepath != NULL)
+    {
+        p_out->trace = fopen(tracepath, "w");
+        if(p_out->trace != NULL)
+        {
+            fputs("{\"traceEvents\":[\n", p_out->trace);
+        }
+        else
+        {
+            err = -1;
+        }
+    }
+    p_out->start = prof_sample_ns();
+    return err;
+}
+
+//****************************************************************************
+void prof_destroy(
+    prof* p)
+{
+    if(p->trace != NULL)
+    {
+        fputs("\n]}\n", p->trace);
+        fclose(p->trace);
+    }
+    free(p->taskevents);
+}
+
+//****************************************************************************
+void prof_begin(
+    prof* p,
+    int zone)
+{
+    if(p->enabled && p->numevents < PROF_MAX_EVENTS)
+    {
+        profevent* e = p->events + p->numevents;
+        e->zone = zone;
+        e->thread = 0;
+        e->begin = prof_sample_ns();
+        e->end = e->begin;
+        p->open[zone] = p->numevents;
+        ++p->numevents;
+    }
+}
+
+//****************************************************************************
+void prof_end(
+    prof* p,
+    int zone)
+{
+    if(p->enabled && p->open[zone] >= 0)
+    {
+        p->events[p->open[zone]].end = prof_sample_ns();
+        p->open[zone] = -1;
+    }
+}
+
+//****************************************************************************
+void prof_add_tasks(
+    prof* p,
+    int zone,
+    const taskpool_task* tasks,
+    int numtasks)
+{
+    if(p->enabled)
+    {
+        int i;
+        if(p->numtaskevents + numtasks > p->maxtaskevents)
+        {
+            p->maxtaskevents = (p->numtaskevents + numtasks) * 2;
+            p->taskevents = (profevent*) realloc(
+                p->taskevents,
+                p->maxtaskevents * sizeof(*p->taskevents));
+        }
+        for(i = 0; i < numtasks; ++i)
+        {
+            profevent* e = p->taskevents + p->numtaskevents + i;
+            e->zone = zone;
+            e->thread = tasks[i].thread;
+            e->begin = tasks[i].begintime;
+            e->end = tasks[i].endtime;
+        }
+        p->numtaskevents += numtasks;
+    }
+}
+
+//****************************************************************************
+// writes a complete event in microseconds, naming its thread in the trace
+// the first time it appears
+static void prof_trace_event(
+    prof* p,
+    const profevent* e)
+{
+    while(p->numnamed <= e->thread)
+    {
+        fprintf(
+            p->trace,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"tid\":%d,\"args\":{\"name\":\"",
+            (p->numtraced > 0) ? ",\n" : "",
+            p->numnamed + 1);
+        if(p->numnamed == 0)
+        {
+            fputs("render\"}}", p->trace);
+        }
+        else
+        {
+            fprintf(p->trace, "worker %d\"}}", p->numnamed);
+        }
+        ++p->numnamed;
+        ++p->numtraced;
+    }
+    fprintf(
+        p->trace,
+        "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+        "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+        (p->numtraced > 0) ? ",\n" : "",
+        prof_get_zone_name(e->zone),
+        e->thread + 1,
+        (e->begin - p->start) * 1.0e-3,
+        (e->end - e->begin) * 1.0e-3);
+    ++p->numtraced;
+}
+
+//****************************************************************************
+void prof_end_frame(
+    prof* p)
+{
+    if(p->numevents > 0)
+    {
+        int64_t* times = p->history[p->numframes % PROF_HISTORY];
+        int i;
+        memset(times, 0, sizeof(p->history[0]));
+        for(i = 0; i < p->numevents; ++i)
+        {
+            const profevent* e = p->events + i;
+            if(p->open[e->zone] != i)
+            {
+                times[e->zone] += e->end - e->begin;
+                if(p->trace != NULL)
+                {
+                    prof_trace_event(p, e);
+                }
+            }
+        }
+        for(i = 0; i < p->numtaskevents; ++i)
+        {
+            const profevent* e = p->taskevents + i;
+            times[e->zone] += e->end - e->begin;
+            if(p->trace != NULL)
+            {
+                prof_trace_event(p, e);
+            }
+        }
+        ++p->numframes;
+        p->numevents = 0;
+        for(i = 0; i < PROF_NUM_FRAME_ZONES; ++i)
+        {
+            p->open[i] = -1;
+        }
+    }
+    p->numtaskevents = 0;
+}
+
+//****************************************************************************
+void prof_print_averages(
+    const prof* p)
+{
+    int n = (p->numframes < PROF_HISTORY) ? p->numframes : PROF_HISTORY;
+    int i;
+    int j;
+    printf("average of %d frames:", n);
+    for(i = 0; i < PROF_NUM_ZONES; ++i)
+    {
+        int64_t sum = 0;
+        for(j = 0; j < n; ++j)
+        {
+            sum += p->history[j][i];
+        }
+        printf(
+            " %s %.2fms",
+            prof_get_zone_name(i),
+            (n > 0) ? sum * 1.0e-6 / n : 0.0);
+    }
+    printf("\n");
+}
@@ -0,0 +1,138 @@
+#ifndef PROF_H_
+#define PROF_H_
+
+#include "taskpool.h"
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct profevent_s profevent;
+typedef struct prof_s prof;
+
+enum
+{
+    // the zones of the render thread follow each other within the frame.
+    // the whole frame contains the others.
+    PROF_ZONE_FRAME,
+    // the batch of animation tasks
+    PROF_ZONE_ANIM,
+    // the batch of joint and node transform tasks
+    PROF_ZONE_POSE,
+    // palettes, bounds, culling, and level selection
+    PROF_ZONE_CULL,
+    // starting the skinning tasks
+    PROF_ZONE_SKIN_START,
+    // draw submission, including waits for the skinning of each mesh
+    PROF_ZONE_DRAW,
+    // skeletons and the profiler overlay
+    PROF_ZONE_OVERLAY,
+    PROF_ZONE_SWAP,
+    PROF_NUM_FRAME_ZONES,
+    // the zones of single tasks are recorded on the threads that ran them,
+    // and their history is the time summed over every thread
+    PROF_ZONE_ANIM_TASK = PROF_NUM_FRAME_ZONES,
+    PROF_ZONE_JOINT_TASK,
+    PROF_ZONE_XFORM_TASK,
+    PROF_ZONE_SKIN_TASK,
+    PROF_NUM_ZONES
+};
+
+enum
+{
+    // render thread zones recorded per frame. later ones are dropped.
+    PROF_MAX_EVENTS = 64,
+    // frames of zone times kept for the overlay and averages
+    PROF_HISTORY = 128
+};
+
+struct profevent_s
+{
+    int zone;
+    // taskpool thread index, where 0 is the render thread
+    int thread;
+    int64_t begin;
+    int64_t end;
+};
+
+// records the time of each zone of each frame. the render thread records
+// its own zones, and the task pool times each task on the thread that runs
+// it, which the render thread adds once the batch has completed. when it
+// is disabled, the zones cost one branch each.
+struct prof_s
+{
+    // set by the owner between frames
+    int enabled;
+    // chrome trace event file, or NULL
+    FILE* trace;
+    int numtraced;
+    // time of the first sample, which traces are relative to
+    int64_t start;
+    profevent events[PROF_MAX_EVENTS];
+    int numevents;
+    // event of each zone that has begun and not ended, or -1
+    int open[PROF_NUM_FRAME_ZONES];
+    // events of the tasks of the frame, from every thread
+    profevent* taskevents;
+    int numtaskevents;
+    int maxtaskevents;
+    // threads that have been named in the trace
+    int numnamed;
+    // nanoseconds spent in each zone in each of the last frames, indexed
+    // by frame % PROF_HISTORY
+    int64_t history[PROF_HISTORY][PROF_NUM_ZONES];
+    // number of frames recorded
+    int numframes;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// monotonic nanosecond clock
+int64_t prof_sample_ns(void);
+
+const char* prof_get_zone_name(
+    int zone);
+
+// if tracepath is not NULL, the zones of every enabled frame are written to
+// it in the chrome trace event format. returns nonzero if the file cannot
+// be created.
+int prof_create(
+    const char* tracepath,
+    prof* p_out);
+
+// finishes the trace file
+void prof_destroy(
+    prof* p);
+
+void prof_begin(
+    prof* p,
+    int zone);
+
+void prof_end(
+    prof* p,
+    int zone);
+
+// adds the tasks of a completed batch to the frame, each on the thread that
+// ran it. the tasks must have been timed by a pool using prof_sample_ns as
+// its clock.
+void prof_add_tasks(
+    prof* p,
+    int zone,
+    const taskpool_task* tasks,
+    int numtasks);
+
+// adds the zones of the frame to the trace and history, and starts the next
+// frame. zones that are still open are dropped.
+void prof_end_frame(
+    prof* p);
+
+// prints the average time of each zone over the recorded history
+void prof_print_averages(
+    const prof* p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROF_H_
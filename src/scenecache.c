@@ -0,0 +1,1165 @@
+#include "scenecache.h"
+#include "skin.h"
+#include <taa/filestream.h>
+#include <taa/scenefile.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+typedef struct scenecache_header_s scenecache_header;
+typedef struct scenecache_payload_s scenecache_payload;
+typedef struct scenecache_source_s scenecache_source;
+
+// the file starts with the header, followed by the scene serialized with
+// its large arrays emptied. the payload table follows the scene, and the
+// payloads themselves start at the next page boundary. the table has
+// numstreams entries followed by an index entry for each mesh, then an entry
+// holding the level count followed by an entry per level for each texture,
+// and then the same for the compressed copy of each texture. the next entry
+// holds the array of animation samplers, followed by the channels, the
+// keyframes, and the key data of each sampler. last, each mesh has an entry
+// holding the errors of its simplified levels, followed by the vertex map,
+// the indices, and the faces of each level.
+struct scenecache_header_s
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numpayloads;
+    // size and modification time of the source file, which are checked
+    // first, and a hash of its contents for when only the time differs
+    uint64_t srcsize;
+    uint64_t srcmtime;
+    uint64_t srchash;
+    uint64_t tableoffset;
+};
+
+struct scenecache_payload_s
+{
+    // file offset and size in bytes
+    uint64_t offset;
+    uint64_t size;
+    // number of elements
+    uint32_t count;
+    // dxt format of the level count entries of compressed textures
+    uint32_t format;
+};
+
+// the attributes of a source file that identify it without reading it. the
+// modification time is in nanoseconds, or in the 100 nanosecond units of a
+// FILETIME on windows, so a rewrite within the same second still differs.
+struct scenecache_source_s
+{
+    uint64_t size;
+    uint64_t mtime;
+};
+
+static const char scenecache_magic[8] = { 'T','S','V','C','A','C','H','E' };
+
+//****************************************************************************
+static uint64_t scenecache_align(
+    uint64_t offset,
+    uint64_t align)
+{
+    return (offset + align - 1) & ~(align - 1);
+}
+
+//****************************************************************************
+// size of a vertex in each stream made by skin_format_mesh
+static size_t scenecache_get_stride(
+    int stream)
+{
+    size_t stride = 0;
+    switch(stream)
+    {
+    case 0: stride = sizeof(pnvert); break;
+    case 1: stride = sizeof(tvert); break;
+    case 2: stride = sizeof(jwvert); break;
+    }
+    return stride;
+}
+
+//****************************************************************************
+static size_t scenecache_get_image_size(
+    const taa_scenetexture* tex,
+    uint32_t level)
+{
+    size_t w = tex->width >> level;
+    size_t h = tex->height >> level;
+    size_t bpp = 0;
+    switch(tex->format)
+    {
+    case taa_SCENETEXTURE_LUM8 : bpp = 1; break;
+    case taa_SCENETEXTURE_BGR8 : bpp = 3; break;
+    case taa_SCENETEXTURE_BGRA8: bpp = 4; break;
+    case taa_SCENETEXTURE_RGB8 : bpp = 3; break;
+    case taa_SCENETEXTURE_RGBA8: bpp = 4; break;
+    }
+    return ((w > 0) ? w : 1) * ((h > 0) ? h : 1) * bpp;
+}
+
+//****************************************************************************
+static int scenecache_count_payloads(
+    const taa_scene* scene,
+    const dxttexture* dxttextures,
+    int numsamplers,
+    const meshlod* lods)
+{
+    int n = 1 + numsamplers*3;
+    uint32_t i;
+    for(i = 0; i < scene->nummeshes; ++i)
+    {
+        n += scene->meshes[i].numstreams + 1;
+        n += 1 + (lods[i].numlevels - 1)*3;
+    }
+    for(i = 0; i < scene->numtextures; ++i)
+    {
+        n += scene->textures[i].numlevels + 1;
+        n += (dxttextures != NULL) ? dxttextures[i].numlevels + 1 : 1;
+    }
+    return n;
+}
+
+//****************************************************************************
+static void scenecache_set_fixup(
+    void** ptr,
+    uint32_t* count,
+    void* ptrvalue,
+    uint32_t countvalue,
+    scenecache_fixup* fixup_out)
+{
+    fixup_out->ptr = ptr;
+    fixup_out->count = count;
+    fixup_out->ptrvalue = *ptr;
+    fixup_out->countvalue = *count;
+    *ptr = ptrvalue;
+    *count = countvalue;
+}
+
+//****************************************************************************
+static void scenecache_restore(
+    const scenecache_fixup* fixups,
+    int numfixups)
+{
+    int i;
+    for(i = 0; i < numfixups; ++i)
+    {
+        *fixups[i].ptr = fixups[i].ptrvalue;
+        *fixups[i].count = fixups[i].countvalue;
+    }
+}
+
+//****************************************************************************
+// empties the large arrays of the scene so they are not serialized
+static int scenecache_detach(
+    taa_scene* scene,
+    scenecache_fixup* fixups)
+{
+    int n = 0;
+    uint32_t i;
+    uint32_t j;
+    for(i = 0; i < scene->nummeshes; ++i)
+    {
+        taa_scenemesh* mesh = scene->meshes + i;
+        for(j = 0; j < mesh->numstreams; ++j)
+        {
+            taa_scenemesh_stream* s = mesh->vertexstreams + j;
+            scenecache_set_fixup(
+                &s->buffer,
+                &s->numvertices,
+                NULL,
+                0,
+                fixups + n);
+            ++n;
+        }
+        scenecache_set_fixup(
+            (void**) &mesh->indices,
+            &mesh->numindices,
+            NULL,
+            0,
+            fixups + n);
+        ++n;
+    }
+    for(i = 0; i < scene->numtextures; ++i)
+    {
+        taa_scenetexture* tex = scene->textures + i;
+        scenecache_set_fixup(
+            (void**) &tex->images,
+            &tex->numlevels,
+            NULL,
+            0,
+            fixups + n);
+        ++n;
+    }
+    // the baked samplers replace the animations
+    scenecache_set_fixup(
+        (void**) &scene->animations,
+        &scene->numanimations,
+        NULL,
+        0,
+        fixups + n);
+    ++n;
+    return n;
+}
+
+//****************************************************************************
+// checks that the channels of a sampler read within its tracks and write
+// within the nodes
+static int scenecache_check_sampler(
+    const animsampler* sampler,
+    uint32_t numnodes)
+{
+    int numwords = (int) (numnodes * sizeof(taa_scenenode) / sizeof(float));
+    int err = 0;
+    int i;
+    for(i = 0; i < sampler->numchannels && err == 0; ++i)
+    {
+        const animchannel* ch = sampler->channels + i;
+        int isrot = (ch->type == ANIMCHANNEL_ROTATION);
+        int numcomps = isrot ? 4 : 1;
+        if((!isrot && ch->type != ANIMCHANNEL_SCALAR) ||
+           ch->offset < 0 ||
+           ch->offset > numwords - numcomps ||
+           ch->numkeys < 1 ||
+           ch->numkeys > sampler->numkeys ||
+           ch->firstkey < 0 ||
+           ch->firstkey > sampler->numkeys - ch->numkeys ||
+           ch->firstdata < 0 ||
+           ch->firstdata > sampler->numdata - ch->numkeys*(isrot ? 3 : 1))
+        {
+            err = -1;
+        }
+    }
+    return err;
+}
+
+//****************************************************************************
+// points the emptied arrays of the scene into the mapped file
+static int scenecache_attach(
+    taa_scene* scene,
+    const scenecache_payload* payloads,
+    int numpayloads,
+    scenecache* cache)
+{
+    char* map = (char*) cache->map;
+    const scenecache_payload* pitr = payloads;
+    const scenecache_payload* pend = payloads + numpayloads;
+    void** images = cache->images;
+    int err = 0;
+    uint32_t i;
+    uint32_t j;
+    // check the bounds and alignment of every payload before using them
+    while(pitr != pend && err == 0)
+    {
+        if(pitr->offset % SCENECACHE_PAYLOAD_ALIGN != 0 ||
+           pitr->offset > cache->mapsize ||
+           pitr->size > cache->mapsize - pitr->offset)
+        {
+            err = -1;
+        }
+        ++pitr;
+    }
+    pitr = payloads;
+    for(i = 0; i < scene->nummeshes && err == 0; ++i)
+    {
+        taa_scenemesh* mesh = scene->meshes + i;
+        if((uint32_t) (pend - pitr) < mesh->numstreams + 1)
+        {
+            err = -1;
+            break;
+        }
+        for(j = 0; j < mesh->numstreams && err == 0; ++j)
+        {
+            if(pitr->size != pitr->count * scenecache_get_stride(j))
+            {
+                err = -1;
+                break;
+            }
+            scenecache_set_fixup(
+                &mesh->vertexstreams[j].buffer,
+                &mesh->vertexstreams[j].numvertices,
+                map + pitr->offset,
+                pitr->count,
+                cache->fixups + cache->numfixups);
+            ++cache->numfixups;
+            ++pitr;
+        }
+        if(err == 0 && pitr->size == pitr->count * sizeof(*mesh->indices))
+        {
+            scenecache_set_fixup(
+                (void**) &mesh->indices,
+                &mesh->numindices,
+                map + pitr->offset,
+                pitr->count,
+                cache->fixups + cache->numfixups);
+            ++cache->numfixups;
+            ++pitr;
+        }
+        else
+        {
+            err = -1;
+        }
+    }
+    for(i = 0; i < scene->numtextures && err == 0; ++i)
+    {
+        taa_scenetexture* tex = scene->textures + i;
+        uint32_t numlevels = (pitr != pend) ? pitr->count : 0;
+        if(pitr == pend || numlevels > (uint32_t) (pend - pitr - 1))
+        {
+            err = -1;
+            break;
+        }
+        ++pitr;
+        for(j = 0; j < numlevels; ++j)
+        {
+            if(pitr->size != scenecache_get_image_size(tex, j))
+            {
+                err = -1;
+                break;
+            }
+            images[j] = map + pitr->offset;
+            ++pitr;
+        }
+        if(err == 0)
+        {
+            scenecache_set_fixup(
+                (void**) &tex->images,
+                &tex->numlevels,
+                images,
+                numlevels,
+                cache->fixups + cache->numfixups);
+            ++cache->numfixups;
+            images += numlevels;
+        }
+    }
+    for(i = 0; i < scene->numtextures && err == 0; ++i)
+    {
+        const taa_scenetexture* tex = scene->textures + i;
+        dxttexture* dxt = cache->dxttextures + i;
+        uint32_t numlevels = (pitr != pend) ? pitr->count : 0;
+        if(pitr == pend || numlevels > (uint32_t) (pend - pitr - 1))
+        {
+            err = -1;
+            break;
+        }
+        dxt->format = pitr->format;
+        dxt->numlevels = numlevels;
+        dxt->levels = (dxtlevel*) calloc(numlevels+1, sizeof(*dxt->levels));
+        ++pitr;
+        for(j = 0; j < numlevels; ++j)
+        {
+            // the uncompressed source is not needed once the level has been
+            // compressed
+            dxtlevel* level = dxt->levels + j;
+            uint32_t w = tex->width >> j;
+            uint32_t h = tex->height >> j;
+            level->src = NULL;
+            level->srcformat = tex->format;
+            level->width = (w > 0) ? w : 1;
+            level->height = (h > 0) ? h : 1;
+            level->dst = map + pitr->offset;
+            level->size = (size_t) pitr->size;
+            if(level->size != dxt_get_level_size(
+                dxt->format,
+                level->width,
+                level->height))
+            {
+                err = -1;
+                break;
+            }
+            ++pitr;
+        }
+    }
+    if(err == 0)
+    {
+        uint32_t numsamplers = (pitr != pend) ? pitr->count : 0;
+        if(pitr == pend ||
+           numsamplers > (uint32_t) (pend - pitr - 1) / 3 ||
+           pitr->size != numsamplers * sizeof(*cache->samplers))
+        {
+            err = -1;
+        }
+        else
+        {
+            cache->samplers = (animsampler*) malloc(
+                (numsamplers + 1) * sizeof(*cache->samplers));
+            cache->numsamplers = numsamplers;
+            memcpy(cache->samplers, map + pitr->offset, (size_t) pitr->size);
+            ++pitr;
+        }
+        for(i = 0; i < numsamplers && err == 0; ++i)
+        {
+            animsampler* sampler = cache->samplers + i;
+            if(pitr[0].count != (uint32_t) sampler->numchannels ||
+               pitr[0].size != pitr[0].count * sizeof(*sampler->channels) ||
+               pitr[1].count != (uint32_t) sampler->numkeys ||
+               pitr[1].size != pitr[1].count * sizeof(*sampler->keyframes) ||
+               pitr[2].count != (uint32_t) sampler->numdata ||
+               pitr[2].size != pitr[2].count * sizeof(*sampler->keydata))
+            {
+                err = -1;
+                break;
+            }
+            sampler->channels = (animchannel*) (map + pitr[0].offset);
+            sampler->keyframes = (uint32_t*) (map + pitr[1].offset);
+            sampler->keydata = (uint16_t*) (map + pitr[2].offset);
+            err = scenecache_check_sampler(sampler, scene->numnodes);
+            pitr += 3;
+        }
+    }
+    if(err == 0)
+    {
+        cache->lodlevels = (meshlod_level*) calloc(
+            scene->nummeshes*MESHLOD_MAX_LEVELS + 1,
+            sizeof(*cache->lodlevels));
+        cache->numlodlevels = (int*) calloc(
+            scene->nummeshes + 1,
+            sizeof(*cache->numlodlevels));
+    }
+    for(i = 0; i < scene->nummeshes && err == 0; ++i)
+    {
+        // the contents of the levels are checked by meshlod_load
+        meshlod_level* levels = cache->lodlevels + i*MESHLOD_MAX_LEVELS;
+        uint32_t numlevels = (pitr != pend) ? pitr->count : 0;
+        const float* errors;
+        if(pitr == pend ||
+           numlevels >= MESHLOD_MAX_LEVELS ||
+           numlevels > (uint32_t) (pend - pitr - 1) / 3 ||
+           pitr->size != numlevels * sizeof(*errors))
+        {
+            err = -1;
+            break;
+        }
+        errors = (const float*) (map + pitr->offset);
+        ++pitr;
+        for(j = 0; j < numlevels; ++j)
+        {
+            meshlod_level* level = levels + j;
+            if(pitr[0].size != pitr[0].count * sizeof(*level->vertmap) ||
+               pitr[1].size != pitr[1].count * sizeof(*level->indices) ||
+               pitr[2].size != pitr[2].count * sizeof(*level->faces))
+            {
+                err = -1;
+                break;
+            }
+            level->vertmap = (const int32_t*) (map + pitr[0].offset);
+            level->numvertices = pitr[0].count;
+            level->indices = (const int32_t*) (map + pitr[1].offset);
+            level->numindices = pitr[1].count;
+            level->faces = (const taa_scenemesh_face*) (map + pitr[2].offset);
+            level->numfaces = pitr[2].count;
+            level->error = errors[j];
+            pitr += 3;
+        }
+        cache->numlodlevels[i] = numlevels;
+    }
+    if(err == 0 && pitr != pend)
+    {
+        err = -1;
+    }
+    return err;
+}
+
+//****************************************************************************
+static void* scenecache_map(
+    const char* path,
+    size_t* size_out)
+{
+    void* map = NULL;
+    size_t size = 0;
+#ifdef WIN32
+    // the view keeps the file and the mapping object open after their
+    // handles are closed
+    HANDLE file = CreateFileA(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL);
+    if(file != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER filesize;
+        if(GetFileSizeEx(file, &filesize) && filesize.QuadPart > 0)
+        {
+            HANDLE mapping = CreateFileMappingA(
+                file,
+                NULL,
+                PAGE_WRITECOPY,
+                0,
+                0,
+                NULL);
+            if(mapping != NULL)
+            {
+                // copy on write, so the file is never modified
+                map = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+                size = (size_t) filesize.QuadPart;
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if(fd >= 0)
+    {
+        struct stat st;
+        if(fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            // private mapping, so the file is never modified
+            map = mmap(
+                NULL,
+                st.st_size,
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE,
+                fd,
+                0);
+            size = st.st_size;
+            if(map == MAP_FAILED)
+            {
+                map = NULL;
+            }
+        }
+        close(fd);
+    }
+#endif
+    *size_out = (map != NULL) ? size : 0;
+    return map;
+}
+
+//****************************************************************************
+static void scenecache_unmap(
+    void* map,
+    size_t size)
+{
+#ifdef WIN32
+    UnmapViewOfFile(map);
+#else
+    munmap(map, size);
+#endif
+}
+
+//****************************************************************************
+// drops the whole pages within the range from the resident set. they are
+// read from the file again if they are ever touched.
+static void scenecache_discard(
+    void* ptr,
+    size_t size)
+{
+#ifdef WIN32
+    // unlocking pages that are not locked removes them from the working set
+    VirtualUnlock(ptr, size);
+#else
+    uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+    uintptr_t first = ((uintptr_t) ptr + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t) ptr + size) & ~(page - 1);
+    if(first < end)
+    {
+        madvise((void*) first, end - first, MADV_DONTNEED);
+    }
+#endif
+}
+
+//****************************************************************************
+// returns the new file position
+static uint64_t scenecache_write_padding(
+    FILE* fp,
+    uint64_t pos,
+    uint64_t end)
+{
+    while(pos < end)
+    {
+        fputc(0, fp);
+        ++pos;
+    }
+    return pos;
+}
+
+//****************************************************************************
+static int scenecache_stat_source(
+    const char* path,
+    scenecache_source* src_out)
+{
+    int err = 0;
+#ifdef WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attribs;
+    if(GetFileAttributesExA(path, GetFileExInfoStandard, &attribs))
+    {
+        src_out->size = attribs.nFileSizeLow;
+        src_out->size |= ((uint64_t) attribs.nFileSizeHigh) << 32;
+        src_out->mtime = attribs.ftLastWriteTime.dwLowDateTime;
+        src_out->mtime |=
+            ((uint64_t) attribs.ftLastWriteTime.dwHighDateTime) << 32;
+    }
+    else
+    {
+        err = -1;
+    }
+#else
+    struct stat st;
+    if(stat(path, &st) == 0)
+    {
+        src_out->size = (uint64_t) st.st_size;
+        src_out->mtime = ((uint64_t) st.st_mtim.tv_sec) * 1000000000;
+        src_out->mtime += (uint64_t) st.st_mtim.tv_nsec;
+    }
+    else
+    {
+        err = -1;
+    }
+#endif
+    return err;
+}
+
+//****************************************************************************
+static uint64_t scenecache_mix(
+    uint64_t hash,
+    uint64_t word)
+{
+    hash ^= word * 0x9e3779b97f4a7c15ULL;
+    hash = (hash << 31) | (hash >> 33);
+    return hash * 0xc2b2ae3d27d4eb4fULL;
+}
+
+//****************************************************************************
+// hashes the contents of a file 8 bytes at a time, spread over 4 lanes so
+// the multiplies of consecutive words do not wait on each other. returns 0
+// if the file can not be read.
+static uint64_t scenecache_hash_source(
+    const char* path)
+{
+    enum { BUF_WORDS = 128 * 1024 };
+    uint64_t lanes[4] = { 1, 2, 3, 4 };
+    uint64_t hash = 0;
+    uint64_t size = 0;
+    FILE* fp = fopen(path, "rb");
+    if(fp != NULL)
+    {
+        uint64_t* buf = (uint64_t*) malloc(BUF_WORDS * sizeof(*buf));
+        size_t n;
+        int i;
+        while((n = fread(buf, 1, BUF_WORDS * sizeof(*buf), fp)) > 0)
+        {
+            size_t numwords = (n + sizeof(*buf) - 1) / sizeof(*buf);
+            size_t j;
+            // zero the rest of a partial last word
+            memset(((char*) buf) + n, 0, numwords*sizeof(*buf) - n);
+            for(j = 0; j + 4 <= numwords; j += 4)
+            {
+                lanes[0] = scenecache_mix(lanes[0], buf[j    ]);
+                lanes[1] = scenecache_mix(lanes[1], buf[j + 1]);
+                lanes[2] = scenecache_mix(lanes[2], buf[j + 2]);
+                lanes[3] = scenecache_mix(lanes[3], buf[j + 3]);
+            }
+            while(j < numwords)
+            {
+                lanes[0] = scenecache_mix(lanes[0], buf[j]);
+                ++j;
+            }
+            size += n;
+        }
+        hash = scenecache_mix(size, lanes[0]);
+        for(i = 1; i < 4; ++i)
+        {
+            hash = scenecache_mix(hash, lanes[i]);
+        }
+        free(buf);
+        fclose(fp);
+    }
+    return hash;
+}
+
+//****************************************************************************
+int scenecache_load(
+    const char* cachepath,
+    const char* srcpath,
+    taa_scene* scene,
+    scenecache* cache_out)
+{
+    int err = 0;
+    const scenecache_header* header = NULL;
+    const scenecache_payload* payloads = NULL;
+    scenecache_source src;
+    FILE* fp = NULL;
+
+    memset(cache_out, 0, sizeof(*cache_out));
+    err = scenecache_stat_source(srcpath, &src);
+    if(err == 0)
+    {
+        cache_out->map = scenecache_map(cachepath, &cache_out->mapsize);
+    }
+    if(cache_out->map == NULL || cache_out->mapsize < sizeof(*header))
+    {
+        err = -1;
+    }
+    if(err == 0)
+    {
+        header = (const scenecache_header*) cache_out->map;
+        if(memcmp(header->magic, scenecache_magic, sizeof(header->magic)))
+        {
+            err = -1;
+        }
+        else if(header->version != SCENECACHE_VERSION)
+        {
+            err = -1;
+        }
+        else if(header->srcsize != src.size)
+        {
+            err = -1;
+        }
+        else if(header->srcmtime != src.mtime &&
+                header->srchash != scenecache_hash_source(srcpath))
+        {
+            // the source was touched or copied, and its contents changed
+            err = -1;
+        }
+        else if(header->tableoffset % sizeof(uint64_t) != 0 ||
+                header->tableoffset > cache_out->mapsize ||
+                header->numpayloads >
+                    (cache_out->mapsize - header->tableoffset) /
+                    sizeof(*payloads))
+        {
+            err = -1;
+        }
+    }
+    if(err == 0)
+    {
+        // only the emptied scene is read through the file stream
+        fp = fopen(cachepath, "rb");
+        err = (fp != NULL) ? 0 : -1;
+    }
+    if(err == 0)
+    {
+        taa_filestream infs;
+        fseek(fp, sizeof(*header), SEEK_SET);
+        taa_filestream_create(fp, 64 * 1024, taa_FILESTREAM_READ, &infs);
+        err = taa_scenefile_deserialize(&infs, scene);
+        taa_filestream_destroy(&infs);
+    }
+    if(err == 0)
+    {
+        int n = header->numpayloads;
+        payloads = (const scenecache_payload*) (
+            ((const char*) cache_out->map) + header->tableoffset);
+        cache_out->images = (void**) malloc((n + 1)*sizeof(void*));
+        cache_out->fixups = (scenecache_fixup*) malloc(
+            (n + 1)*sizeof(*cache_out->fixups));
+        cache_out->dxttextures = (dxttexture*) calloc(
+            scene->numtextures + 1,
+            sizeof(*cache_out->dxttextures));
+        cache_out->numdxttextures = scene->numtextures;
+        err = scenecache_attach(scene, payloads, n, cache_out);
+    }
+    if(fp != NULL)
+    {
+        fclose(fp);
+    }
+    if(err != 0)
+    {
+        scenecache_unload(cache_out);
+    }
+    return err;
+}
+
+//****************************************************************************
+void scenecache_unload(
+    scenecache* cache)
+{
+    scenecache_restore(cache->fixups, cache->numfixups);
+    if(cache->map != NULL)
+    {
+        scenecache_unmap(cache->map, cache->mapsize);
+    }
+    if(cache->dxttextures != NULL)
+    {
+        // the levels point into the mapping, so only the arrays are freed
+        dxttexture* itr = cache->dxttextures;
+        dxttexture* end = itr + cache->numdxttextures;
+        while(itr != end)
+        {
+            dxt_destroy_texture(itr);
+            ++itr;
+        }
+    }
+    free(cache->dxttextures);
+    // the tracks of the samplers and the arrays of the levels point into the
+    // mapping
+    free(cache->samplers);
+    free(cache->numlodlevels);
+    free(cache->lodlevels);
+    free(cache->fixups);
+    free(cache->images);
+    memset(cache, 0, sizeof(*cache));
+}
+
+//****************************************************************************
+void scenecache_release_stream(
+    scenecache* cache,
+    taa_scenemesh* mesh,
+    int stream)
+{
+    taa_scenemesh_stream* s = mesh->vertexstreams + stream;
+    char* buf = (char*) s->buffer;
+    char* map = (char*) ((cache != NULL) ? cache->map : NULL);
+    if(map != NULL && buf >= map && buf < map + cache->mapsize)
+    {
+        // the fixup restores the pointer from before the mapping on unload
+        scenecache_discard(buf, s->numvertices*scenecache_get_stride(stream));
+    }
+    else
+    {
+        free(buf);
+    }
+    s->buffer = NULL;
+}
+
+//****************************************************************************
+// returns a path next to the cache that no other process writes to, which
+// the caller must free
+static char* scenecache_get_temp_path(
+    const char* cachepath)
+{
+    size_t len = strlen(cachepath);
+    char* path = (char*) malloc(len + 32);
+#ifdef WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long) getpid();
+#endif
+    sprintf(path, "%s.%lu.tmp", cachepath, pid);
+    return path;
+}
+
+//****************************************************************************
+// closes the file once its contents are on disk
+static int scenecache_close_synced(
+    FILE* fp)
+{
+    int err = 0;
+    if(fflush(fp) != 0)
+    {
+        err = -1;
+    }
+#ifdef WIN32
+    if(err == 0 && _commit(_fileno(fp)) != 0)
+    {
+        err = -1;
+    }
+#else
+    if(err == 0 && fsync(fileno(fp)) != 0)
+    {
+        err = -1;
+    }
+#endif
+    if(fclose(fp) != 0)
+    {
+        err = -1;
+    }
+    return err;
+}
+
+//****************************************************************************
+// atomically moves the file at srcpath over dstpath. processes that have
+// the old file mapped keep reading it until they unmap it.
+static int scenecache_replace(
+    const char* srcpath,
+    const char* dstpath)
+{
+    int err = 0;
+#ifdef WIN32
+    if(!MoveFileExA(srcpath, dstpath, MOVEFILE_REPLACE_EXISTING))
+    {
+        err = -1;
+    }
+#else
+    if(rename(srcpath, dstpath) != 0)
+    {
+        err = -1;
+    }
+#endif
+    return err;
+}
+
+//****************************************************************************
+int scenecache_save(
+    const char* cachepath,
+    const char* srcpath,
+    taa_scene* scene,
+    const dxttexture* dxttextures,
+    const animsampler* samplers,
+    int numsamplers,
+    const meshlod* lods)
+{
+    int err = 0;
+    int numpayloads = scenecache_count_payloads(
+        scene,
+        dxttextures,
+        numsamplers,
+        lods);
+    scenecache_payload* payloads;
+    const void** srcs;
+    scenecache_fixup* fixups;
+    scenecache_header header;
+    scenecache_source src;
+    uint64_t srchash = 0;
+    uint64_t offset = 0;
+    uint64_t pos = 0;
+    char* tmppath = scenecache_get_temp_path(cachepath);
+    FILE* fp = NULL;
+
+    payloads = (scenecache_payload*) calloc(
+        numpayloads + 1,
+        sizeof(*payloads));
+    srcs = (const void**) calloc(numpayloads + 1, sizeof(*srcs));
+    fixups = (scenecache_fixup*) malloc((numpayloads+1)*sizeof(*fixups));
+    memset(&header, 0, sizeof(header));
+    err = scenecache_stat_source(srcpath, &src);
+    if(err == 0)
+    {
+        srchash = scenecache_hash_source(srcpath);
+        // the cache is written to a file of its own and moved over the old
+        // one when complete, so processes that have the old one mapped are
+        // not cut off, and a partial file is never taken for a valid cache
+        fp = fopen(tmppath, "wb");
+        err = (fp != NULL) ? 0 : -1;
+    }
+    if(err == 0)
+    {
+        // the header is left empty until everything else has been written
+        if(fwrite(&header, sizeof(header), 1, fp) != 1)
+        {
+            err = -1;
+        }
+    }
+    if(err == 0)
+    {
+        taa_filestream outfs;
+        int numfixups = scenecache_detach(scene, fixups);
+        taa_filestream_create(fp, 1024 * 1024, taa_FILESTREAM_WRITE, &outfs);
+        err = taa_scenefile_serialize(scene, &outfs);
+        taa_filestream_destroy(&outfs);
+        scenecache_restore(fixups, numfixups);
+    }
+    if(err == 0)
+    {
+        scenecache_payload* pitr = payloads;
+        const void** sitr = srcs;
+        uint32_t i;
+        uint32_t j;
+        // the file position is tracked from here on, since ftell can not
+        // report offsets past 2GB on every platform
+        pos = ftell(fp);
+        header.tableoffset = scenecache_align(pos, sizeof(uint64_t));
+        offset = header.tableoffset + numpayloads*sizeof(*payloads);
+        offset = scenecache_align(offset, SCENECACHE_PAGE_ALIGN);
+        for(i = 0; i < scene->nummeshes; ++i)
+        {
+            const taa_scenemesh* mesh = scene->meshes + i;
+            for(j = 0; j < mesh->numstreams; ++j)
+            {
+                const taa_scenemesh_stream* s = mesh->vertexstreams + j;
+                pitr->offset = offset;
+                pitr->size = s->numvertices * scenecache_get_stride(j);
+                pitr->count = s->numvertices;
+                *sitr = s->buffer;
+                offset += pitr->size;
+                offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+                ++pitr;
+                ++sitr;
+            }
+            pitr->offset = offset;
+            pitr->size = mesh->numindices * sizeof(*mesh->indices);
+            pitr->count = mesh->numindices;
+            *sitr = mesh->indices;
+            offset += pitr->size;
+            offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+            ++pitr;
+            ++sitr;
+        }
+        for(i = 0; i < scene->numtextures; ++i)
+        {
+            const taa_scenetexture* tex = scene->textures + i;
+            pitr->count = tex->numlevels;
+            ++pitr;
+            ++sitr;
+            for(j = 0; j < tex->numlevels; ++j)
+            {
+                pitr->offset = offset;
+                pitr->size = scenecache_get_image_size(tex, j);
+                *sitr = tex->images[j];
+                offset += pitr->size;
+                offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+                ++pitr;
+                ++sitr;
+            }
+        }
+        for(i = 0; i < scene->numtextures; ++i)
+        {
+            const dxttexture* dxt = NULL;
+            if(dxttextures != NULL)
+            {
+                dxt = dxttextures + i;
+                pitr->format = dxt->format;
+                pitr->count = dxt->numlevels;
+            }
+            ++pitr;
+            ++sitr;
+            for(j = 0; dxt != NULL && j < dxt->numlevels; ++j)
+            {
+                pitr->offset = offset;
+                pitr->size = dxt->levels[j].size;
+                *sitr = dxt->levels[j].dst;
+                offset += pitr->size;
+                offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+                ++pitr;
+                ++sitr;
+            }
+        }
+        pitr->offset = offset;
+        pitr->size = numsamplers * sizeof(*samplers);
+        pitr->count = numsamplers;
+        *sitr = samplers;
+        offset += pitr->size;
+        offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+        ++pitr;
+        ++sitr;
+        for(i = 0; i < (uint32_t) numsamplers; ++i)
+        {
+            const animsampler* sampler = samplers + i;
+            pitr->offset = offset;
+            pitr->size = sampler->numchannels * sizeof(*sampler->channels);
+            pitr->count = sampler->numchannels;
+            *sitr = sampler->channels;
+            offset += pitr->size;
+            offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+            ++pitr;
+            ++sitr;
+            pitr->offset = offset;
+            pitr->size = sampler->numkeys * sizeof(*sampler->keyframes);
+            pitr->count = sampler->numkeys;
+            *sitr = sampler->keyframes;
+            offset += pitr->size;
+            offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+            ++pitr;
+            ++sitr;
+            pitr->offset = offset;
+            pitr->size = sampler->numdata * sizeof(*sampler->keydata);
+            pitr->count = sampler->numdata;
+            *sitr = sampler->keydata;
+            offset += pitr->size;
+            offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+            ++pitr;
+            ++sitr;
+        }
+        for(i = 0; i < scene->nummeshes; ++i)
+        {
+            const meshlod* lod = lods + i;
+            pitr->offset = offset;
+            pitr->size = (lod->numlevels - 1) * sizeof(*lod->errors);
+            pitr->count = lod->numlevels - 1;
+            *sitr = lod->errors + 1;
+            offset += pitr->size;
+            offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+            ++pitr;
+            ++sitr;
+            for(j = 1; j < (uint32_t) lod->numlevels; ++j)
+            {
+                meshlod_level level;
+                meshlod_get_level(lod, j, &level);
+                pitr->offset = offset;
+                pitr->size = level.numvertices * sizeof(*level.vertmap);
+                pitr->count = level.numvertices;
+                *sitr = level.vertmap;
+                offset += pitr->size;
+                offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+                ++pitr;
+                ++sitr;
+                pitr->offset = offset;
+                pitr->size = level.numindices * sizeof(*level.indices);
+                pitr->count = level.numindices;
+                *sitr = level.indices;
+                offset += pitr->size;
+                offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+                ++pitr;
+                ++sitr;
+                pitr->offset = offset;
+                pitr->size = level.numfaces * sizeof(*level.faces);
+                pitr->count = level.numfaces;
+                *sitr = level.faces;
+                offset += pitr->size;
+                offset = scenecache_align(offset, SCENECACHE_PAYLOAD_ALIGN);
+                ++pitr;
+                ++sitr;
+            }
+        }
+        pos = scenecache_write_padding(fp, pos, header.tableoffset);
+        if(numpayloads > 0 &&
+           fwrite(payloads, sizeof(*payloads), numpayloads, fp) !=
+               (size_t) numpayloads)
+        {
+            err = -1;
+        }
+        pos += numpayloads*sizeof(*payloads);
+    }
+    if(err == 0)
+    {
+        int i;
+        for(i = 0; i < numpayloads && err == 0; ++i)
+        {
+            if(payloads[i].size > 0)
+            {
+                pos = scenecache_write_padding(fp, pos, payloads[i].offset);
+                if(fwrite(srcs[i], (size_t) payloads[i].size, 1, fp) != 1)
+                {
+                    err = -1;
+                }
+                pos += payloads[i].size;
+            }
+        }
+        // pad the end so the last payload can be read in aligned blocks
+        scenecache_write_padding(fp, pos, offset);
+    }
+    if(err == 0)
+    {
+        memcpy(header.magic, scenecache_magic, sizeof(header.magic));
+        header.version = SCENECACHE_VERSION;
+        header.numpayloads = numpayloads;
+        header.srcsize = src.size;
+        header.srcmtime = src.mtime;
+        header.srchash = srchash;
+        fseek(fp, 0, SEEK_SET);
+        if(fwrite(&header, sizeof(header), 1, fp) != 1)
+        {
+            err = -1;
+        }
+    }
+    if(fp != NULL)
+    {
+        if(scenecache_close_synced(fp) != 0)
+        {
+            err = -1;
+        }
+        if(err == 0)
+        {
+            err = scenecache_replace(tmppath, cachepath);
+        }
+        if(err != 0)
+        {
+            remove(tmppath);
+        }
+    }
+    free(tmppath);
+    free(fixups);
+    free(srcs);
+    free(payloads);
+    return err;
+}
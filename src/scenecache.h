@@ -0,0 +1,113 @@
+#ifndef SCENECACHE_H_
+#define SCENECACHE_H_
+
+#include "animsampler.h"
+#include "dxt.h"
+#include "meshlod.h"
+#include <taa/scene.h>
+
+enum
+{
+    // must be incremented whenever the cache layout or the way the viewer
+    // prepares meshes, textures, or animations changes, so that stale caches
+    // are rebuilt
+    SCENECACHE_VERSION = 9,
+    // alignment of the vertex, index, and image payloads in the file, and
+    // therefore in memory once the file is mapped
+    SCENECACHE_PAYLOAD_ALIGN = 64,
+    // alignment of the start of the payload section
+    SCENECACHE_PAGE_ALIGN = 4096
+};
+
+typedef struct scenecache_fixup_s scenecache_fixup;
+typedef struct scenecache_s scenecache;
+
+// scene array that was pointed into the mapped file
+struct scenecache_fixup_s
+{
+    void** ptr;
+    uint32_t* count;
+    // values from before the array was pointed into the file
+    void* ptrvalue;
+    uint32_t countvalue;
+};
+
+// a mapped cache file. the large arrays of the scene point directly into
+// the mapping, so they are paged in on demand and the pages are shared by
+// every process that views the same file.
+struct scenecache_s
+{
+    void* map;
+    size_t mapsize;
+    // image pointers of all texture levels
+    void** images;
+    scenecache_fixup* fixups;
+    int numfixups;
+    // compressed copy of each texture of the scene, with the levels in the
+    // mapping. the format is DXT_NONE if the texture was not compressed.
+    dxttexture* dxttextures;
+    int numdxttextures;
+    // baked copy of each animation of the scene, with the tracks in the
+    // mapping. the scene itself is loaded without its animations.
+    animsampler* samplers;
+    int numsamplers;
+    // simplified levels of each mesh in the form meshlod_load takes them,
+    // with the arrays in the mapping. each mesh has MESHLOD_MAX_LEVELS
+    // entries, of which the first numlodlevels are used.
+    meshlod_level* lodlevels;
+    int* numlodlevels;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// maps a cache and loads a scene whose vertex streams, indices, and texture
+// images point into the mapping. returns 0 on success, or -1 if the cache
+// does not exist, was written by a different viewer version, or was made
+// from a different source file. the source file is only compared by its
+// size and modification time, unless the time differs while the size does
+// not, in which case its contents are hashed. scenecache_unload must be
+// called before the scene is destroyed.
+int scenecache_load(
+    const char* cachepath,
+    const char* srcpath,
+    taa_scene* scene,
+    scenecache* cache_out);
+
+// returns the arrays of the scene to their unmapped state and unmaps the file
+void scenecache_unload(
+    scenecache* cache);
+
+// releases a vertex stream of a formatted mesh once nothing reads it
+// anymore, and sets its buffer to NULL. cache is the cache the scene was
+// loaded from, or NULL. a stream in the mapping has its pages dropped from
+// the resident set, and other streams are freed.
+void scenecache_release_stream(
+    scenecache* cache,
+    taa_scenemesh* mesh,
+    int stream);
+
+// the scene is modified while it is written, but is restored before the
+// function returns. dxttextures may be NULL if the textures have not been
+// compressed. the animations of the scene are not written, the samplers
+// baked from them are written instead. lods holds the levels of detail of
+// each mesh. the source file is hashed once, to recognize it later if it
+// is touched without being changed. the cache is written next to cachepath
+// and then moved over it, so an existing cache stays valid for processes
+// that have it mapped, and is left as it was if the save fails.
+int scenecache_save(
+    const char* cachepath,
+    const char* srcpath,
+    taa_scene* scene,
+    const dxttexture* dxttextures,
+    const animsampler* samplers,
+    int numsamplers,
+    const meshlod* lods);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCENECACHE_H_
@@ -0,0 +1,258 @@
+#include "scenecull.h"
+#include <taa/mat44.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//****************************************************************************
+void scenecull_create(
+    const taa_scene* scene,
+    int numinstances,
+    scenecull* sc_out)
+{
+    int numnodes = scene->numnodes;
+    int nummeshes = scene->nummeshes;
+    int numitems;
+    int i;
+    int j;
+    memset(sc_out, 0, sizeof(*sc_out));
+    sc_out->scene = scene;
+    sc_out->numinstances = numinstances;
+    sc_out->bounds = (meshbounds*) malloc(
+        (nummeshes + 1) * sizeof(*sc_out->bounds));
+    for(i = 0; i < nummeshes; ++i)
+    {
+        bounds_create_mesh(scene->meshes + i, sc_out->bounds + i);
+    }
+    sc_out->meshnodes = (int*) malloc((numnodes + 1) * sizeof(int));
+    for(i = 0; i < numnodes; ++i)
+    {
+        if(scene->nodes[i].type == taa_SCENENODE_REF_MESH)
+        {
+            sc_out->meshnodes[sc_out->nummeshnodes++] = i;
+        }
+    }
+    numitems = numinstances * sc_out->nummeshnodes;
+    // the mesh boxes start in the bind pose
+    sc_out->meshboxes = (aabb*) malloc(
+        (numinstances*nummeshes + 1) * sizeof(*sc_out->meshboxes));
+    sc_out->paletteversions = (int*) malloc(
+        (numinstances*nummeshes + 1) * sizeof(int));
+    for(i = 0; i < numinstances; ++i)
+    {
+        for(j = 0; j < nummeshes; ++j)
+        {
+            sc_out->meshboxes[i*nummeshes + j] = sc_out->bounds[j].box;
+            sc_out->paletteversions[i*nummeshes + j] = -1;
+        }
+    }
+    sc_out->itemboxes = (aabb*) malloc(
+        (numitems + 1) * sizeof(*sc_out->itemboxes));
+    sc_out->itemscales = (float*) malloc(
+        (numitems + 1) * sizeof(*sc_out->itemscales));
+    sc_out->xformversions = (int*) malloc((numinstances + 1) * sizeof(int));
+    for(i = 0; i < numinstances; ++i)
+    {
+        // nothing has been calculated yet
+        sc_out->xformversions[i] = -1;
+    }
+    sc_out->meshchanged = (uint8_t*) calloc(nummeshes + 1, sizeof(uint8_t));
+    sc_out->itemvisible = (uint8_t*) malloc(numitems + 1);
+    sc_out->nodevisible = (uint8_t*) malloc(numinstances*numnodes + 1);
+    sc_out->meshvisible = (uint8_t*) malloc(numinstances*nummeshes + 1);
+    memset(sc_out->nodevisible, 1, numinstances*numnodes);
+    memset(sc_out->meshvisible, 1, numinstances*nummeshes);
+    sc_out->nodescales = (float*) malloc(
+        (numinstances*numnodes + 1) * sizeof(*sc_out->nodescales));
+    for(i = 0; i < numinstances*numnodes; ++i)
+    {
+        sc_out->nodescales[i] = FLT_MAX;
+    }
+    sc_out->numvisible = numitems;
+}
+
+//****************************************************************************
+void scenecull_destroy(
+    scenecull* sc)
+{
+    int i;
+    if(sc->built)
+    {
+        cullbvh_destroy(&sc->bvh);
+    }
+    for(i = 0; i < (int) sc->scene->nummeshes; ++i)
+    {
+        bounds_destroy_mesh(sc->bounds + i);
+    }
+    free(sc->nodescales);
+    free(sc->meshvisible);
+    free(sc->nodevisible);
+    free(sc->itemvisible);
+    free(sc->meshchanged);
+    free(sc->xformversions);
+    free(sc->itemscales);
+    free(sc->itemboxes);
+    free(sc->paletteversions);
+    free(sc->meshboxes);
+    free(sc->meshnodes);
+    free(sc->bounds);
+}
+
+//****************************************************************************
+// length of the longest axis of the matrix
+static float scenecull_calc_axis_scale(
+    const taa_mat44* m)
+{
+    float x = m->x.x*m->x.x + m->x.y*m->x.y + m->x.z*m->x.z;
+    float y = m->y.x*m->y.x + m->y.y*m->y.y + m->y.z*m->y.z;
+    float z = m->z.x*m->z.x + m->z.y*m->z.y + m->z.z*m->z.z;
+    float sq = (x > y) ? x : y;
+    sq = (sq > z) ? sq : z;
+    return (float) sqrt(sq);
+}
+
+//****************************************************************************
+void scenecull_update(
+    scenecull* sc,
+    const instance* instances)
+{
+    const taa_scene* scene = sc->scene;
+    int nummeshes = scene->nummeshes;
+    int nummeshnodes = sc->nummeshnodes;
+    int i;
+    int j;
+    for(i = 0; i < sc->numinstances; ++i)
+    {
+        const instance* inst = instances + i;
+        const xformcache* xforms = &inst->xforms;
+        aabb* meshboxes = sc->meshboxes + i*nummeshes;
+        int* paletteversions = sc->paletteversions + i*nummeshes;
+        int all = (sc->xformversions[i] < 0);
+        int moved = (inst->xformversion != sc->xformversions[i]);
+        // pose the boxes of the skinned meshes whose palettes changed
+        for(j = 0; j < nummeshes; ++j)
+        {
+            int version = inst->paletteversions[j];
+            sc->meshchanged[j] = 0;
+            if(version >= 0 && version != paletteversions[j])
+            {
+                bounds_calc_mesh(
+                    sc->bounds + j,
+                    inst->palettes[j],
+                    meshboxes + j);
+                paletteversions[j] = version;
+                sc->meshchanged[j] = 1;
+            }
+        }
+        for(j = 0; j < nummeshnodes; ++j)
+        {
+            int node = sc->meshnodes[j];
+            int meshid = scene->nodes[node].value.meshid;
+            if(all || (moved && xforms->dirty[node]) || sc->meshchanged[meshid])
+            {
+                int item = i*nummeshnodes + j;
+                taa_mat44 modelmat;
+                taa_mat44_multiply(
+                    &inst->gridmat,
+                    xforms->worldmats + node,
+                    &modelmat);
+                aabb_transform(
+                    meshboxes + meshid,
+                    &modelmat,
+                    sc->itemboxes + item);
+                sc->itemscales[item] = scenecull_calc_axis_scale(&modelmat);
+                if(sc->built)
+                {
+                    cullbvh_set_box(&sc->bvh, item, sc->itemboxes + item);
+                }
+            }
+        }
+        sc->xformversions[i] = inst->xformversion;
+    }
+    if(sc->built)
+    {
+        cullbvh_refit(&sc->bvh);
+    }
+    else
+    {
+        cullbvh_create(
+            sc->itemboxes,
+            sc->numinstances * nummeshnodes,
+            &sc->bvh);
+        sc->built = 1;
+    }
+}
+
+//****************************************************************************
+// pixels per mesh unit at the center of the box, for an item whose model
+// matrix scales mesh units by scale. a view inside the sphere around the
+// box gets FLT_MAX.
+static float scenecull_calc_scale(
+    const aabb* box,
+    float scale,
+    const taa_mat44* view,
+    const taa_mat44* proj,
+    int viewheight)
+{
+    taa_vec3 c;
+    taa_vec3 e;
+    float radius;
+    float dist;
+    float pixels = FLT_MAX;
+    c.x = (box->min.x + box->max.x) * 0.5f;
+    c.y = (box->min.y + box->max.y) * 0.5f;
+    c.z = (box->min.z + box->max.z) * 0.5f;
+    e.x = box->max.x - c.x;
+    e.y = box->max.y - c.y;
+    e.z = box->max.z - c.z;
+    radius = (float) sqrt(e.x*e.x + e.y*e.y + e.z*e.z);
+    // the view looks down negative z
+    dist = -(view->x.z*c.x + view->y.z*c.y + view->z.z*c.z + view->w.z);
+    if(dist > radius)
+    {
+        pixels = scale * proj->y.y * viewheight / dist;
+    }
+    return pixels;
+}
+
+//****************************************************************************
+void scenecull_cull(
+    scenecull* sc,
+    const taa_mat44* view,
+    const taa_mat44* proj,
+    int viewheight)
+{
+    const taa_scene* scene = sc->scene;
+    int numnodes = scene->numnodes;
+    int nummeshes = scene->nummeshes;
+    int numitems = sc->numinstances * sc->nummeshnodes;
+    taa_vec4 planes[CULLBVH_NUM_PLANES];
+    taa_mat44 viewproj;
+    int i;
+    if(sc->built)
+    {
+        taa_mat44_multiply(proj, view, &viewproj);
+        cullbvh_calc_frustum(&viewproj, planes);
+        sc->numvisible = cullbvh_cull(&sc->bvh, planes, sc->itemvisible);
+        memset(sc->nodevisible, 0, sc->numinstances*numnodes);
+        memset(sc->meshvisible, 0, sc->numinstances*nummeshes);
+        for(i = 0; i < numitems; ++i)
+        {
+            if(sc->itemvisible[i])
+            {
+                int inst = i / sc->nummeshnodes;
+                int node = sc->meshnodes[i % sc->nummeshnodes];
+                int meshid = scene->nodes[node].value.meshid;
+                sc->nodevisible[inst*numnodes + node] = 1;
+                sc->meshvisible[inst*nummeshes + meshid] = 1;
+                sc->nodescales[inst*numnodes + node] = scenecull_calc_scale(
+                    sc->itemboxes + i,
+                    sc->itemscales[i],
+                    view,
+                    proj,
+                    viewheight);
+            }
+        }
+    }
+}
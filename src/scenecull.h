@@ -0,0 +1,85 @@
+#ifndef SCENECULL_H_
+#define SCENECULL_H_
+
+#include "bounds.h"
+#include "cullbvh.h"
+#include "instance.h"
+
+typedef struct scenecull_s scenecull;
+
+// frustum culling of the mesh nodes of every instance. each mesh node of
+// each instance is an item of one hierarchy over world space boxes, which
+// is refitted as the nodes and skeletons move.
+struct scenecull_s
+{
+    const taa_scene* scene;
+    // bounds of each mesh of the scene, calculated once
+    meshbounds* bounds;
+    // the nodes that reference a mesh. item i*nummeshnodes + k is the k'th
+    // mesh node of instance i.
+    int* meshnodes;
+    int nummeshnodes;
+    int numinstances;
+    // box of each mesh of each instance, posed by the instance's palette
+    aabb* meshboxes;
+    // world box of each item
+    aabb* itemboxes;
+    cullbvh bvh;
+    // the hierarchy is built by the first update, once the boxes are known
+    int built;
+    // transform version of each instance when its boxes were calculated
+    int* xformversions;
+    // palette version of each mesh box of each instance
+    int* paletteversions;
+    // set for each mesh box changed by the current update
+    uint8_t* meshchanged;
+    uint8_t* itemvisible;
+    // set for each node of each instance inside the frustum, indexed by
+    // instance*numnodes + node. nodes without a mesh are never set.
+    uint8_t* nodevisible;
+    // set for each mesh of each instance referenced by a visible node,
+    // indexed by instance*nummeshes + mesh
+    uint8_t* meshvisible;
+    // largest axis scale of the model matrix of each item
+    float* itemscales;
+    // pixels per mesh unit at the distance of each visible node, indexed
+    // like nodevisible
+    float* nodescales;
+    int numvisible;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// the meshes of the scene must have been formatted by skin_format_mesh.
+// every node is visible until the first cull.
+void scenecull_create(
+    const taa_scene* scene,
+    int numinstances,
+    scenecull* sc_out);
+
+void scenecull_destroy(
+    scenecull* sc);
+
+// recalculates the boxes of the nodes whose transforms or palettes changed
+// and refits the hierarchy. like instdraw_update, this must be called after
+// every transform update, and after the palettes have been updated.
+void scenecull_update(
+    scenecull* sc,
+    const instance* instances);
+
+// sets the visible flags and scales of the nodes and meshes of every
+// instance for a view with the given projection and height in pixels
+void scenecull_cull(
+    scenecull* sc,
+    const taa_mat44* view,
+    const taa_mat44* proj,
+    int viewheight);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCENECULL_H_
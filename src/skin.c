@@ -0,0 +1,919 @@
+#include "skin.h"
+#include "vcache.h"
+#include <taa/mat44.h>
+#include <taa/vec3.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pmmintrin.h>
+
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define SKIN_AVX2 1
+#define SKIN_AVX2_TARGET __attribute__((target("avx2,fma")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1800
+#include <immintrin.h>
+#include <intrin.h>
+#define SKIN_AVX2 1
+#define SKIN_AVX2_TARGET
+#endif
+
+// -1 until the cpu has been queried, then 1 if the avx2 kernel is usable
+static int skin_useavx2 = -1;
+
+//****************************************************************************
+static int skin_detect_avx2(void)
+{
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(SKIN_AVX2)
+    int info[4];
+    int avx2 = 0;
+    __cpuid(info, 1);
+    // require fma, osxsave, and os support for the ymm registers
+    if((info[2] & (1 << 12)) && (info[2] & (1 << 27)))
+    {
+        if((_xgetbv(0) & 6) == 6)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+    }
+    return avx2;
+#else
+    return 0;
+#endif
+}
+
+//****************************************************************************
+// sorts the influences of a vertex by descending weight and returns the
+// number of influences with a non zero weight
+static int skin_sort_influences(
+    jwvert* jw)
+{
+    int numinfluences = 0;
+    int i;
+    for(i = 1; i < SKIN_MAX_INFLUENCES; ++i)
+    {
+        int32_t joint = jw->joints[i];
+        float weight = jw->weights[i];
+        int j = i;
+        while(j > 0 && jw->weights[j-1] < weight)
+        {
+            jw->joints[j] = jw->joints[j-1];
+            jw->weights[j] = jw->weights[j-1];
+            --j;
+        }
+        jw->joints[j] = joint;
+        jw->weights[j] = weight;
+    }
+    while(numinfluences<SKIN_MAX_INFLUENCES && jw->weights[numinfluences]>0)
+    {
+        ++numinfluences;
+    }
+    if(numinfluences == 0)
+    {
+        // an unweighted vertex follows the first joint
+        jw->weights[0] = 1.0f;
+        numinfluences = 1;
+    }
+    return numinfluences;
+}
+
+//****************************************************************************
+// renumbers the vertices in the order the triangles first use them, so
+// they are fetched and skinned close to sequentially. the vertices of a
+// skinned mesh are also grouped by their number of influences, keeping the
+// order of first use within each group.
+static void skin_order_vertices(
+    taa_scenemesh* mesh)
+{
+    static const int vertsizes[] =
+    {
+        sizeof(pnvert),
+        sizeof(tvert),
+        sizeof(jwvert)
+    };
+    jwvert* jwitr = (jwvert*) mesh->vertexstreams[2].buffer;
+    int numverts = mesh->vertexstreams[0].numvertices;
+    int starts[SKIN_MAX_INFLUENCES];
+    int first;
+    int* order;
+    int* remap;
+    void* tmp;
+    int i;
+    memset(starts, 0, sizeof(starts));
+    order = (int*) malloc((numverts + 1) * sizeof(*order));
+    remap = (int*) malloc((numverts + 1) * sizeof(*remap));
+    vcache_calc_fetch_order(
+        (const int32_t*) mesh->indices,
+        mesh->numindices,
+        numverts,
+        order);
+    // remap holds the group of each vertex until it is renumbered
+    for(i = 0; i < numverts; ++i)
+    {
+        remap[i] = 0;
+        if(mesh->skeleton >= 0)
+        {
+            remap[i] = skin_sort_influences(jwitr + i) - 1;
+        }
+        ++starts[remap[i]];
+    }
+    // convert the counts to the first vertex of each group
+    first = 0;
+    for(i = 0; i < SKIN_MAX_INFLUENCES; ++i)
+    {
+        int count = starts[i];
+        starts[i] = first;
+        first += count;
+    }
+    for(i = 0; i < numverts; ++i)
+    {
+        int v = order[i];
+        remap[v] = starts[remap[v]]++;
+    }
+    // permute the vertex streams and renumber the indices
+    tmp = malloc(numverts * sizeof(jwvert));
+    for(i = 0; i < 3; ++i)
+    {
+        char* buf = (char*) mesh->vertexstreams[i].buffer;
+        int size = vertsizes[i];
+        int j;
+        for(j = 0; j < numverts; ++j)
+        {
+            memcpy(((char*) tmp) + remap[j]*size, buf + j*size, size);
+        }
+        memcpy(buf, tmp, numverts*size);
+    }
+    for(i = 0; i < (int) mesh->numindices; ++i)
+    {
+        mesh->indices[i] = remap[mesh->indices[i]];
+    }
+    free(tmp);
+    free(remap);
+    free(order);
+}
+
+//****************************************************************************
+// merges the faces of each material binding into one, since their
+// triangles no longer stay together, and reorders the triangles of each
+// binding for the post transform cache
+static void skin_order_triangles(
+    taa_scenemesh* mesh)
+{
+    int numverts = mesh->vertexstreams[0].numvertices;
+    uint32_t i;
+    for(i = 0; i < mesh->numbindings; ++i)
+    {
+        taa_scenemesh_binding* b = mesh->bindings + i;
+        if(b->numfaces > 0)
+        {
+            taa_scenemesh_face* fface = mesh->faces + b->firstface;
+            const taa_scenemesh_face* lface = fface + b->numfaces - 1;
+            fface->numindices =
+                lface->firstindex + lface->numindices - fface->firstindex;
+            b->numfaces = 1;
+            vcache_optimize(
+                (int32_t*) mesh->indices + fface->firstindex,
+                fface->numindices,
+                numverts);
+        }
+    }
+}
+
+//****************************************************************************
+void skin_format_mesh(
+    taa_scenemesh* mesh,
+    float* oldacmr_out,
+    float* newacmr_out)
+{
+    taa_scenemesh_vertformat vf[] =
+    {
+        {
+            "pn",
+            taa_SCENEMESH_USAGE_POSITION,
+            0,
+            taa_SCENEMESH_VALUE_FLOAT32,
+            3,
+            0,
+            0
+        },
+        {
+            "pn",
+            taa_SCENEMESH_USAGE_NORMAL,
+            0,
+            taa_SCENEMESH_VALUE_FLOAT32,
+            3,
+            12,
+            0
+        },
+        {
+            "t",
+            taa_SCENEMESH_USAGE_TEXCOORD,
+            0,
+            taa_SCENEMESH_VALUE_FLOAT32,
+            2,
+            0,
+            1
+        },
+        {
+            "jw",
+            taa_SCENEMESH_USAGE_BLENDINDEX,
+            0,
+            taa_SCENEMESH_VALUE_INT32,
+            4,
+            0,
+            2
+        },
+        {
+            "jw",
+            taa_SCENEMESH_USAGE_BLENDWEIGHT,
+            0,
+            taa_SCENEMESH_VALUE_FLOAT32,
+            4,
+            16,
+            2
+        },
+    };
+    taa_scenemesh_format(mesh, vf, sizeof(vf)/sizeof(*vf));
+    taa_scenemesh_triangulate(mesh);
+    *oldacmr_out = vcache_calc_acmr(
+        (const int32_t*) mesh->indices,
+        mesh->numindices,
+        mesh->vertexstreams[0].numvertices);
+    skin_order_triangles(mesh);
+    skin_order_vertices(mesh);
+    *newacmr_out = vcache_calc_acmr(
+        (const int32_t*) mesh->indices,
+        mesh->numindices,
+        mesh->vertexstreams[0].numvertices);
+}
+
+//****************************************************************************
+// out = a * b for 16 byte aligned matrices
+static void skin_multiply_joint(
+    const taa_mat44* a,
+    const taa_mat44* b,
+    taa_mat44* out)
+{
+    const float* am = &a->x.x;
+    const float* bm = &b->x.x;
+    float* om = &out->x.x;
+    __m128 ax = _mm_load_ps(am +  0);
+    __m128 ay = _mm_load_ps(am +  4);
+    __m128 az = _mm_load_ps(am +  8);
+    __m128 aw = _mm_load_ps(am + 12);
+    int c;
+    for(c = 0; c < 16; c += 4)
+    {
+        __m128 r = _mm_mul_ps(ax, _mm_set1_ps(bm[c + 0]));
+        r = _mm_add_ps(r, _mm_mul_ps(ay, _mm_set1_ps(bm[c + 1])));
+        r = _mm_add_ps(r, _mm_mul_ps(az, _mm_set1_ps(bm[c + 2])));
+        r = _mm_add_ps(r, _mm_mul_ps(aw, _mm_set1_ps(bm[c + 3])));
+        _mm_store_ps(om + c, r);
+    }
+}
+
+//****************************************************************************
+// calculates the world space transform of every joint in the skeleton.
+// parents always precede their children in the joint array, so each parent
+// is complete before its children read it. the local transforms come from
+// the scene one joint at a time, and each parent multiply uses sse across
+// the columns of one matrix.
+static void skin_calc_joint_transforms(
+    const skinpose* pose,
+    const taa_scenenode* nodes,
+    taa_mat44* mats_out)
+{
+    const taa_sceneskel* skel = pose->skel;
+    taa_mat44* localmats = pose->localmats;
+    int numjoints = pose->numjoints;
+    int i;
+    for(i = 0; i < numjoints; ++i)
+    {
+        int parent = skel->joints[i].parent;
+        taa_sceneskel_calc_transform(skel, nodes, i, localmats + i);
+        if(parent >= 0)
+        {
+            skin_multiply_joint(mats_out + parent, localmats + i, mats_out+i);
+        }
+        else
+        {
+            mats_out[i] = localmats[i];
+        }
+    }
+}
+
+//****************************************************************************
+void skin_create_pose(
+    const taa_sceneskel* skel,
+    skinpose* pose_out)
+{
+    int numjoints = skel->numjoints;
+    pose_out->skel = skel;
+    pose_out->nodes = NULL;
+    pose_out->jointmats = (taa_mat44*) taa_memalign(
+        16,
+        numjoints*sizeof(*pose_out->jointmats));
+    pose_out->prevmats = (taa_mat44*) taa_memalign(
+        16,
+        numjoints*sizeof(*pose_out->prevmats));
+    pose_out->localmats = (taa_mat44*) taa_memalign(
+        16,
+        numjoints*sizeof(*pose_out->localmats));
+    memset(pose_out->jointmats, 0, numjoints*sizeof(*pose_out->jointmats));
+    pose_out->numjoints = numjoints;
+    pose_out->version = 0;
+}
+
+//****************************************************************************
+void skin_destroy_pose(
+    skinpose* pose)
+{
+    taa_memalign_free(pose->jointmats);
+    taa_memalign_free(pose->prevmats);
+    taa_memalign_free(pose->localmats);
+}
+
+//****************************************************************************
+void skin_update_pose(
+    const taa_sceneskel* skel,
+    const taa_scenenode* nodes,
+    skinpose* pose)
+{
+    taa_mat44* mats = pose->prevmats;
+    size_t size = pose->numjoints * sizeof(*mats);
+    pose->skel = skel;
+    skin_calc_joint_transforms(pose, nodes, mats);
+    if(memcmp(mats, pose->jointmats, size) != 0)
+    {
+        // swap buffers so the new transforms become current
+        pose->prevmats = pose->jointmats;
+        pose->jointmats = mats;
+        ++pose->version;
+    }
+}
+
+//****************************************************************************
+static void skin_run_pose_task(
+    void* userdata,
+    int first,
+    int end)
+{
+    skinpose* poses = (skinpose*) userdata;
+    int i;
+    for(i = first; i < end; ++i)
+    {
+        skin_update_pose(poses[i].skel, poses[i].nodes, poses + i);
+    }
+}
+
+//****************************************************************************
+int skin_add_pose_tasks(
+    skinpose* poses,
+    int numposes,
+    const taa_scenenode* nodes,
+    taskpool_task* tasks_out)
+{
+    int i;
+    for(i = 0; i < numposes; ++i)
+    {
+        taskpool_task* task = tasks_out + i;
+        poses[i].nodes = nodes;
+        task->func = skin_run_pose_task;
+        task->userdata = poses;
+        task->first = i;
+        task->end = i + 1;
+        task->counter = NULL;
+    }
+    return numposes;
+}
+
+//****************************************************************************
+static int skin_get_joint(
+    const skinmesh* smesh,
+    const skingroup* group,
+    int influence,
+    int v)
+{
+    int i = group->jointoffset + influence*group->numpadded + v;
+    return (smesh->joints8 != NULL) ? smesh->joints8[i] : smesh->joints16[i];
+}
+
+//****************************************************************************
+static float skin_get_weight(
+    const skinmesh* smesh,
+    const skingroup* group,
+    int influence,
+    int v)
+{
+    int i = group->weightoffset + influence*group->numpadded + v;
+    return smesh->weights[i] * (1.0f/65535.0f);
+}
+
+//****************************************************************************
+// blends 4 vertices of a group per iteration. each lane accumulates its
+// weighted palette matrix, then the matrices are transposed so the
+// transform runs on structure of arrays registers. single influence
+// vertices use their palette matrix directly.
+static void skin_group_sse(
+    const skinmesh* smesh,
+    const skingroup* group,
+    int numinfluences,
+    const taa_mat44* palette,
+    int first,
+    int end,
+    pnvert* pndst)
+{
+    const float* pal = &palette->x.x;
+    int numverts = group->numverts;
+    int i;
+    end = (end < numverts) ? end : numverts;
+    for(i = first; i < end; i += 4)
+    {
+        __m128 cols[4][4];
+        __m128 out[6];
+        __m128 px;
+        __m128 py;
+        __m128 pz;
+        __m128 nx;
+        __m128 ny;
+        __m128 nz;
+        __m128 len;
+        int lane;
+        int numlanes;
+        int r;
+        int o;
+        for(lane = 0; lane < 4; ++lane)
+        {
+            int v = i + lane;
+            const float* m = pal + skin_get_joint(smesh, group, 0, v)*16;
+            __m128 cx = _mm_load_ps(m +  0);
+            __m128 cy = _mm_load_ps(m +  4);
+            __m128 cz = _mm_load_ps(m +  8);
+            __m128 cw = _mm_load_ps(m + 12);
+            if(numinfluences > 1)
+            {
+                __m128 w = _mm_set1_ps(skin_get_weight(smesh, group, 0, v));
+                int k;
+                cx = _mm_mul_ps(w, cx);
+                cy = _mm_mul_ps(w, cy);
+                cz = _mm_mul_ps(w, cz);
+                cw = _mm_mul_ps(w, cw);
+                for(k = 1; k < numinfluences; ++k)
+                {
+                    m = pal + skin_get_joint(smesh, group, k, v)*16;
+                    w = _mm_set1_ps(skin_get_weight(smesh, group, k, v));
+                    cx = _mm_add_ps(cx, _mm_mul_ps(w, _mm_load_ps(m +  0)));
+                    cy = _mm_add_ps(cy, _mm_mul_ps(w, _mm_load_ps(m +  4)));
+                    cz = _mm_add_ps(cz, _mm_mul_ps(w, _mm_load_ps(m +  8)));
+                    cw = _mm_add_ps(cw, _mm_mul_ps(w, _mm_load_ps(m + 12)));
+                }
+            }
+            cols[lane][0] = cx;
+            cols[lane][1] = cy;
+            cols[lane][2] = cz;
+            cols[lane][3] = cw;
+        }
+        // after transposing, cols[r][c] holds component r of column c
+        _MM_TRANSPOSE4_PS(cols[0][0], cols[1][0], cols[2][0], cols[3][0]);
+        _MM_TRANSPOSE4_PS(cols[0][1], cols[1][1], cols[2][1], cols[3][1]);
+        _MM_TRANSPOSE4_PS(cols[0][2], cols[1][2], cols[2][2], cols[3][2]);
+        _MM_TRANSPOSE4_PS(cols[0][3], cols[1][3], cols[2][3], cols[3][3]);
+        o = group->offset + i;
+        px = _mm_load_ps(smesh->px + o);
+        py = _mm_load_ps(smesh->py + o);
+        pz = _mm_load_ps(smesh->pz + o);
+        nx = _mm_load_ps(smesh->nx + o);
+        ny = _mm_load_ps(smesh->ny + o);
+        nz = _mm_load_ps(smesh->nz + o);
+        for(r = 0; r < 3; ++r)
+        {
+            __m128 p = cols[r][3];
+            __m128 n;
+            p = _mm_add_ps(p, _mm_mul_ps(cols[r][0], px));
+            p = _mm_add_ps(p, _mm_mul_ps(cols[r][1], py));
+            p = _mm_add_ps(p, _mm_mul_ps(cols[r][2], pz));
+            n = _mm_mul_ps(cols[r][0], nx);
+            n = _mm_add_ps(n, _mm_mul_ps(cols[r][1], ny));
+            n = _mm_add_ps(n, _mm_mul_ps(cols[r][2], nz));
+            out[r] = p;
+            out[r + 3] = n;
+        }
+        len = _mm_mul_ps(out[3], out[3]);
+        len = _mm_add_ps(len, _mm_mul_ps(out[4], out[4]));
+        len = _mm_add_ps(len, _mm_mul_ps(out[5], out[5]));
+        len = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(len));
+        out[3] = _mm_mul_ps(out[3], len);
+        out[4] = _mm_mul_ps(out[4], len);
+        out[5] = _mm_mul_ps(out[5], len);
+        // scatter the lanes back to interleaved vertices
+        numlanes = (numverts - i < 4) ? numverts - i : 4;
+        for(lane = 0; lane < numlanes; ++lane)
+        {
+            pnvert* pn = pndst + i + lane;
+            pn->pos.x    = ((float*) (out + 0))[lane];
+            pn->pos.y    = ((float*) (out + 1))[lane];
+            pn->pos.z    = ((float*) (out + 2))[lane];
+            pn->normal.x = ((float*) (out + 3))[lane];
+            pn->normal.y = ((float*) (out + 4))[lane];
+            pn->normal.z = ((float*) (out + 5))[lane];
+        }
+    }
+}
+
+#ifdef SKIN_AVX2
+//****************************************************************************
+// blends 8 vertices of a group per iteration. the 12 meaningful elements
+// of each influence's palette matrix are gathered directly into structure
+// of arrays registers.
+SKIN_AVX2_TARGET static void skin_group_avx2(
+    const skinmesh* smesh,
+    const skingroup* group,
+    int numinfluences,
+    const taa_mat44* palette,
+    int first,
+    int end,
+    pnvert* pndst)
+{
+    const float* pal = &palette->x.x;
+    const __m256 wscale = _mm256_set1_ps(1.0f/65535.0f);
+    int numverts = group->numverts;
+    int i;
+    end = (end < numverts) ? end : numverts;
+    for(i = first; i < end; i += 8)
+    {
+        // m[c*3 + r] holds component r of column c
+        __m256 m[12];
+        __m256 out[6];
+        __m256 px;
+        __m256 py;
+        __m256 pz;
+        __m256 nx;
+        __m256 ny;
+        __m256 nz;
+        __m256 len;
+        int k;
+        int c;
+        int r;
+        int lane;
+        int numlanes;
+        int o;
+        for(k = 0; k < numinfluences; ++k)
+        {
+            __m256i idx;
+            __m256 w;
+            o = group->jointoffset + k*group->numpadded + i;
+            if(smesh->joints8 != NULL)
+            {
+                const __m128i* j8 = (const __m128i*) (smesh->joints8 + o);
+                idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(j8));
+            }
+            else
+            {
+                const __m128i* j16 = (const __m128i*) (smesh->joints16 + o);
+                idx = _mm256_cvtepu16_epi32(_mm_loadu_si128(j16));
+            }
+            idx = _mm256_slli_epi32(idx, 4);
+            if(numinfluences == 1)
+            {
+                for(c = 0; c < 12; ++c)
+                {
+                    m[c] = _mm256_i32gather_ps(pal + (c/3)*4 + c%3, idx, 4);
+                }
+                break;
+            }
+            o = group->weightoffset + k*group->numpadded + i;
+            w = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(
+                _mm_loadu_si128((const __m128i*) (smesh->weights + o))));
+            w = _mm256_mul_ps(w, wscale);
+            for(c = 0; c < 4; ++c)
+            {
+                for(r = 0; r < 3; ++r)
+                {
+                    __m256 g = _mm256_i32gather_ps(pal + c*4 + r, idx, 4);
+                    m[c*3+r] = (k == 0) ?
+                        _mm256_mul_ps(w, g) :
+                        _mm256_fmadd_ps(w, g, m[c*3+r]);
+                }
+            }
+        }
+        o = group->offset + i;
+        px = _mm256_load_ps(smesh->px + o);
+        py = _mm256_load_ps(smesh->py + o);
+        pz = _mm256_load_ps(smesh->pz + o);
+        nx = _mm256_load_ps(smesh->nx + o);
+        ny = _mm256_load_ps(smesh->ny + o);
+        nz = _mm256_load_ps(smesh->nz + o);
+        for(r = 0; r < 3; ++r)
+        {
+            __m256 p = m[9 + r];
+            __m256 n;
+            p = _mm256_fmadd_ps(m[0 + r], px, p);
+            p = _mm256_fmadd_ps(m[3 + r], py, p);
+            p = _mm256_fmadd_ps(m[6 + r], pz, p);
+            n = _mm256_mul_ps(m[0 + r], nx);
+            n = _mm256_fmadd_ps(m[3 + r], ny, n);
+            n = _mm256_fmadd_ps(m[6 + r], nz, n);
+            out[r] = p;
+            out[r + 3] = n;
+        }
+        len = _mm256_mul_ps(out[3], out[3]);
+        len = _mm256_fmadd_ps(out[4], out[4], len);
+        len = _mm256_fmadd_ps(out[5], out[5], len);
+        len = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(len));
+        out[3] = _mm256_mul_ps(out[3], len);
+        out[4] = _mm256_mul_ps(out[4], len);
+        out[5] = _mm256_mul_ps(out[5], len);
+        // scatter the lanes back to interleaved vertices
+        numlanes = (numverts - i < 8) ? numverts - i : 8;
+        for(lane = 0; lane < numlanes; ++lane)
+        {
+            pnvert* pn = pndst + i + lane;
+            pn->pos.x    = ((float*) (out + 0))[lane];
+            pn->pos.y    = ((float*) (out + 1))[lane];
+            pn->pos.z    = ((float*) (out + 2))[lane];
+            pn->normal.x = ((float*) (out + 3))[lane];
+            pn->normal.y = ((float*) (out + 4))[lane];
+            pn->normal.z = ((float*) (out + 5))[lane];
+        }
+    }
+}
+#endif
+
+//****************************************************************************
+void skin_create_mesh(
+    const taa_scenemesh* mesh,
+    skinmesh* smesh_out)
+{
+    const pnvert* pnsrc = (const pnvert*) mesh->vertexstreams[0].buffer;
+    const jwvert* jwsrc = (const jwvert*) mesh->vertexstreams[2].buffer;
+    int numverts = mesh->vertexstreams[0].numvertices;
+    int numpadded = 0;
+    int numjointvals = 0;
+    int numweightvals = 0;
+    int numjoints = 1;
+    int jointsize;
+    char* buf;
+    int i;
+    int k;
+    if(skin_useavx2 < 0)
+    {
+        skin_useavx2 = skin_detect_avx2();
+    }
+    memset(smesh_out, 0, sizeof(*smesh_out));
+    // skin_format_mesh sorted the vertices by influence count, so each
+    // group is a contiguous range of the mesh vertices
+    for(i = 0; i < numverts; ++i)
+    {
+        const jwvert* jw = jwsrc + i;
+        k = 1;
+        while(k < SKIN_MAX_INFLUENCES && jw->weights[k] > 0.0f)
+        {
+            ++k;
+        }
+        ++smesh_out->groups[k - 1].numverts;
+        while(k-- > 0)
+        {
+            if(jw->joints[k] >= numjoints)
+            {
+                numjoints = jw->joints[k] + 1;
+            }
+        }
+    }
+    numverts = 0;
+    for(k = 0; k < SKIN_MAX_INFLUENCES; ++k)
+    {
+        skingroup* group = smesh_out->groups + k;
+        int n = group->numverts;
+        group->firstvert = numverts;
+        numverts += n;
+        group->numpadded = (n + SKIN_MAX_LANES-1) & ~(SKIN_MAX_LANES-1);
+        group->offset = numpadded;
+        group->jointoffset = numjointvals;
+        group->weightoffset = numweightvals;
+        numpadded += group->numpadded;
+        numjointvals += (k + 1) * group->numpadded;
+        numweightvals += (k > 0) ? (k + 1) * group->numpadded : 0;
+    }
+    // allocate all streams from one block, aligned for 256 bit loads
+    jointsize = (numjoints <= 256) ? 1 : 2;
+    buf = (char*) taa_memalign(
+        32,
+        numpadded*6*sizeof(float) +
+        numweightvals*sizeof(uint16_t) +
+        numjointvals*jointsize);
+    smesh_out->px = ((float*) buf) + numpadded*0;
+    smesh_out->py = ((float*) buf) + numpadded*1;
+    smesh_out->pz = ((float*) buf) + numpadded*2;
+    smesh_out->nx = ((float*) buf) + numpadded*3;
+    smesh_out->ny = ((float*) buf) + numpadded*4;
+    smesh_out->nz = ((float*) buf) + numpadded*5;
+    smesh_out->weights = (uint16_t*) (buf + numpadded*6*sizeof(float));
+    if(jointsize == 1)
+    {
+        smesh_out->joints8 = (uint8_t*) (smesh_out->weights + numweightvals);
+    }
+    else
+    {
+        smesh_out->joints16 = (uint16_t*) (smesh_out->weights+numweightvals);
+    }
+    for(k = 0; k < SKIN_MAX_INFLUENCES; ++k)
+    {
+        const skingroup* group = smesh_out->groups + k;
+        int numinfluences = k + 1;
+        for(i = 0; i < group->numpadded; ++i)
+        {
+            // padding vertices are fully bound to the first skin joint
+            pnvert pn = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+            jwvert jw = { { 0, 0, 0, 0 }, { 1.0f, 0.0f, 0.0f, 0.0f } };
+            int o = group->offset + i;
+            int j;
+            if(i < group->numverts)
+            {
+                pn = pnsrc[group->firstvert + i];
+                jw = jwsrc[group->firstvert + i];
+            }
+            smesh_out->px[o] = pn.pos.x;
+            smesh_out->py[o] = pn.pos.y;
+            smesh_out->pz[o] = pn.pos.z;
+            smesh_out->nx[o] = pn.normal.x;
+            smesh_out->ny[o] = pn.normal.y;
+            smesh_out->nz[o] = pn.normal.z;
+            for(j = 0; j < numinfluences; ++j)
+            {
+                o = group->jointoffset + j*group->numpadded + i;
+                if(jointsize == 1)
+                {
+                    smesh_out->joints8[o] = (uint8_t) jw.joints[j];
+                }
+                else
+                {
+                    smesh_out->joints16[o] = (uint16_t) jw.joints[j];
+                }
+            }
+            if(numinfluences > 1)
+            {
+                // quantize the weights so they sum to exactly one
+                float sum = 0.0f;
+                int total = 0;
+                int q[SKIN_MAX_INFLUENCES];
+                for(j = 0; j < numinfluences; ++j)
+                {
+                    sum += jw.weights[j];
+                }
+                for(j = 0; j < numinfluences; ++j)
+                {
+                    q[j] = (int) ((jw.weights[j]/sum)*65535.0f + 0.5f);
+                    total += q[j];
+                }
+                q[0] += 65535 - total;
+                for(j = 0; j < numinfluences; ++j)
+                {
+                    o = group->weightoffset + j*group->numpadded + i;
+                    smesh_out->weights[o] = (uint16_t) q[j];
+                }
+            }
+        }
+    }
+    smesh_out->numverts = numverts;
+    smesh_out->numpadded = numpadded;
+    smesh_out->numjoints = numjoints;
+}
+
+//****************************************************************************
+void skin_destroy_mesh(
+    skinmesh* smesh)
+{
+    taa_memalign_free(smesh->px);
+}
+
+//****************************************************************************
+void skin_calc_palette(
+    const taa_scenemesh* mesh,
+    int numjoints,
+    const taa_mat44* jointmats,
+    taa_mat44* palette_out)
+{
+    const taa_scenemesh_skinjoint* sjitr = mesh->joints;
+    const taa_scenemesh_skinjoint* sjend = sjitr + numjoints;
+    while(sjitr != sjend)
+    {
+        taa_mat44_multiply(
+            jointmats + sjitr->animjoint,
+            &sjitr->invbindmatrix,
+            palette_out);
+        ++palette_out;
+        ++sjitr;
+    }
+}
+
+//****************************************************************************
+void skin_vertices(
+    const skinmesh* smesh,
+    const taa_mat44* palette,
+    int first,
+    int end,
+    pnvert* pndst)
+{
+    int k;
+    for(k = 0; k < SKIN_MAX_INFLUENCES; ++k)
+    {
+        const skingroup* group = smesh->groups + k;
+        int gfirst = first - group->offset;
+        int gend = end - group->offset;
+        gfirst = (gfirst > 0) ? gfirst : 0;
+        gend = (gend < group->numpadded) ? gend : group->numpadded;
+        if(gfirst < gend)
+        {
+            // the influence count is constant for the whole group, so the
+            // kernels specialize their inner loop on it
+#ifdef SKIN_AVX2
+            if(skin_useavx2 > 0)
+            {
+                skin_group_avx2(
+                    smesh,
+                    group,
+                    k + 1,
+                    palette,
+                    gfirst,
+                    gend,
+                    pndst + group->firstvert);
+                continue;
+            }
+#endif
+            skin_group_sse(
+                smesh,
+                group,
+                k + 1,
+                palette,
+                gfirst,
+                gend,
+                pndst + group->firstvert);
+        }
+    }
+}
+
+//****************************************************************************
+void skin_copy_bind_pose(
+    const skinmesh* smesh,
+    pnvert* pndst)
+{
+    int k;
+    int i;
+    for(k = 0; k < SKIN_MAX_INFLUENCES; ++k)
+    {
+        const skingroup* group = smesh->groups + k;
+        for(i = 0; i < group->numverts; ++i)
+        {
+            pnvert* pn = pndst + group->firstvert + i;
+            int o = group->offset + i;
+            pn->pos.x = smesh->px[o];
+            pn->pos.y = smesh->py[o];
+            pn->pos.z = smesh->pz[o];
+            pn->normal.x = smesh->nx[o];
+            pn->normal.y = smesh->ny[o];
+            pn->normal.z = smesh->nz[o];
+        }
+    }
+}
+
+//****************************************************************************
+static void skin_run_task(
+    void* userdata,
+    int first,
+    int end)
+{
+    skinjob* job = (skinjob*) userdata;
+    skin_vertices(job->smesh, job->palette, first, end, job->pndst);
+}
+
+//****************************************************************************
+int skin_count_tasks(
+    const skinmesh* smesh)
+{
+    return (smesh->numpadded + SKIN_TASK_VERTS - 1) / SKIN_TASK_VERTS;
+}
+
+//****************************************************************************
+int skin_add_tasks(
+    skinjob* job,
+    taskpool_task* tasks_out)
+{
+    int numpadded = job->smesh->numpadded;
+    int numtasks = 0;
+    int first;
+    for(first = 0; first < numpadded; first += SKIN_TASK_VERTS)
+    {
+        taskpool_task* task = tasks_out + numtasks;
+        task->func = skin_run_task;
+        task->userdata = job;
+        task->first = first;
+        task->end = first + SKIN_TASK_VERTS;
+        task->counter = &job->counter;
+        ++numtasks;
+    }
+    job->counter = numtasks;
+    return numtasks;
+}
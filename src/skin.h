@@ -0,0 +1,199 @@
+#ifndef SKIN_H_
+#define SKIN_H_
+
+#include "taskpool.h"
+#include <taa/scene.h>
+
+typedef struct pnvert_s pnvert;
+typedef struct tvert_s tvert;
+typedef struct jwvert_s jwvert;
+typedef struct skingroup_s skingroup;
+typedef struct skinmesh_s skinmesh;
+typedef struct skinjob_s skinjob;
+typedef struct skinpose_s skinpose;
+
+enum
+{
+    // number of vertices blended per iteration by the widest kernel
+    SKIN_MAX_LANES = 8,
+    SKIN_MAX_INFLUENCES = 4,
+    // number of vertices skinned by one task
+    SKIN_TASK_VERTS = 2048
+};
+
+struct pnvert_s
+{
+    taa_vec3 pos;
+    taa_vec3 normal;
+};
+
+struct tvert_s
+{
+    taa_vec2 texcoord;
+};
+
+struct jwvert_s
+{
+    int32_t joints[4];
+    float weights[4];
+};
+
+// range of vertices that share the same number of influences
+struct skingroup_s
+{
+    // range of the group in the mesh vertex order
+    int firstvert;
+    int numverts;
+    // range of the group in the padded position and normal streams
+    int offset;
+    int numpadded;
+    // start of the group's joint and weight streams. each influence has its
+    // own stream of numpadded values.
+    int jointoffset;
+    int weightoffset;
+};
+
+// bind pose vertices split into one stream per component so that the
+// skinning kernels can blend several vertices per iteration. vertices are
+// grouped by influence count, and each group is padded to a multiple of
+// SKIN_MAX_LANES.
+struct skinmesh_s
+{
+    float* px;
+    float* py;
+    float* pz;
+    float* nx;
+    float* ny;
+    float* nz;
+    // 8 bit joint indices when the palette fits, otherwise 16 bit
+    uint8_t* joints8;
+    uint16_t* joints16;
+    // weights scaled so that each vertex sums to 65535. the single
+    // influence group has no weight streams.
+    uint16_t* weights;
+    // groups[k] holds the vertices with k+1 influences
+    skingroup groups[SKIN_MAX_INFLUENCES];
+    int numverts;
+    // total length of the padded position and normal streams
+    int numpadded;
+    // size of the skinning palette; one past the highest skin joint index
+    int numjoints;
+};
+
+// world space joint transforms of a skeleton. the version changes whenever
+// any of the transforms do, so skinned results can be reused until then.
+struct skinpose_s
+{
+    const taa_sceneskel* skel;
+    // animated nodes the pose tasks read from
+    const taa_scenenode* nodes;
+    taa_mat44* jointmats;
+    // joint transforms of the previous update
+    taa_mat44* prevmats;
+    // joint transforms relative to their parents
+    taa_mat44* localmats;
+    int numjoints;
+    int version;
+};
+
+// skinning of one mesh that is split into vertex range tasks
+struct skinjob_s
+{
+    const skinmesh* smesh;
+    const taa_mat44* palette;
+    pnvert* pndst;
+    // tasks of the job that have not completed
+    taskpool_counter counter;
+    // pose version of the skinned vertices, or -1 before the first skinning
+    int version;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// converts the mesh to the viewer vertex streams and triangulates it
+// stream 0 is pnvert, stream 1 is tvert, and stream 2 is jwvert. the
+// vertices of skinned meshes are sorted by influence count, and the
+// influences of each vertex are sorted by descending weight. each material
+// binding is left with one face, whose triangles are ordered for the post
+// transform cache, and the vertices are numbered in order of first use.
+// the average cache misses per triangle before and after the reordering
+// are returned for reporting.
+void skin_format_mesh(
+    taa_scenemesh* mesh,
+    float* oldacmr_out,
+    float* newacmr_out);
+
+void skin_create_pose(
+    const taa_sceneskel* skel,
+    skinpose* pose_out);
+
+void skin_destroy_pose(
+    skinpose* pose);
+
+// recalculates the joint transforms and increments the version if any of
+// them changed
+void skin_update_pose(
+    const taa_sceneskel* skel,
+    const taa_scenenode* nodes,
+    skinpose* pose);
+
+// adds one task per skeleton that updates its pose from the nodes. the
+// nodes must remain valid until the tasks have completed.
+int skin_add_pose_tasks(
+    skinpose* poses,
+    int numposes,
+    const taa_scenenode* nodes,
+    taskpool_task* tasks_out);
+
+// builds the compact skinning streams of a formatted mesh. the mesh's
+// position normal and joint weight streams are not read again afterward,
+// so the owner may release them.
+void skin_create_mesh(
+    const taa_scenemesh* mesh,
+    skinmesh* smesh_out);
+
+void skin_destroy_mesh(
+    skinmesh* smesh);
+
+// multiplies the animated transforms of the first numjoints skin joints by
+// their inverse bind matrices
+void skin_calc_palette(
+    const taa_scenemesh* mesh,
+    int numjoints,
+    const taa_mat44* jointmats,
+    taa_mat44* palette_out);
+
+// blends the bind pose vertices by the palette matrices. first and end
+// index the padded streams and must be multiples of SKIN_MAX_LANES, so a
+// mesh can be split into ranges that are skinned concurrently. pass 0 and
+// smesh->numpadded to skin the whole mesh.
+void skin_vertices(
+    const skinmesh* smesh,
+    const taa_mat44* palette,
+    int first,
+    int end,
+    pnvert* pndst);
+
+// writes the unskinned bind pose vertices of the mesh
+void skin_copy_bind_pose(
+    const skinmesh* smesh,
+    pnvert* pndst);
+
+// the maximum number of tasks skin_add_tasks can produce for the mesh
+int skin_count_tasks(
+    const skinmesh* smesh);
+
+// splits the job into vertex range tasks and resets its counter. returns
+// the number of tasks written to tasks_out.
+int skin_add_tasks(
+    skinjob* job,
+    taskpool_task* tasks_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SKIN_H_
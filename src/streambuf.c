@@ -0,0 +1,223 @@
+#include "streambuf.h"
+#include <stdlib.h>
+
+typedef struct streambuf_range_s streambuf_range;
+
+enum
+{
+    // nanoseconds to wait on a fence before checking it again
+    STREAMBUF_WAIT_TIMEOUT = 1000000
+};
+
+struct streambuf_range_s
+{
+    // offset of the range within each slot
+    size_t offset;
+    size_t size;
+    // slot that is drawn
+    int slot;
+    // set between begin and end write
+    int writing;
+};
+
+struct streambuf_s
+{
+    glext ext;
+    GLuint buffer;
+    // bytes per slot, the sum of the aligned range sizes
+    size_t slotsize;
+    streambuf_range* ranges;
+    int numranges;
+    // persistent mapping of the whole buffer, or NULL if writes are staged
+    unsigned char* map;
+    // aligned client memory for one slot when the buffer is not mapped
+    unsigned char* staging;
+    void* stagingalloc;
+    // fence after the draws of the last frame that used each frame index
+    GLsync fences[STREAMBUF_NUM_SLOTS];
+    int frame;
+};
+
+//****************************************************************************
+streambuf* streambuf_create(
+    const size_t* rangesizes,
+    int numranges,
+    const glext* ext)
+{
+    streambuf* sb;
+    size_t slotsize;
+    size_t size;
+    int i;
+    sb = (streambuf*) calloc(1, sizeof(*sb));
+    sb->ext = *ext;
+    sb->ranges = (streambuf_range*) calloc(
+        numranges + 1,
+        sizeof(*sb->ranges));
+    sb->numranges = numranges;
+    slotsize = 0;
+    for(i = 0; i < numranges; ++i)
+    {
+        streambuf_range* range = sb->ranges + i;
+        range->offset = slotsize;
+        range->size = rangesizes[i];
+        // the first write advances to slot 0
+        range->slot = STREAMBUF_NUM_SLOTS - 1;
+        slotsize += (rangesizes[i]+STREAMBUF_ALIGN-1) & ~(STREAMBUF_ALIGN-1);
+    }
+    sb->slotsize = slotsize;
+    size = slotsize * STREAMBUF_NUM_SLOTS;
+    ext->genbuffers(1, &sb->buffer);
+    ext->bindbuffer(GL_ARRAY_BUFFER, sb->buffer);
+    if(ext->persistent && size > 0)
+    {
+        // the mapping is coherent, so writes are visible to the draws that
+        // are issued after them without an explicit flush. dynamic storage
+        // allows staged writes if the buffer cannot be mapped.
+        GLbitfield flags;
+        flags = GL_MAP_WRITE_BIT|GL_MAP_PERSISTENT_BIT|GL_MAP_COHERENT_BIT;
+        ext->bufferstorage(
+            GL_ARRAY_BUFFER,
+            size,
+            NULL,
+            flags | GL_DYNAMIC_STORAGE_BIT);
+        sb->map = (unsigned char*) ext->mapbufferrange(
+            GL_ARRAY_BUFFER,
+            0,
+            size,
+            flags);
+    }
+    if(sb->map == NULL)
+    {
+        size_t addr;
+        if(!ext->persistent || size == 0)
+        {
+            ext->bufferdata(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+        }
+        sb->stagingalloc = malloc(slotsize + STREAMBUF_ALIGN);
+        addr = (size_t) sb->stagingalloc;
+        addr = (addr + STREAMBUF_ALIGN - 1) & ~((size_t) STREAMBUF_ALIGN-1);
+        sb->staging = (unsigned char*) addr;
+    }
+    ext->bindbuffer(GL_ARRAY_BUFFER, 0);
+    return sb;
+}
+
+//****************************************************************************
+void streambuf_destroy(
+    streambuf* sb)
+{
+    const glext* ext = &sb->ext;
+    int i;
+    for(i = 0; i < STREAMBUF_NUM_SLOTS; ++i)
+    {
+        if(sb->fences[i] != NULL)
+        {
+            ext->deletesync(sb->fences[i]);
+        }
+    }
+    if(sb->map != NULL)
+    {
+        ext->bindbuffer(GL_ARRAY_BUFFER, sb->buffer);
+        ext->unmapbuffer(GL_ARRAY_BUFFER);
+        ext->bindbuffer(GL_ARRAY_BUFFER, 0);
+    }
+    ext->deletebuffers(1, &sb->buffer);
+    free(sb->stagingalloc);
+    free(sb->ranges);
+    free(sb);
+}
+
+//****************************************************************************
+void streambuf_begin_frame(
+    streambuf* sb)
+{
+    const glext* ext = &sb->ext;
+    GLsync* fence = sb->fences + (sb->frame % STREAMBUF_NUM_SLOTS);
+    // a range advances at most one slot per frame, so the slot written in
+    // this frame was last drawn at least three frames ago. staged writes are
+    // copied by the driver and never wait.
+    if(*fence != NULL)
+    {
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        GLenum result;
+        do
+        {
+            result = ext->clientwaitsync(
+                *fence,
+                flags,
+                STREAMBUF_WAIT_TIMEOUT);
+            flags = 0;
+        }
+        while(result == GL_TIMEOUT_EXPIRED);
+        ext->deletesync(*fence);
+        *fence = NULL;
+    }
+}
+
+//****************************************************************************
+void streambuf_end_frame(
+    streambuf* sb)
+{
+    const glext* ext = &sb->ext;
+    if(sb->map != NULL)
+    {
+        GLsync* fence = sb->fences + (sb->frame % STREAMBUF_NUM_SLOTS);
+        *fence = ext->fencesync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    ++sb->frame;
+}
+
+//****************************************************************************
+void* streambuf_begin_write(
+    streambuf* sb,
+    int range)
+{
+    streambuf_range* r = sb->ranges + range;
+    int slot = (r->slot + 1) % STREAMBUF_NUM_SLOTS;
+    r->writing = 1;
+    if(sb->map != NULL)
+    {
+        return sb->map + slot*sb->slotsize + r->offset;
+    }
+    return sb->staging + r->offset;
+}
+
+//****************************************************************************
+void streambuf_end_write(
+    streambuf* sb,
+    int range)
+{
+    streambuf_range* r = sb->ranges + range;
+    if(r->writing)
+    {
+        int slot = (r->slot + 1) % STREAMBUF_NUM_SLOTS;
+        if(sb->map == NULL)
+        {
+            const glext* ext = &sb->ext;
+            ext->bindbuffer(GL_ARRAY_BUFFER, sb->buffer);
+            ext->buffersubdata(
+                GL_ARRAY_BUFFER,
+                slot*sb->slotsize + r->offset,
+                r->size,
+                sb->staging + r->offset);
+        }
+        r->slot = slot;
+        r->writing = 0;
+    }
+}
+
+//****************************************************************************
+GLuint streambuf_get_buffer(
+    const streambuf* sb)
+{
+    return sb->buffer;
+}
+
+//****************************************************************************
+size_t streambuf_get_offset(
+    const streambuf* sb,
+    int range)
+{
+    const streambuf_range* r = sb->ranges + range;
+    return r->slot*sb->slotsize + r->offset;
+}
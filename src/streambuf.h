@@ -0,0 +1,69 @@
+#ifndef STREAMBUF_H_
+#define STREAMBUF_H_
+
+#include "glext.h"
+
+typedef struct streambuf_s streambuf;
+
+enum
+{
+    // copies of each range. the cpu writes one copy while the gpu may still
+    // be reading the copies of the two frames before it.
+    STREAMBUF_NUM_SLOTS = 3,
+    // alignment of the ranges within the buffer and of write pointers
+    STREAMBUF_ALIGN = 64
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// creates a single vertex buffer holding every slot of every range. the
+// buffer is persistently mapped if the driver supports it, otherwise writes
+// go to client memory and are uploaded with glBufferSubData. ranges may be
+// empty. must be called from the rendering thread.
+streambuf* streambuf_create(
+    const size_t* rangesizes,
+    int numranges,
+    const glext* ext);
+
+void streambuf_destroy(
+    streambuf* sb);
+
+// waits until the gpu has finished with the slots that writes in this frame
+// will reuse. must be called before the first write of each frame.
+void streambuf_begin_frame(
+    streambuf* sb);
+
+// marks the end of the draws that read the buffer in this frame
+void streambuf_end_frame(
+    streambuf* sb);
+
+// returns where the next contents of the range are written. the pointer may
+// be written from any thread, but each range may only be written once per
+// frame, and the range keeps drawing its previous contents until the write
+// is ended.
+void* streambuf_begin_write(
+    streambuf* sb,
+    int range);
+
+// makes the written contents the ones drawn. does nothing if the range has
+// no write in progress. must be called from the rendering thread.
+void streambuf_end_write(
+    streambuf* sb,
+    int range);
+
+GLuint streambuf_get_buffer(
+    const streambuf* sb);
+
+// offset in the buffer of the contents of the range that are drawn
+size_t streambuf_get_offset(
+    const streambuf* sb,
+    int range);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STREAMBUF_H_
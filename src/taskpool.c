@@ -0,0 +1,343 @@
+#include "taskpool.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+typedef struct taskpool_queue_s taskpool_queue;
+typedef struct taskpool_worker_s taskpool_worker;
+
+#ifdef WIN32
+typedef HANDLE taskpool_thread;
+typedef CRITICAL_SECTION taskpool_mutex;
+typedef CONDITION_VARIABLE taskpool_cond;
+// msvc gives volatile reads acquire semantics
+#define taskpool_atomic_get(p) (*(p))
+#define taskpool_atomic_inc(p) InterlockedIncrement(p)
+#define taskpool_atomic_dec(p) InterlockedDecrement(p)
+#define taskpool_yield() SwitchToThread()
+#else
+typedef pthread_t taskpool_thread;
+typedef pthread_mutex_t taskpool_mutex;
+typedef pthread_cond_t taskpool_cond;
+#define taskpool_atomic_get(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define taskpool_atomic_inc(p) __sync_add_and_fetch(p, 1)
+#define taskpool_atomic_dec(p) __sync_sub_and_fetch(p, 1)
+#define taskpool_yield() sched_yield()
+#endif
+
+enum
+{
+    // keeps the queue cursors of different threads on separate cache lines
+    TASKPOOL_CACHE_LINE = 64
+};
+
+// contiguous slice of the batch's task array. the owning thread takes tasks
+// from it first; threads whose own slice is empty steal from the others.
+struct taskpool_queue_s
+{
+    volatile long next;
+    long end;
+    char pad[TASKPOOL_CACHE_LINE - 2*sizeof(long)];
+};
+
+struct taskpool_worker_s
+{
+    taskpool* pool;
+    taskpool_thread thread;
+    int index;
+};
+
+struct taskpool_s
+{
+    taskpool_queue* queues;
+    taskpool_worker* workers;
+    int numthreads;
+    taskpool_task* tasks;
+    // times the tasks when not NULL
+    taskpool_clock clock;
+    // tasks in the current batch that have not completed
+    taskpool_counter pending;
+    // number of worker threads that are looking at the current batch
+    taskpool_counter numactive;
+    long generation;
+    int quit;
+    taskpool_mutex mutex;
+    taskpool_cond cond;
+};
+
+//****************************************************************************
+static taskpool_task* taskpool_claim(
+    taskpool* pool,
+    int self)
+{
+    int numthreads = pool->numthreads;
+    int i;
+    for(i = 0; i < numthreads; ++i)
+    {
+        taskpool_queue* q = pool->queues + (self + i) % numthreads;
+        if(taskpool_atomic_get(&q->next) < q->end)
+        {
+            long t = taskpool_atomic_inc(&q->next) - 1;
+            if(t < q->end)
+            {
+                return pool->tasks + t;
+            }
+        }
+    }
+    return NULL;
+}
+
+//****************************************************************************
+static int taskpool_run_one(
+    taskpool* pool,
+    int self)
+{
+    taskpool_task* task = taskpool_claim(pool, self);
+    if(task != NULL)
+    {
+        taskpool_clock clock = pool->clock;
+        if(clock != NULL)
+        {
+            task->thread = self;
+            task->begintime = clock();
+        }
+        task->func(task->userdata, task->first, task->end);
+        if(clock != NULL)
+        {
+            task->endtime = clock();
+        }
+        // the decrements publish the times along with the task's results
+        if(task->counter != NULL)
+        {
+            taskpool_atomic_dec(task->counter);
+        }
+        taskpool_atomic_dec(&pool->pending);
+    }
+    return task != NULL;
+}
+
+//****************************************************************************
+#ifdef WIN32
+static DWORD WINAPI taskpool_worker_main(
+    LPVOID arg)
+#else
+static void* taskpool_worker_main(
+    void* arg)
+#endif
+{
+    taskpool_worker* worker = (taskpool_worker*) arg;
+    taskpool* pool = worker->pool;
+    long generation = 0;
+    for(;;)
+    {
+        int quit;
+        // sleep until a new batch is submitted
+#ifdef WIN32
+        EnterCriticalSection(&pool->mutex);
+        while(!pool->quit && pool->generation == generation)
+        {
+            SleepConditionVariableCS(&pool->cond, &pool->mutex, INFINITE);
+        }
+#else
+        pthread_mutex_lock(&pool->mutex);
+        while(!pool->quit && pool->generation == generation)
+        {
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        }
+#endif
+        generation = pool->generation;
+        quit = pool->quit;
+        taskpool_atomic_inc(&pool->numactive);
+#ifdef WIN32
+        LeaveCriticalSection(&pool->mutex);
+#else
+        pthread_mutex_unlock(&pool->mutex);
+#endif
+        if(!quit)
+        {
+            while(taskpool_run_one(pool, worker->index))
+            {
+            }
+        }
+        taskpool_atomic_dec(&pool->numactive);
+        if(quit)
+        {
+            break;
+        }
+    }
+#ifdef WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+//****************************************************************************
+int taskpool_get_numcpus(void)
+{
+#ifdef WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int) si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int) n : 1;
+#endif
+}
+
+//****************************************************************************
+taskpool* taskpool_create(
+    int numthreads)
+{
+    taskpool* pool;
+    int i;
+    if(numthreads < 1)
+    {
+        numthreads = 1;
+    }
+    pool = (taskpool*) calloc(1, sizeof(*pool));
+    pool->numthreads = numthreads;
+    pool->queues = (taskpool_queue*) calloc(
+        numthreads,
+        sizeof(*pool->queues));
+    pool->workers = (taskpool_worker*) calloc(
+        numthreads,
+        sizeof(*pool->workers));
+#ifdef WIN32
+    InitializeCriticalSection(&pool->mutex);
+    InitializeConditionVariable(&pool->cond);
+#else
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+#endif
+    // worker 0 is the calling thread
+    for(i = 1; i < numthreads; ++i)
+    {
+        taskpool_worker* worker = pool->workers + i;
+        worker->pool = pool;
+        worker->index = i;
+#ifdef WIN32
+        worker->thread = CreateThread(
+            NULL,
+            0,
+            taskpool_worker_main,
+            worker,
+            0,
+            NULL);
+#else
+        pthread_create(&worker->thread, NULL, taskpool_worker_main, worker);
+#endif
+    }
+    return pool;
+}
+
+//****************************************************************************
+void taskpool_destroy(
+    taskpool* pool)
+{
+    int i;
+    taskpool_finish(pool);
+#ifdef WIN32
+    EnterCriticalSection(&pool->mutex);
+    pool->quit = 1;
+    WakeAllConditionVariable(&pool->cond);
+    LeaveCriticalSection(&pool->mutex);
+#else
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+#endif
+    for(i = 1; i < pool->numthreads; ++i)
+    {
+#ifdef WIN32
+        WaitForSingleObject(pool->workers[i].thread, INFINITE);
+        CloseHandle(pool->workers[i].thread);
+#else
+        pthread_join(pool->workers[i].thread, NULL);
+#endif
+    }
+#ifdef WIN32
+    DeleteCriticalSection(&pool->mutex);
+#else
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+#endif
+    free(pool->workers);
+    free(pool->queues);
+    free(pool);
+}
+
+//****************************************************************************
+void taskpool_run(
+    taskpool* pool,
+    taskpool_task* tasks,
+    int numtasks)
+{
+    int numthreads = pool->numthreads;
+    int i;
+    taskpool_finish(pool);
+#ifdef WIN32
+    EnterCriticalSection(&pool->mutex);
+#else
+    pthread_mutex_lock(&pool->mutex);
+#endif
+    // workers may still be leaving the previous batch; the queues can only
+    // be rewritten once none of them can claim from it
+    while(taskpool_atomic_get(&pool->numactive) > 0)
+    {
+        taskpool_yield();
+    }
+    pool->tasks = tasks;
+    pool->pending = numtasks;
+    for(i = 0; i < numthreads; ++i)
+    {
+        pool->queues[i].next = (numtasks * i) / numthreads;
+        pool->queues[i].end = (numtasks * (i + 1)) / numthreads;
+    }
+    ++pool->generation;
+#ifdef WIN32
+    WakeAllConditionVariable(&pool->cond);
+    LeaveCriticalSection(&pool->mutex);
+#else
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+#endif
+}
+
+//****************************************************************************
+void taskpool_wait(
+    taskpool* pool,
+    taskpool_counter* counter)
+{
+    while(taskpool_atomic_get(counter) > 0)
+    {
+        if(!taskpool_run_one(pool, 0))
+        {
+            taskpool_yield();
+        }
+    }
+}
+
+//****************************************************************************
+void taskpool_finish(
+    taskpool* pool)
+{
+    taskpool_wait(pool, &pool->pending);
+}
+
+//****************************************************************************
+void taskpool_set_clock(
+    taskpool* pool,
+    taskpool_clock clock)
+{
+    // workers read the clock only after taskpool_run publishes a batch
+    // under the mutex
+    pool->clock = clock;
+}
@@ -0,0 +1,75 @@
+#ifndef TASKPOOL_H_
+#define TASKPOOL_H_
+
+#include <stdint.h>
+
+typedef struct taskpool_s taskpool;
+typedef struct taskpool_task_s taskpool_task;
+
+// number of unfinished tasks that reference the counter
+typedef volatile long taskpool_counter;
+
+typedef void (*taskpool_func)(void* userdata, int first, int end);
+
+typedef int64_t (*taskpool_clock)(void);
+
+struct taskpool_task_s
+{
+    taskpool_func func;
+    void* userdata;
+    int first;
+    int end;
+    // decremented once the task has completed; may be NULL
+    taskpool_counter* counter;
+    // only set when the pool has a clock. the index of the thread that ran
+    // the task, where 0 is the thread that created the pool, and the clock
+    // when the task began and ended. each task is only written by the
+    // thread that runs it, and can be read once the batch has completed.
+    int thread;
+    int64_t begintime;
+    int64_t endtime;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int taskpool_get_numcpus(void);
+
+// the calling thread counts as one of the threads, so a pool of one thread
+// runs every task inside taskpool_wait
+taskpool* taskpool_create(
+    int numthreads);
+
+void taskpool_destroy(
+    taskpool* pool);
+
+// starts a batch of tasks. the task array must remain valid until
+// taskpool_finish returns, and only the thread that created the pool may
+// submit or wait.
+void taskpool_run(
+    taskpool* pool,
+    taskpool_task* tasks,
+    int numtasks);
+
+// helps run tasks from the batch until the counter reaches zero
+void taskpool_wait(
+    taskpool* pool,
+    taskpool_counter* counter);
+
+// helps run tasks until the whole batch has completed
+void taskpool_finish(
+    taskpool* pool);
+
+// times every task of the following batches with the clock, or stops timing
+// them if clock is NULL. only call this between batches.
+void taskpool_set_clock(
+    taskpool* pool,
+    taskpool_clock clock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TASKPOOL_H_
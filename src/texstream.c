@@ -0,0 +1,328 @@
+#include "texstream.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifndef GL_TEXTURE_BASE_LEVEL
+#define GL_TEXTURE_BASE_LEVEL 0x813C
+#endif
+
+typedef struct texstream_item_s texstream_item;
+
+#ifdef WIN32
+typedef HANDLE texstream_thread;
+// msvc gives volatile reads acquire semantics
+#define texstream_atomic_get(p) (*(p))
+#define texstream_atomic_inc(p) InterlockedIncrement(p)
+#else
+typedef pthread_t texstream_thread;
+#define texstream_atomic_get(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define texstream_atomic_inc(p) __sync_add_and_fetch(p, 1)
+#endif
+
+enum
+{
+    // granularity at which image data is touched to fault it in
+    TEXSTREAM_PAGE_SIZE = 4096
+};
+
+// one level of one texture
+struct texstream_item_s
+{
+    int texture;
+    uint32_t level;
+    uint32_t width;
+    uint32_t height;
+    size_t size;
+    const void* data;
+    // s3tc format of compressed data, or zero if the data is uncompressed
+    GLenum compressedformat;
+};
+
+struct texstream_s
+{
+    const taa_scene* scene;
+    glext_compressedteximage2d_fn compressedteximage2d;
+    taa_texture2d* textures;
+    taa_texformat* formats;
+    // finest level uploaded for each texture, or numlevels if none have been
+    uint32_t* baselevels;
+    // levels of all textures in upload order
+    texstream_item* items;
+    int numitems;
+    // number of items the thread has prepared
+    volatile long numprepared;
+    // number of items that have been uploaded
+    int numuploaded;
+    volatile long quit;
+    texstream_thread thread;
+};
+
+//****************************************************************************
+static int texstream_compare_items(
+    const void* a,
+    const void* b)
+{
+    const texstream_item* ia = (const texstream_item*) a;
+    const texstream_item* ib = (const texstream_item*) b;
+    // smallest levels first, so every texture gets a usable level before
+    // any texture gets a detailed one
+    if(ia->size != ib->size)
+    {
+        return (ia->size < ib->size) ? -1 : 1;
+    }
+    if(ia->texture != ib->texture)
+    {
+        return (ia->texture < ib->texture) ? -1 : 1;
+    }
+    return (ia->level > ib->level) ? -1 : (ia->level < ib->level);
+}
+
+//****************************************************************************
+// faults in the pages of the image so the upload does not wait on them.
+// the scene images may be mapped from a cache file.
+static void texstream_prepare(
+    const texstream_item* item)
+{
+    const volatile unsigned char* p = (const unsigned char*) item->data;
+    size_t offset;
+    for(offset = 0; offset < item->size; offset += TEXSTREAM_PAGE_SIZE)
+    {
+        (void) p[offset];
+    }
+}
+
+//****************************************************************************
+#ifdef WIN32
+static DWORD WINAPI texstream_thread_main(
+    LPVOID arg)
+#else
+static void* texstream_thread_main(
+    void* arg)
+#endif
+{
+    texstream* ts = (texstream*) arg;
+    int i;
+    for(i = 0; i < ts->numitems; ++i)
+    {
+        if(texstream_atomic_get(&ts->quit))
+        {
+            break;
+        }
+        texstream_prepare(ts->items + i);
+        texstream_atomic_inc(&ts->numprepared);
+    }
+#ifdef WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+//****************************************************************************
+texstream* texstream_create(
+    const taa_scene* scene,
+    const dxttexture* dxttextures,
+    const glext* ext)
+{
+    texstream* ts;
+    int numtextures = scene->numtextures;
+    int numitems;
+    int i;
+    ts = (texstream*) calloc(1, sizeof(*ts));
+    ts->scene = scene;
+    ts->compressedteximage2d = ext->compressedteximage2d;
+    ts->textures = (taa_texture2d*) calloc(
+        numtextures + 1,
+        sizeof(*ts->textures));
+    ts->formats = (taa_texformat*) calloc(
+        numtextures + 1,
+        sizeof(*ts->formats));
+    ts->baselevels = (uint32_t*) calloc(
+        numtextures + 1,
+        sizeof(*ts->baselevels));
+    numitems = 0;
+    for(i = 0; i < numtextures; ++i)
+    {
+        numitems += scene->textures[i].numlevels;
+    }
+    ts->items = (texstream_item*) malloc((numitems+1) * sizeof(*ts->items));
+    numitems = 0;
+    for(i = 0; i < numtextures; ++i)
+    {
+        const taa_scenetexture* scntex = scene->textures + i;
+        const dxttexture* dxt = NULL;
+        GLenum compressedformat = 0;
+        taa_texfilter minfilter = taa_TEXFILTER_NEAREST_MIPMAP_LINEAR;
+        taa_texfilter magfilter = taa_TEXFILTER_LINEAR;
+        taa_texformat format = taa_TEXFORMAT_LUM8;
+        uint32_t bpp = 1;
+        uint32_t level;
+        switch(scntex->format)
+        {
+        case taa_SCENETEXTURE_LUM8 : format = taa_TEXFORMAT_LUM8 ; break;
+        case taa_SCENETEXTURE_BGR8 : format = taa_TEXFORMAT_BGR8 ; break;
+        case taa_SCENETEXTURE_BGRA8: format = taa_TEXFORMAT_BGRA8; break;
+        case taa_SCENETEXTURE_RGB8 : format = taa_TEXFORMAT_RGB8 ; break;
+        case taa_SCENETEXTURE_RGBA8: format = taa_TEXFORMAT_RGBA8; break;
+        }
+        switch(scntex->format)
+        {
+        case taa_SCENETEXTURE_LUM8 : bpp = 1; break;
+        case taa_SCENETEXTURE_BGR8 : bpp = 3; break;
+        case taa_SCENETEXTURE_BGRA8: bpp = 4; break;
+        case taa_SCENETEXTURE_RGB8 : bpp = 3; break;
+        case taa_SCENETEXTURE_RGBA8: bpp = 4; break;
+        }
+        if(dxttextures != NULL && ext->s3tc)
+        {
+            dxt = dxttextures + i;
+            switch(dxt->format)
+            {
+            case DXT_BC1:
+                compressedformat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+                break;
+            case DXT_BC3:
+                compressedformat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+                break;
+            default:
+                dxt = NULL;
+                break;
+            }
+        }
+        if(scntex->numlevels == 1)
+        {
+            minfilter = taa_TEXFILTER_LINEAR;
+        }
+        // the images are uploaded as they are prepared
+        taa_texture2d_create(ts->textures + i);
+        taa_texture2d_bind(ts->textures[i]);
+        taa_texture2d_setparameter(taa_TEXPARAM_MAX_LEVEL, scntex->numlevels-1);
+        taa_texture2d_setparameter(taa_TEXPARAM_MIN_FILTER, minfilter);
+        taa_texture2d_setparameter(taa_TEXPARAM_MAG_FILTER, magfilter);
+        taa_texture2d_setparameter(taa_TEXPARAM_WRAP_S, taa_TEXWRAP_CLAMP);
+        taa_texture2d_setparameter(taa_TEXPARAM_WRAP_T, taa_TEXWRAP_CLAMP);
+        ts->formats[i] = format;
+        ts->baselevels[i] = scntex->numlevels;
+        for(level = 0; level < scntex->numlevels; ++level)
+        {
+            texstream_item* item = ts->items + numitems;
+            uint32_t w = scntex->width >> level;
+            uint32_t h = scntex->height >> level;
+            item->texture = i;
+            item->level = level;
+            item->width = (w > 0) ? w : 1;
+            item->height = (h > 0) ? h : 1;
+            item->size = item->width * item->height * bpp;
+            item->data = scntex->images[level];
+            item->compressedformat = 0;
+            if(dxt != NULL && level < dxt->numlevels)
+            {
+                item->size = dxt->levels[level].size;
+                item->data = dxt->levels[level].dst;
+                item->compressedformat = compressedformat;
+            }
+            ++numitems;
+        }
+    }
+    qsort(ts->items, numitems, sizeof(*ts->items), texstream_compare_items);
+    ts->numitems = numitems;
+#ifdef WIN32
+    ts->thread = CreateThread(NULL, 0, texstream_thread_main, ts, 0, NULL);
+#else
+    pthread_create(&ts->thread, NULL, texstream_thread_main, ts);
+#endif
+    return ts;
+}
+
+//****************************************************************************
+void texstream_destroy(
+    texstream* ts)
+{
+    int i;
+    texstream_atomic_inc(&ts->quit);
+#ifdef WIN32
+    WaitForSingleObject(ts->thread, INFINITE);
+    CloseHandle(ts->thread);
+#else
+    pthread_join(ts->thread, NULL);
+#endif
+    for(i = 0; i < (int) ts->scene->numtextures; ++i)
+    {
+        taa_texture2d_destroy(ts->textures[i]);
+    }
+    free(ts->items);
+    free(ts->baselevels);
+    free(ts->formats);
+    free(ts->textures);
+    free(ts);
+}
+
+//****************************************************************************
+int texstream_update(
+    texstream* ts,
+    size_t budget)
+{
+    long numprepared = texstream_atomic_get(&ts->numprepared);
+    size_t numbytes = 0;
+    int numuploaded = 0;
+    while(ts->numuploaded < numprepared)
+    {
+        const texstream_item* item = ts->items + ts->numuploaded;
+        if(numuploaded > 0 && numbytes + item->size > budget)
+        {
+            break;
+        }
+        taa_texture2d_bind(ts->textures[item->texture]);
+        if(item->compressedformat != 0)
+        {
+            ts->compressedteximage2d(
+                GL_TEXTURE_2D,
+                item->level,
+                item->compressedformat,
+                item->width,
+                item->height,
+                0,
+                (GLsizei) item->size,
+                item->data);
+        }
+        else
+        {
+            taa_texture2d_image(
+                item->level,
+                ts->formats[item->texture],
+                item->width,
+                item->height,
+                item->data);
+        }
+        // levels arrive coarsest first, so every level from the new base
+        // to the last one is defined
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, item->level);
+        ts->baselevels[item->texture] = item->level;
+        numbytes += item->size;
+        ++numuploaded;
+        ++ts->numuploaded;
+    }
+    return numuploaded;
+}
+
+//****************************************************************************
+int texstream_is_resident(
+    const texstream* ts,
+    int textureid)
+{
+    const taa_scenetexture* scntex = ts->scene->textures + textureid;
+    return ts->baselevels[textureid] < scntex->numlevels;
+}
+
+//****************************************************************************
+taa_texture2d texstream_get_texture(
+    const texstream* ts,
+    int textureid)
+{
+    return ts->textures[textureid];
+}
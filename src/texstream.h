@@ -0,0 +1,56 @@
+#ifndef TEXSTREAM_H_
+#define TEXSTREAM_H_
+
+#include "dxt.h"
+#include "glext.h"
+#include <taa/gl.h>
+#include <taa/scene.h>
+
+typedef struct texstream_s texstream;
+
+enum
+{
+    // bytes of image data uploaded per frame. one level is always uploaded
+    // per frame, even if it is larger than the budget.
+    TEXSTREAM_FRAME_BUDGET = 4 * 1024 * 1024
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// creates a texture for each texture of the scene, and starts a thread that
+// prepares their image data. must be called from the rendering thread. the
+// compressed copies of the textures are uploaded instead of the scene images
+// if the driver supports them. dxttextures may be NULL.
+texstream* texstream_create(
+    const taa_scene* scene,
+    const dxttexture* dxttextures,
+    const glext* ext);
+
+void texstream_destroy(
+    texstream* ts);
+
+// uploads prepared levels until the byte budget is reached. the levels of
+// all textures are uploaded from the lowest resolution to the highest, so
+// each texture is usable as soon as its smallest level has been uploaded.
+// returns the number of levels that were uploaded.
+int texstream_update(
+    texstream* ts,
+    size_t budget);
+
+// returns zero if none of the levels of the texture have been uploaded
+int texstream_is_resident(
+    const texstream* ts,
+    int textureid);
+
+taa_texture2d texstream_get_texture(
+    const texstream* ts,
+    int textureid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEXSTREAM_H_
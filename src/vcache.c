@@ -0,0 +1,245 @@
+#include "vcache.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct vcache_vert_s vcache_vert;
+
+struct vcache_vert_s
+{
+    // the triangles of the vertex that have not been emitted yet are the
+    // first numactive entries of its range of the adjacency list
+    int firsttri;
+    int numactive;
+    // position in the lru cache, or -1 if it is not cached
+    int cachepos;
+    float score;
+};
+
+//****************************************************************************
+static float vcache_calc_score(
+    const vcache_vert* v)
+{
+    float score = 0.0f;
+    if(v->numactive > 0)
+    {
+        if(v->cachepos >= 0 && v->cachepos < 3)
+        {
+            // the vertices of the last triangle get a fixed score, so the
+            // next triangle does not favour one of its edges
+            score = 0.75f;
+        }
+        else if(v->cachepos >= 3)
+        {
+            float s = (v->cachepos - 3) / (float) (VCACHE_LRU_SIZE - 3);
+            score = (float) pow(1.0f - s, 1.5f);
+        }
+        // vertices with few triangles left are finished first, so they do
+        // not have to be loaded again later
+        score += 2.0f / (float) sqrt((float) v->numactive);
+    }
+    return score;
+}
+
+//****************************************************************************
+float vcache_calc_acmr(
+    const int32_t* indices,
+    uint32_t numindices,
+    uint32_t numvertices)
+{
+    uint32_t numtris = numindices / 3;
+    int* stamps;
+    int misses = 0;
+    uint32_t i;
+    // a vertex is in the fifo while fewer than its size misses have
+    // happened since it was loaded
+    stamps = (int*) malloc((numvertices + 1) * sizeof(*stamps));
+    for(i = 0; i < numvertices; ++i)
+    {
+        stamps[i] = -VCACHE_FIFO_SIZE - 1;
+    }
+    for(i = 0; i < numtris*3; ++i)
+    {
+        int v = indices[i];
+        if(misses - stamps[v] >= VCACHE_FIFO_SIZE)
+        {
+            stamps[v] = misses;
+            ++misses;
+        }
+    }
+    free(stamps);
+    return (numtris > 0) ? misses / (float) numtris : 0.0f;
+}
+
+//****************************************************************************
+void vcache_optimize(
+    int32_t* indices,
+    uint32_t numindices,
+    uint32_t numvertices)
+{
+    int numtris = numindices / 3;
+    vcache_vert* verts;
+    int* adjacency;
+    float* triscores;
+    uint8_t* emitted;
+    int32_t* out;
+    int cache[VCACHE_LRU_SIZE + 3];
+    int newcache[VCACHE_LRU_SIZE + 3];
+    int cachesize = 0;
+    int cursor = 0;
+    int best = 0;
+    int first;
+    int n;
+    int i;
+    int j;
+    verts = (vcache_vert*) calloc(numvertices + 1, sizeof(*verts));
+    adjacency = (int*) malloc((numtris*3 + 1) * sizeof(*adjacency));
+    triscores = (float*) malloc((numtris + 1) * sizeof(*triscores));
+    emitted = (uint8_t*) calloc(numtris + 1, sizeof(*emitted));
+    out = (int32_t*) malloc((numtris*3 + 1) * sizeof(*out));
+    // build the list of the triangles of each vertex
+    for(i = 0; i < numtris*3; ++i)
+    {
+        ++verts[indices[i]].numactive;
+    }
+    first = 0;
+    for(i = 0; i < (int) numvertices; ++i)
+    {
+        verts[i].firsttri = first;
+        first += verts[i].numactive;
+        verts[i].numactive = 0;
+        verts[i].cachepos = -1;
+    }
+    for(i = 0; i < numtris*3; ++i)
+    {
+        vcache_vert* v = verts + indices[i];
+        adjacency[v->firsttri + v->numactive++] = i / 3;
+    }
+    for(i = 0; i < (int) numvertices; ++i)
+    {
+        verts[i].score = vcache_calc_score(verts + i);
+    }
+    for(i = 0; i < numtris; ++i)
+    {
+        const int32_t* tri = indices + i*3;
+        triscores[i] =
+            verts[tri[0]].score +
+            verts[tri[1]].score +
+            verts[tri[2]].score;
+    }
+    for(n = 0; n < numtris; ++n)
+    {
+        const int32_t* tri;
+        int newsize = 0;
+        float bestscore = -1.0f;
+        if(best < 0)
+        {
+            // none of the cached vertices has a triangle left, so start
+            // again from the first triangle that has not been emitted
+            while(emitted[cursor])
+            {
+                ++cursor;
+            }
+            best = cursor;
+        }
+        tri = indices + best*3;
+        memcpy(out + n*3, tri, 3 * sizeof(*tri));
+        emitted[best] = 1;
+        // the triangle's vertices move to the front of the cache, and the
+        // triangle is removed from their lists
+        for(i = 0; i < 3; ++i)
+        {
+            vcache_vert* v = verts + tri[i];
+            int* tris = adjacency + v->firsttri;
+            int found = 0;
+            for(j = 0; j < newsize; ++j)
+            {
+                found |= (newcache[j] == tri[i]);
+            }
+            if(!found)
+            {
+                newcache[newsize++] = tri[i];
+            }
+            j = 0;
+            while(tris[j] != best)
+            {
+                ++j;
+            }
+            tris[j] = tris[--v->numactive];
+            tris[v->numactive] = best;
+        }
+        for(i = 0; i < cachesize; ++i)
+        {
+            int c = cache[i];
+            if(c != tri[0] && c != tri[1] && c != tri[2])
+            {
+                newcache[newsize++] = c;
+            }
+        }
+        // rescore the vertices whose cache positions changed, including the
+        // ones pushed out of the cache, and their remaining triangles
+        for(i = 0; i < newsize; ++i)
+        {
+            vcache_vert* v = verts + newcache[i];
+            float score;
+            v->cachepos = (i < VCACHE_LRU_SIZE) ? i : -1;
+            score = vcache_calc_score(v);
+            for(j = 0; j < v->numactive; ++j)
+            {
+                triscores[adjacency[v->firsttri + j]] += score - v->score;
+            }
+            v->score = score;
+        }
+        cachesize = (newsize < VCACHE_LRU_SIZE) ? newsize : VCACHE_LRU_SIZE;
+        memcpy(cache, newcache, cachesize * sizeof(*cache));
+        // the next triangle is the best one that uses a cached vertex
+        best = -1;
+        for(i = 0; i < cachesize; ++i)
+        {
+            const vcache_vert* v = verts + cache[i];
+            for(j = 0; j < v->numactive; ++j)
+            {
+                int t = adjacency[v->firsttri + j];
+                if(triscores[t] > bestscore)
+                {
+                    bestscore = triscores[t];
+                    best = t;
+                }
+            }
+        }
+    }
+    memcpy(indices, out, numtris*3 * sizeof(*indices));
+    free(out);
+    free(emitted);
+    free(triscores);
+    free(adjacency);
+    free(verts);
+}
+
+//****************************************************************************
+void vcache_calc_fetch_order(
+    const int32_t* indices,
+    uint32_t numindices,
+    uint32_t numvertices,
+    int* order_out)
+{
+    uint8_t* used = (uint8_t*) calloc(numvertices + 1, sizeof(*used));
+    int n = 0;
+    uint32_t i;
+    for(i = 0; i < numindices; ++i)
+    {
+        if(!used[indices[i]])
+        {
+            used[indices[i]] = 1;
+            order_out[n++] = indices[i];
+        }
+    }
+    for(i = 0; i < numvertices; ++i)
+    {
+        if(!used[i])
+        {
+            order_out[n++] = i;
+        }
+    }
+    free(used);
+}
@@ -0,0 +1,48 @@
+#ifndef VCACHE_H_
+#define VCACHE_H_
+
+#include <stdint.h>
+
+enum
+{
+    // size of the lru cache that triangles are ordered for
+    VCACHE_LRU_SIZE = 32,
+    // size of the fifo cache that the miss ratio is measured with, which is
+    // close to the post transform cache of most hardware
+    VCACHE_FIFO_SIZE = 16
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// returns the average number of cache misses per triangle of a triangle
+// list, from 0.5 for an ideal grid to 3 for no reuse at all
+float vcache_calc_acmr(
+    const int32_t* indices,
+    uint32_t numindices,
+    uint32_t numvertices);
+
+// reorders the triangles of a triangle list in place so that they reuse
+// the vertices of recent triangles, using the scoring of Tom Forsyth's
+// linear speed vertex cache optimisation. the vertices of each triangle
+// keep their winding.
+void vcache_optimize(
+    int32_t* indices,
+    uint32_t numindices,
+    uint32_t numvertices);
+
+// lists the vertices in the order the indices first use them, followed by
+// the unused vertices in their original order
+void vcache_calc_fetch_order(
+    const int32_t* indices,
+    uint32_t numindices,
+    uint32_t numvertices,
+    int* order_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VCACHE_H_
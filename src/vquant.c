@@ -0,0 +1,144 @@
+#include "vquant.h"
+#include "skin.h"
+#include <taa/mat44.h>
+#include <math.h>
+
+enum
+{
+    // largest magnitude of a quantized position or texture coordinate
+    VQUANT_MAX_SHORT = 32767,
+    // largest magnitude of a quantized normal component
+    VQUANT_MAX_BYTE = 127
+};
+
+//****************************************************************************
+// rounds the value in units of scale relative to center to the nearest
+// integer within -max to max
+static int vquant_round(
+    float v,
+    float center,
+    float scale,
+    int max)
+{
+    int q = (int) floor((v - center)/scale + 0.5f);
+    q = (q < -max) ? -max : q;
+    q = (q > max) ? max : q;
+    return q;
+}
+
+//****************************************************************************
+void vquant_create(
+    const taa_scenemesh* mesh,
+    vquant* vq_out)
+{
+    const pnvert* pn = (const pnvert*) mesh->vertexstreams[0].buffer;
+    const tvert* tv = (const tvert*) mesh->vertexstreams[1].buffer;
+    int numverts = mesh->vertexstreams[0].numvertices;
+    taa_vec3 pmin = { 0.0f, 0.0f, 0.0f };
+    taa_vec3 pmax = { 0.0f, 0.0f, 0.0f };
+    taa_vec2 tmin = { 0.0f, 0.0f };
+    taa_vec2 tmax = { 0.0f, 0.0f };
+    float extent;
+    int i;
+    if(numverts > 0)
+    {
+        pmin = pmax = pn[0].pos;
+        tmin = tmax = tv[0].texcoord;
+    }
+    for(i = 1; i < numverts; ++i)
+    {
+        const taa_vec3* p = &pn[i].pos;
+        const taa_vec2* t = &tv[i].texcoord;
+        pmin.x = (p->x < pmin.x) ? p->x : pmin.x;
+        pmin.y = (p->y < pmin.y) ? p->y : pmin.y;
+        pmin.z = (p->z < pmin.z) ? p->z : pmin.z;
+        pmax.x = (p->x > pmax.x) ? p->x : pmax.x;
+        pmax.y = (p->y > pmax.y) ? p->y : pmax.y;
+        pmax.z = (p->z > pmax.z) ? p->z : pmax.z;
+        tmin.x = (t->x < tmin.x) ? t->x : tmin.x;
+        tmin.y = (t->y < tmin.y) ? t->y : tmin.y;
+        tmax.x = (t->x > tmax.x) ? t->x : tmax.x;
+        tmax.y = (t->y > tmax.y) ? t->y : tmax.y;
+    }
+    // the positions use the largest extent on every axis, so the matrix is
+    // a uniform scale that does not skew normals
+    extent = pmax.x - pmin.x;
+    extent = (pmax.y - pmin.y > extent) ? pmax.y - pmin.y : extent;
+    extent = (pmax.z - pmin.z > extent) ? pmax.z - pmin.z : extent;
+    extent = (extent > 0.0f) ? extent : 1.0f;
+    taa_mat44_identity(&vq_out->posmat);
+    vq_out->posmat.x.x = extent * 0.5f / VQUANT_MAX_SHORT;
+    vq_out->posmat.y.y = vq_out->posmat.x.x;
+    vq_out->posmat.z.z = vq_out->posmat.x.x;
+    vq_out->posmat.w.x = (pmin.x + pmax.x) * 0.5f;
+    vq_out->posmat.w.y = (pmin.y + pmax.y) * 0.5f;
+    vq_out->posmat.w.z = (pmin.z + pmax.z) * 0.5f;
+    // texture coordinates are scaled per axis, since the texture matrix
+    // has nothing else to skew
+    taa_mat44_identity(&vq_out->texmat);
+    vq_out->texmat.x.x = (tmax.x - tmin.x) * 0.5f / VQUANT_MAX_SHORT;
+    vq_out->texmat.y.y = (tmax.y - tmin.y) * 0.5f / VQUANT_MAX_SHORT;
+    if(vq_out->texmat.x.x <= 0.0f)
+    {
+        vq_out->texmat.x.x = 1.0f;
+    }
+    if(vq_out->texmat.y.y <= 0.0f)
+    {
+        vq_out->texmat.y.y = 1.0f;
+    }
+    vq_out->texmat.w.x = (tmin.x + tmax.x) * 0.5f;
+    vq_out->texmat.w.y = (tmin.y + tmax.y) * 0.5f;
+}
+
+//****************************************************************************
+void vquant_encode(
+    const vquant* vq,
+    const taa_scenemesh* mesh,
+    qvert* verts_out)
+{
+    const pnvert* pn = (const pnvert*) mesh->vertexstreams[0].buffer;
+    const tvert* tv = (const tvert*) mesh->vertexstreams[1].buffer;
+    const taa_mat44* pm = &vq->posmat;
+    const taa_mat44* tm = &vq->texmat;
+    int numverts = mesh->vertexstreams[0].numvertices;
+    int maxbyte = VQUANT_MAX_BYTE;
+    float nscale = 1.0f / VQUANT_MAX_BYTE;
+    int i;
+    for(i = 0; i < numverts; ++i)
+    {
+        const taa_vec3* p = &pn[i].pos;
+        const taa_vec3* n = &pn[i].normal;
+        const taa_vec2* t = &tv[i].texcoord;
+        qvert* q = verts_out + i;
+        q->pos[0] = (int16_t) vquant_round(
+            p->x,
+            pm->w.x,
+            pm->x.x,
+            VQUANT_MAX_SHORT);
+        q->pos[1] = (int16_t) vquant_round(
+            p->y,
+            pm->w.y,
+            pm->y.y,
+            VQUANT_MAX_SHORT);
+        q->pos[2] = (int16_t) vquant_round(
+            p->z,
+            pm->w.z,
+            pm->z.z,
+            VQUANT_MAX_SHORT);
+        q->pos[3] = 0;
+        q->normal[0] = (int8_t) vquant_round(n->x, 0.0f, nscale, maxbyte);
+        q->normal[1] = (int8_t) vquant_round(n->y, 0.0f, nscale, maxbyte);
+        q->normal[2] = (int8_t) vquant_round(n->z, 0.0f, nscale, maxbyte);
+        q->normal[3] = 0;
+        q->texcoord[0] = (int16_t) vquant_round(
+            t->x,
+            tm->w.x,
+            tm->x.x,
+            VQUANT_MAX_SHORT);
+        q->texcoord[1] = (int16_t) vquant_round(
+            t->y,
+            tm->w.y,
+            tm->y.y,
+            VQUANT_MAX_SHORT);
+    }
+}
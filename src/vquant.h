@@ -0,0 +1,57 @@
+#ifndef VQUANT_H_
+#define VQUANT_H_
+
+#include <taa/scene.h>
+
+typedef struct qvert_s qvert;
+typedef struct vquant_s vquant;
+
+// compact vertex of a mesh that is never skinned, which takes 16 bytes
+// instead of the 32 of a pnvert and a tvert
+struct qvert_s
+{
+    // position in units of the position scale, relative to the center of
+    // the mesh bounds. the fourth component is padding.
+    int16_t pos[4];
+    // unit normal scaled to 127, the range GL_BYTE normals are read from.
+    // the fourth component is padding.
+    int8_t normal[4];
+    // texture coordinate in units of the texture scale, relative to the
+    // center of the mesh's texture coordinate range
+    int16_t texcoord[2];
+};
+
+// transforms that convert the quantized positions and texture coordinates
+// of a mesh back to their original values. the position scale is the same
+// on every axis, so normals transformed by a model matrix that includes it
+// only have to be renormalized.
+struct vquant_s
+{
+    taa_mat44 posmat;
+    taa_mat44 texmat;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// fits the transforms to the bounds of the positions and texture
+// coordinates of a mesh formatted by skin_format_mesh
+void vquant_create(
+    const taa_scenemesh* mesh,
+    vquant* vq_out);
+
+// quantizes the vertices of a mesh formatted by skin_format_mesh. the mesh
+// may be a different one than the transforms were fitted to, such as a
+// simplified level, as long as its vertices lie within the same bounds.
+void vquant_encode(
+    const vquant* vq,
+    const taa_scenemesh* mesh,
+    qvert* verts_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VQUANT_H_
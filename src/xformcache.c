@@ -0,0 +1,152 @@
+#include "xformcache.h"
+#include <taa/mat44.h>
+#include <stdlib.h>
+#include <string.h>
+
+//****************************************************************************
+// sorts the nodes by their depth in the hierarchy, so that every parent is
+// placed before its children
+static void xformcache_sort_nodes(
+    const taa_scenenode* nodes,
+    int numnodes,
+    int* order_out)
+{
+    int* depths;
+    int* starts;
+    int maxdepth;
+    int i;
+    depths = (int*) malloc(numnodes * sizeof(*depths));
+    for(i = 0; i < numnodes; ++i)
+    {
+        depths[i] = -1;
+    }
+    maxdepth = 0;
+    for(i = 0; i < numnodes; ++i)
+    {
+        int depth = 0;
+        int j = i;
+        // walk up until a node with a known depth or a root is reached
+        while(depths[j] < 0 && nodes[j].parent >= 0)
+        {
+            j = nodes[j].parent;
+            ++depth;
+        }
+        depth += (depths[j] >= 0) ? depths[j] : 0;
+        maxdepth = (depth > maxdepth) ? depth : maxdepth;
+        // fill in the depths of the walked chain
+        j = i;
+        while(depths[j] < 0)
+        {
+            depths[j] = depth;
+            j = (nodes[j].parent >= 0) ? nodes[j].parent : j;
+            --depth;
+        }
+    }
+    // stable counting sort by depth
+    starts = (int*) calloc(maxdepth + 2, sizeof(*starts));
+    for(i = 0; i < numnodes; ++i)
+    {
+        ++starts[depths[i] + 1];
+    }
+    for(i = 0; i < maxdepth; ++i)
+    {
+        starts[i + 1] += starts[i];
+    }
+    for(i = 0; i < numnodes; ++i)
+    {
+        order_out[starts[depths[i]]++] = i;
+    }
+    free(starts);
+    free(depths);
+}
+
+//****************************************************************************
+void xformcache_create(
+    const taa_scenenode* nodes,
+    int numnodes,
+    xformcache* cache_out)
+{
+    cache_out->order = (int*) malloc(numnodes * sizeof(*cache_out->order));
+    cache_out->prevnodes = (taa_scenenode*) malloc(
+        numnodes * sizeof(*cache_out->prevnodes));
+    cache_out->localmats = (taa_mat44*) taa_memalign(
+        16,
+        numnodes * sizeof(*cache_out->localmats));
+    cache_out->worldmats = (taa_mat44*) taa_memalign(
+        16,
+        numnodes * sizeof(*cache_out->worldmats));
+    cache_out->dirty = (uint8_t*) malloc(numnodes*sizeof(*cache_out->dirty));
+    cache_out->numnodes = numnodes;
+    cache_out->valid = 0;
+    xformcache_sort_nodes(nodes, numnodes, cache_out->order);
+}
+
+//****************************************************************************
+void xformcache_destroy(
+    xformcache* cache)
+{
+    taa_memalign_free(cache->worldmats);
+    taa_memalign_free(cache->localmats);
+    free(cache->dirty);
+    free(cache->prevnodes);
+    free(cache->order);
+}
+
+//****************************************************************************
+int xformcache_update(
+    xformcache* cache,
+    const taa_scenenode* nodes)
+{
+    const int* orderitr = cache->order;
+    const int* orderend = orderitr + cache->numnodes;
+    taa_scenenode* prevnodes = cache->prevnodes;
+    taa_mat44* localmats = cache->localmats;
+    taa_mat44* worldmats = cache->worldmats;
+    uint8_t* dirty = cache->dirty;
+    int valid = cache->valid;
+    int numdirty = 0;
+    while(orderitr != orderend)
+    {
+        int i = *orderitr;
+        const taa_scenenode* node = nodes + i;
+        int parent = node->parent;
+        int changed = !valid;
+        if(valid && memcmp(node, prevnodes + i, sizeof(*node)) != 0)
+        {
+            changed = 1;
+        }
+        if(changed)
+        {
+            // evaluate the node's own transform by detaching it from its
+            // parent chain
+            taa_scenenode local = *node;
+            local.parent = -1;
+            taa_scenenode_calc_transform(&local, 0, localmats + i);
+            prevnodes[i] = *node;
+        }
+        // parents are always updated first, so their flags are current
+        if(parent >= 0 && dirty[parent])
+        {
+            changed = 1;
+        }
+        if(changed)
+        {
+            if(parent >= 0)
+            {
+                taa_mat44_multiply(
+                    worldmats + parent,
+                    localmats + i,
+                    worldmats + i);
+            }
+            else
+            {
+                worldmats[i] = localmats[i];
+            }
+            ++numdirty;
+        }
+        dirty[i] = (uint8_t) changed;
+        ++orderitr;
+    }
+    cache->valid = 1;
+    return numdirty;
+}
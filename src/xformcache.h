@@ -0,0 +1,48 @@
+#ifndef XFORMCACHE_H_
+#define XFORMCACHE_H_
+
+#include <taa/scene.h>
+
+typedef struct xformcache_s xformcache;
+
+// world space transforms of every node in a scene hierarchy. the nodes are
+// evaluated parent before child, and a node is only recalculated when it or
+// one of its ancestors changed since the previous update.
+struct xformcache_s
+{
+    // node indices sorted by depth in the hierarchy
+    int* order;
+    // copy of the nodes as they were at the previous update
+    taa_scenenode* prevnodes;
+    taa_mat44* localmats;
+    taa_mat44* worldmats;
+    // nonzero for nodes whose world transform changed in the last update
+    uint8_t* dirty;
+    int numnodes;
+    // zero until the first update has evaluated every node
+    int valid;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void xformcache_create(
+    const taa_scenenode* nodes,
+    int numnodes,
+    xformcache* cache_out);
+
+void xformcache_destroy(
+    xformcache* cache);
+
+// returns the number of nodes whose world transform was recalculated
+int xformcache_update(
+    xformcache* cache,
+    const taa_scenenode* nodes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XFORMCACHE_H_